@@ -1,112 +1,498 @@
-/*
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
+#include <map>
 #include <vector>
 #include <string>
-#include <limits>
-#include <algorithm>
-#include <cfloat>
 
+#include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>
 
-struct Point3f {
-    float x, y, z;
-};
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/mesh.h>
+#include <assimp/postprocess.h>
+
+#include "pose_metrics.h"
+
+using namespace std;
+using namespace cv;
+
+// the number of frames that are read and evaluated at once
+static const int chunkSize = 4096;
 
-std::vector<Point3f> loadOBJ(const std::string& filename) {
-    std::vector<Point3f> vertices;
-    std::ifstream file(filename);
-    std::string line;
-
-    while (std::getline(file, line)) {
-        if (line.substr(0, 2) == "v ") {
-            std::istringstream iss(line.substr(2));
-            Point3f p;
-            iss >> p.x >> p.y >> p.z;
-            vertices.push_back(p);
+// the number of parallel tasks per chunk
+static const int numTasks = 16;
+
+// the number of samples of each error curve
+static const int numCurveBins = 100;
+
+
+/**
+ *  The accumulated errors of one or more sequences. Besides the sums and
+ *  success counts it keeps a histogram of each error over a fixed range, from
+ *  which the success rate as a function of the threshold (the error curve) and
+ *  the area under that curve are obtained without storing per frame results.
+ */
+struct ErrorStatistics
+{
+    long numFrames;
+    
+    double sumADD;
+    double sumADDS;
+    double sumRotation;
+    double sumTranslation;
+    
+    long successADD;
+    long successADDS;
+    long success5cm5deg;
+    
+    // histograms of ADD and ADD-S wrt the diameter in [0, 0.1], of rotation errors in [0, 10] deg and translation errors in [0, 10] cm
+    vector<long> histADD;
+    vector<long> histADDS;
+    vector<long> histRotation;
+    vector<long> histTranslation;
+    
+    ErrorStatistics()
+    {
+        numFrames = 0;
+        sumADD = sumADDS = sumRotation = sumTranslation = 0;
+        successADD = successADDS = success5cm5deg = 0;
+        
+        histADD.assign(numCurveBins, 0);
+        histADDS.assign(numCurveBins, 0);
+        histRotation.assign(numCurveBins, 0);
+        histTranslation.assign(numCurveBins, 0);
+    }
+    
+    void add(const ErrorStatistics &other)
+    {
+        numFrames += other.numFrames;
+        sumADD += other.sumADD;
+        sumADDS += other.sumADDS;
+        sumRotation += other.sumRotation;
+        sumTranslation += other.sumTranslation;
+        successADD += other.successADD;
+        successADDS += other.successADDS;
+        success5cm5deg += other.success5cm5deg;
+        
+        for(int b = 0; b < numCurveBins; b++)
+        {
+            histADD[b] += other.histADD[b];
+            histADDS[b] += other.histADDS[b];
+            histRotation[b] += other.histRotation[b];
+            histTranslation[b] += other.histTranslation[b];
         }
     }
-    return vertices;
+};
+
+
+/**
+ *  Command line options of the evaluator.
+ */
+struct EvaluationOptions
+{
+    // the number of model units per meter, e.g. 1000 for models in mm
+    float unitsPerMeter;
+    
+    // the number of frames skipped at the beginning of each sequence, e.g. 1 if tracking was initialized with the ground truth
+    int skipFrames;
+    
+    string curvesCSV;
+    
+    bool verbose;
+};
+
+
+static void addToHistogram(vector<long> &hist, float value, float maxValue)
+{
+    int b = (int)(value/maxValue*numCurveBins);
+    if(b < numCurveBins)
+        hist[max(b, 0)]++;
 }
 
-std::vector<Point3f> loadPLY(const std::string& filename) {
-    std::vector<Point3f> vertices;
-    std::ifstream file(filename);
-    std::string line;
-    int vertexCount = 0;
-
-    while (std::getline(file, line)) {
-        if (line.find("element vertex") != std::string::npos) {
-            std::istringstream iss(line);
-            std::string word;
-            iss >> word >> word >> vertexCount;
-        } else if (line == "end_header") {
-            break;
-        }
-    }
 
-    for (int i = 0; i < vertexCount; ++i) {
-        std::getline(file, line);
-        std::istringstream iss(line);
-        Point3f p;
-        iss >> p.x >> p.y >> p.z;
-        vertices.push_back(p);
+static bool parsePoseLine(const string &line, Matx44f &T)
+{
+    istringstream iss(line);
+    float vals[12];
+    for(int i = 0; i < 12; i++)
+    {
+        if(!(iss >> vals[i]))
+            return false;
     }
+    
+    T = Matx44f(vals[0], vals[1], vals[2], vals[9],
+                vals[3], vals[4], vals[5], vals[10],
+                vals[6], vals[7], vals[8], vals[11],
+                0, 0, 0, 1);
+    
+    return true;
+}
+
 
-    return vertices;
+// reads up to maxPoses poses from the current position of the file, skipping lines that contain no pose
+static int readPoses(ifstream &file, int maxPoses, vector<Matx44f> &poses)
+{
+    poses.clear();
+    
+    string line;
+    while(poses.size() < maxPoses && getline(file, line))
+    {
+        Matx44f T;
+        if(parsePoseLine(line, T))
+            poses.push_back(T);
+    }
+    
+    return (int)poses.size();
 }
 
-void compareModels(const std::vector<Point3f>& a, const std::vector<Point3f>& b, const std::string& nameA, const std::string& nameB) {
-    auto computeStats = [](const std::vector<Point3f>& pts) {
-        Point3f minPt = {FLT_MAX, FLT_MAX, FLT_MAX};
-        Point3f maxPt = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
-        Point3f center = {0, 0, 0};
-
-        for (const auto& p : pts) {
-            minPt.x = std::min(minPt.x, p.x);
-            minPt.y = std::min(minPt.y, p.y);
-            minPt.z = std::min(minPt.z, p.z);
-            maxPt.x = std::max(maxPt.x, p.x);
-            maxPt.y = std::max(maxPt.y, p.y);
-            maxPt.z = std::max(maxPt.z, p.z);
+
+static bool loadModelPoints(const string &filename, vector<Vec3f> &points)
+{
+    Assimp::Importer importer;
+    
+    const aiScene* scene = importer.ReadFile(filename, aiProcess_JoinIdenticalVertices);
+    
+    if(!scene || scene->mNumMeshes == 0)
+        return false;
+    
+    points.clear();
+    for(int m = 0; m < scene->mNumMeshes; m++)
+    {
+        aiMesh *mesh = scene->mMeshes[m];
+        for(int i = 0; i < mesh->mNumVertices; i++)
+        {
+            aiVector3D v = mesh->mVertices[i];
+            points.push_back(Vec3f(v.x, v.y, v.z));
         }
+    }
+    
+    return !points.empty();
+}
 
-        center.x = (minPt.x + maxPt.x) / 2;
-        center.y = (minPt.y + maxPt.y) / 2;
-        center.z = (minPt.z + maxPt.z) / 2;
 
-        return std::make_tuple(minPt, maxPt, center);
-    };
+static bool evaluateSequence(const PoseMetrics *poseMetrics, const string &gtFile, const string &predFile, const EvaluationOptions &options, ErrorStatistics &stats)
+{
+    ifstream gt(gtFile.c_str());
+    ifstream pred(predFile.c_str());
+    
+    if(!gt.is_open() || !pred.is_open())
+    {
+        cerr << "Failed to open pose files: " << gtFile << ", " << predFile << endl;
+        return false;
+    }
+    
+    float diameter = poseMetrics->getDiameter();
+    float unitsPerCm = options.unitsPerMeter/100.0f;
+    
+    vector<Matx44f> gtPoses, predPoses;
+    vector<PoseErrors> errors;
+    
+    long frame = 0;
+    
+    while(true)
+    {
+        int numGT = readPoses(gt, chunkSize, gtPoses);
+        int numPred = readPoses(pred, chunkSize, predPoses);
+        
+        if(numGT != numPred)
+        {
+            cerr << "Mismatch in the number of poses: " << gtFile << ", " << predFile << endl;
+        }
+        
+        int n = min(numGT, numPred);
+        if(n == 0)
+            break;
+        
+        int threads = min(numTasks, n);
+        parallel_for_(cv::Range(0, threads), Parallel_For_evaluatePoses(poseMetrics, gtPoses, predPoses, errors, threads));
+        
+        for(int i = 0; i < n; i++, frame++)
+        {
+            if(frame < options.skipFrames)
+                continue;
+            
+            const PoseErrors &e = errors[i];
+            
+            stats.numFrames++;
+            stats.sumADD += e.add;
+            stats.sumADDS += e.adds;
+            stats.sumRotation += e.rotation;
+            stats.sumTranslation += e.translation;
+            
+            if(e.add < 0.1f*diameter)
+                stats.successADD++;
+            if(e.adds < 0.1f*diameter)
+                stats.successADDS++;
+            if(e.translation < 5.0f*unitsPerCm && e.rotation < 5.0f)
+                stats.success5cm5deg++;
+            
+            addToHistogram(stats.histADD, e.add/diameter, 0.1f);
+            addToHistogram(stats.histADDS, e.adds/diameter, 0.1f);
+            addToHistogram(stats.histRotation, e.rotation, 10.0f);
+            addToHistogram(stats.histTranslation, e.translation/unitsPerCm, 10.0f);
+            
+            if(options.verbose)
+            {
+                cout << "Frame " << frame << ": ADD = " << e.add << ", ADD-S = " << e.adds << ", r_err = " << e.rotation << " deg, t_err = " << e.translation << endl;
+            }
+        }
+        
+        if(numGT < chunkSize || numPred < chunkSize)
+            break;
+    }
+    
+    return true;
+}
 
-    auto [minA, maxA, centerA] = computeStats(a);
-    auto [minB, maxB, centerB] = computeStats(b);
 
-    std::cout << "=== Model Comparison ===\n";
-    std::cout << nameA << " vertex count: " << a.size() << "\n";
-    std::cout << nameB << " vertex count: " << b.size() << "\n\n";
+// the area under the error curve normalized to [0, 1]
+static double computeAUC(const vector<long> &hist, long numFrames)
+{
+    if(numFrames == 0)
+        return 0;
+    
+    double area = 0;
+    long cumulative = 0;
+    for(int b = 0; b < numCurveBins; b++)
+    {
+        cumulative += hist[b];
+        area += (double)cumulative/numFrames;
+    }
+    
+    return area/numCurveBins;
+}
 
-    std::cout << nameA << " center: (" << centerA.x << ", " << centerA.y << ", " << centerA.z << ")\n";
-    std::cout << nameB << " center: (" << centerB.x << ", " << centerB.y << ", " << centerB.z << ")\n\n";
 
-    std::cout << nameA << " range x: [" << minA.x << ", " << maxA.x << "]\n";
-    std::cout << nameB << " range x: [" << minB.x << ", " << maxB.x << "]\n";
+static void printStatistics(const string &name, const ErrorStatistics &stats)
+{
+    double n = max(stats.numFrames, 1L);
+    
+    cout << left << setw(40) << name << right << fixed
+         << setw(8) << stats.numFrames
+         << setprecision(2)
+         << setw(10) << 100.0*stats.successADD/n
+         << setw(10) << 100.0*stats.successADDS/n
+         << setw(10) << 100.0*stats.success5cm5deg/n
+         << setprecision(3)
+         << setw(10) << computeAUC(stats.histADD, stats.numFrames)
+         << setw(10) << computeAUC(stats.histADDS, stats.numFrames)
+         << setprecision(2)
+         << setw(10) << stats.sumRotation/n
+         << setw(10) << stats.sumTranslation/n << endl;
+}
 
-    std::cout << nameA << " range y: [" << minA.y << ", " << maxA.y << "]\n";
-    std::cout << nameB << " range y: [" << minB.y << ", " << maxB.y << "]\n";
 
-    std::cout << nameA << " range z: [" << minA.z << ", " << maxA.z << "]\n";
-    std::cout << nameB << " range z: [" << minB.z << ", " << maxB.z << "]\n";
+static void writeCurves(ofstream &file, const string &name, const ErrorStatistics &stats)
+{
+    double n = max(stats.numFrames, 1L);
+    
+    long add = 0, adds = 0, rotation = 0, translation = 0;
+    for(int b = 0; b < numCurveBins; b++)
+    {
+        add += stats.histADD[b];
+        adds += stats.histADDS[b];
+        rotation += stats.histRotation[b];
+        translation += stats.histTranslation[b];
+        
+        float t = (float)(b + 1)/numCurveBins;
+        
+        file << name << "," << 0.1f*t << "," << add/n << "," << adds/n << "," << 10.0f*t << "," << rotation/n << "," << 10.0f*t << "," << translation/n << "\n";
+    }
 }
 
-int main() {
-    std::string objPath = "/media/jyj/JYJ/RBOT-dataset/RBOT_dataset_p2/cat/cat_simple.obj";
-    std::string plyPath = "/media/jyj/JYJ/RBOT-dataset/RBOT_dataset_p2/cat/cat.ply";
 
-    std::vector<Point3f> objPoints = loadOBJ(objPath);
-    std::vector<Point3f> plyPoints = loadPLY(plyPath);
+static void printUsage()
+{
+    cout << "Usage: compare_obj [options] <model> <gt_poses> <predicted_poses>" << endl
+         << "       compare_obj [options] --list=<file>" << endl
+         << "  --list=<file>             evaluate all sequences of a file with one line 'model gt_poses predicted_poses' per sequence" << endl
+         << "  --units_per_meter=<f>     the number of model units per meter (default 1000)" << endl
+         << "  --skip=<n>                the number of frames skipped at the beginning of each sequence (default 0)" << endl
+         << "  --curves=<file>           write the ADD, ADD-S, rotation and translation error curves into a CSV file" << endl
+         << "  --verbose                 print the errors of every frame" << endl;
+}
 
-    compareModels(objPoints, plyPoints, "OBJ", "PLY");
 
+int main(int argc, char *argv[])
+{
+    EvaluationOptions options;
+    options.unitsPerMeter = 1000.0f;
+    options.skipFrames = 0;
+    options.verbose = false;
+    
+    string listFile;
+    vector<string> positional;
+    
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        
+        if(arg.compare(0, 2, "--") != 0)
+        {
+            positional.push_back(arg);
+            continue;
+        }
+        
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        
+        if(key == "--list")
+            listFile = value;
+        else if(key == "--units_per_meter")
+            options.unitsPerMeter = atof(value.c_str());
+        else if(key == "--skip")
+            options.skipFrames = atoi(value.c_str());
+        else if(key == "--curves")
+            options.curvesCSV = value;
+        else if(key == "--verbose")
+            options.verbose = true;
+        else
+        {
+            printUsage();
+            return arg == "--help" ? 0 : -1;
+        }
+    }
+    
+    // each sequence is given by its model, ground truth and predicted pose files
+    vector<vector<string> > sequences;
+    
+    if(!listFile.empty())
+    {
+        ifstream file(listFile.c_str());
+        if(!file.is_open())
+        {
+            cerr << "Failed to open sequence list: " << listFile << endl;
+            return -1;
+        }
+        
+        string line;
+        while(getline(file, line))
+        {
+            istringstream iss(line);
+            vector<string> sequence(3);
+            if(line.empty() || line[0] == '#' || !(iss >> sequence[0] >> sequence[1] >> sequence[2]))
+                continue;
+            sequences.push_back(sequence);
+        }
+    }
+    else if(positional.size() == 3)
+    {
+        sequences.push_back(positional);
+    }
+    else
+    {
+        printUsage();
+        return -1;
+    }
+    
+    ofstream curvesFile;
+    if(!options.curvesCSV.empty())
+    {
+        curvesFile.open(options.curvesCSV.c_str());
+        curvesFile << "sequence,add_threshold,add,adds,rotation_threshold_deg,rotation,translation_threshold_cm,translation\n";
+    }
+    
+    // the diameter and k-d tree of each model are only computed once
+    map<string, PoseMetrics*> models;
+    
+    ErrorStatistics total;
+    
+    cout << left << setw(40) << "Sequence" << right << setw(8) << "Frames" << setw(10) << "ADD%" << setw(10) << "ADD-S%" << setw(10) << "5cm5deg%"
+         << setw(10) << "AUC ADD" << setw(10) << "AUC ADDS" << setw(10) << "R [deg]" << setw(10) << "t" << endl;
+    cout << string(118, '-') << endl;
+    
+    int64 start = getTickCount();
+    
+    for(int s = 0; s < sequences.size(); s++)
+    {
+        const string &modelFile = sequences[s][0];
+        
+        if(models.find(modelFile) == models.end())
+        {
+            vector<Vec3f> points;
+            if(!loadModelPoints(modelFile, points))
+            {
+                cerr << "Failed to load model: " << modelFile << endl;
+                models[modelFile] = NULL;
+            }
+            else
+            {
+                models[modelFile] = new PoseMetrics(points);
+            }
+        }
+        
+        PoseMetrics *poseMetrics = models[modelFile];
+        if(poseMetrics == NULL)
+            continue;
+        
+        ErrorStatistics stats;
+        if(!evaluateSequence(poseMetrics, sequences[s][1], sequences[s][2], options, stats))
+            continue;
+        
+        printStatistics(sequences[s][2], stats);
+        
+        if(curvesFile.is_open())
+            writeCurves(curvesFile, sequences[s][2], stats);
+        
+        total.add(stats);
+    }
+    
+    if(sequences.size() > 1)
+    {
+        cout << string(118, '-') << endl;
+        printStatistics("Total", total);
+        
+        if(curvesFile.is_open())
+            writeCurves(curvesFile, "total", total);
+    }
+    
+    cout << "Evaluated " << total.numFrames << " frames in " << (getTickCount() - start)/getTickFrequency() << " s" << endl;
+    
+    for(map<string, PoseMetrics*>::iterator it = models.begin(); it != models.end(); it++)
+    {
+        delete it->second;
+    }
+    
     return 0;
 }
-*/
@@ -0,0 +1,358 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "convex_hull.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace std;
+using namespace cv;
+
+ConvexHull::ConvexHull(const vector<Vec3f> &points)
+{
+    for(int i = 0; i < points.size(); i++)
+    {
+        Vec3d p = points[i];
+        this->points.push_back(p);
+    }
+    
+    degenerate = false;
+    
+    if(!initSimplex())
+    {
+        degenerate = true;
+        faces.clear();
+        
+        for(int i = 0; i < points.size(); i++)
+        {
+            vertexIDs.push_back(i);
+        }
+        return;
+    }
+    
+    // assign every point to the first face it lies in front of
+    for(int i = 0; i < this->points.size(); i++)
+    {
+        for(int f = 0; f < faces.size(); f++)
+        {
+            if(distance(faces[f], i) > epsilon)
+            {
+                faces[f].outside.push_back(i);
+                break;
+            }
+        }
+    }
+    
+    // new faces are appended and processed within the same pass
+    for(int f = 0; f < faces.size(); f++)
+    {
+        if(faces[f].removed || faces[f].outside.empty())
+            continue;
+        
+        // the farthest point in front of the face is a vertex of the hull
+        int apex = -1;
+        double maxDist = -1;
+        for(int i = 0; i < faces[f].outside.size(); i++)
+        {
+            double d = distance(faces[f], faces[f].outside[i]);
+            if(d > maxDist)
+            {
+                maxDist = d;
+                apex = faces[f].outside[i];
+            }
+        }
+        
+        // find the connected region of faces visible from the apex and its horizon
+        vector<int> visible;
+        vector<pair<int, int> > horizon;
+        vector<int> stack(1, f);
+        faces[f].visited = f;
+        while(!stack.empty())
+        {
+            int g = stack.back();
+            stack.pop_back();
+            visible.push_back(g);
+            
+            for(int k = 0; k < 3; k++)
+            {
+                int h = faces[g].adjacent[k];
+                if(faces[h].visited == f)
+                    continue;
+                
+                if(distance(faces[h], apex) > epsilon)
+                {
+                    faces[h].visited = f;
+                    stack.push_back(h);
+                }
+                else
+                {
+                    horizon.push_back(make_pair(g, k));
+                }
+            }
+        }
+        
+        vector<int> orphans;
+        for(int i = 0; i < visible.size(); i++)
+        {
+            Face &face = faces[visible[i]];
+            face.removed = true;
+            
+            for(int j = 0; j < face.outside.size(); j++)
+            {
+                if(face.outside[j] != apex)
+                    orphans.push_back(face.outside[j]);
+            }
+            face.outside.clear();
+        }
+        
+        // connect every horizon edge to the apex
+        int firstNew = (int)faces.size();
+        map<int, int> byStart, byEnd;
+        for(int i = 0; i < horizon.size(); i++)
+        {
+            Vec3i v = faces[horizon[i].first].v;
+            int k = horizon[i].second;
+            int a = v[k];
+            int b = v[(k + 1)%3];
+            int h = faces[horizon[i].first].adjacent[k];
+            
+            int n = addFace(a, b, apex);
+            faces[n].adjacent[0] = h;
+            for(int j = 0; j < 3; j++)
+            {
+                if(faces[h].adjacent[j] == horizon[i].first)
+                    faces[h].adjacent[j] = n;
+            }
+            
+            byStart[a] = n;
+            byEnd[b] = n;
+        }
+        for(int n = firstNew; n < faces.size(); n++)
+        {
+            faces[n].adjacent[1] = byStart[faces[n].v[1]];
+            faces[n].adjacent[2] = byEnd[faces[n].v[0]];
+        }
+        
+        // points in front of none of the new faces are inside the hull
+        for(int i = 0; i < orphans.size(); i++)
+        {
+            for(int g = firstNew; g < faces.size(); g++)
+            {
+                if(distance(faces[g], orphans[i]) > epsilon)
+                {
+                    faces[g].outside.push_back(orphans[i]);
+                    break;
+                }
+            }
+        }
+    }
+    
+    vector<bool> onHull(points.size(), false);
+    for(int f = 0; f < faces.size(); f++)
+    {
+        if(faces[f].removed)
+            continue;
+        
+        for(int k = 0; k < 3; k++)
+            onHull[faces[f].v[k]] = true;
+    }
+    for(int i = 0; i < onHull.size(); i++)
+    {
+        if(onHull[i])
+            vertexIDs.push_back(i);
+    }
+}
+
+
+vector<int> ConvexHull::getVertexIDs()
+{
+    return vertexIDs;
+}
+
+
+vector<Vec3i> ConvexHull::getFaces()
+{
+    vector<Vec3i> res;
+    for(int f = 0; f < faces.size(); f++)
+    {
+        if(!faces[f].removed)
+            res.push_back(faces[f].v);
+    }
+    return res;
+}
+
+
+bool ConvexHull::isDegenerate()
+{
+    return degenerate;
+}
+
+
+bool ConvexHull::initSimplex()
+{
+    if(points.size() < 4)
+        return false;
+    
+    // the extreme points along the coordinate axes
+    int extremes[6] = {0, 0, 0, 0, 0, 0};
+    for(int i = 0; i < points.size(); i++)
+    {
+        for(int k = 0; k < 3; k++)
+        {
+            if(points[i][k] < points[extremes[2*k]][k]) extremes[2*k] = i;
+            if(points[i][k] > points[extremes[2*k + 1]][k]) extremes[2*k + 1] = i;
+        }
+    }
+    
+    double scale = 0;
+    for(int k = 0; k < 3; k++)
+    {
+        scale = std::max(scale, points[extremes[2*k + 1]][k] - points[extremes[2*k]][k]);
+    }
+    epsilon = 1e-6*scale;
+    
+    // the two most distant extreme points
+    int a = -1, b = -1;
+    double maxDist = 0;
+    for(int i = 0; i < 6; i++)
+    {
+        for(int j = i + 1; j < 6; j++)
+        {
+            double d = norm(points[extremes[i]] - points[extremes[j]]);
+            if(d > maxDist)
+            {
+                maxDist = d;
+                a = extremes[i];
+                b = extremes[j];
+            }
+        }
+    }
+    if(maxDist <= epsilon)
+        return false;
+    
+    // the point farthest from the line through both
+    Vec3d dir = (points[b] - points[a])/maxDist;
+    int c = -1;
+    maxDist = 0;
+    for(int i = 0; i < points.size(); i++)
+    {
+        double d = norm((points[i] - points[a]).cross(dir));
+        if(d > maxDist)
+        {
+            maxDist = d;
+            c = i;
+        }
+    }
+    if(maxDist <= epsilon)
+        return false;
+    
+    // the point farthest from the plane through all three
+    Vec3d n = (points[b] - points[a]).cross(points[c] - points[a]);
+    n = n/norm(n);
+    int d = -1;
+    maxDist = 0;
+    for(int i = 0; i < points.size(); i++)
+    {
+        double dist = fabs(n.dot(points[i] - points[a]));
+        if(dist > maxDist)
+        {
+            maxDist = dist;
+            d = i;
+        }
+    }
+    if(maxDist <= epsilon)
+        return false;
+    
+    interior = (points[a] + points[b] + points[c] + points[d])*0.25;
+    
+    // orient the faces of the tetrahedron away from its interior
+    int tetrahedron[4][3] = {{a, b, c}, {a, b, d}, {a, c, d}, {b, c, d}};
+    for(int i = 0; i < 4; i++)
+    {
+        int *t = tetrahedron[i];
+        Vec3d n = (points[t[1]] - points[t[0]]).cross(points[t[2]] - points[t[0]]);
+        if(n.dot(interior - points[t[0]]) > 0)
+            std::swap(t[1], t[2]);
+        
+        addFace(t[0], t[1], t[2]);
+    }
+    
+    // every directed edge is shared with the reversed edge of a neighboring face
+    for(int f = 0; f < 4; f++)
+    {
+        for(int k = 0; k < 3; k++)
+        {
+            int v0 = faces[f].v[k];
+            int v1 = faces[f].v[(k + 1)%3];
+            for(int g = 0; g < 4; g++)
+            {
+                for(int j = 0; j < 3; j++)
+                {
+                    if(faces[g].v[j] == v1 && faces[g].v[(j + 1)%3] == v0)
+                        faces[f].adjacent[k] = g;
+                }
+            }
+        }
+    }
+    
+    return true;
+}
+
+
+int ConvexHull::addFace(int a, int b, int c)
+{
+    Face face;
+    face.v = Vec3i(a, b, c);
+    face.adjacent = Vec3i(-1, -1, -1);
+    face.removed = false;
+    face.visited = -1;
+    
+    Vec3d n = (points[b] - points[a]).cross(points[c] - points[a]);
+    double l = norm(n);
+    face.normal = l > 0 ? n/l : n;
+    face.offset = face.normal.dot(points[a]);
+    
+    faces.push_back(face);
+    
+    return (int)faces.size() - 1;
+}
+
+
+double ConvexHull::distance(const Face &face, int p)
+{
+    return face.normal.dot(points[p]) - face.offset;
+}
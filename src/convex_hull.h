@@ -0,0 +1,126 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef CONVEX_HULL_H
+#define CONVEX_HULL_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  This class computes the convex hull of a 3D point set using the Quickhull
+ *  algorithm (Barber et al., The Quickhull Algorithm for Convex Hulls, 1996).
+ *  The hull is represented by the indices of the input points that form its
+ *  vertices and by its outward oriented triangular faces. Faces visible from a
+ *  new hull vertex are found by traversing the face adjacency, so that the
+ *  running time is close to linear in the number of points for typical models. For point sets that
+ *  do not span a volume (e.g. planar models) the hull is degenerate and
+ *  contains all input points.
+ */
+class ConvexHull
+{
+public:
+    /**
+     *  Constructor computing the convex hull of a given point set.
+     *
+     *  @param  points The 3D points.
+     */
+    ConvexHull(const std::vector<cv::Vec3f> &points);
+    
+    /**
+     *  Returns the indices of all input points that are vertices of the hull.
+     *
+     *  @return The indices of the hull vertices.
+     */
+    std::vector<int> getVertexIDs();
+    
+    /**
+     *  Returns the outward oriented triangular faces of the hull as triples
+     *  of input point indices.
+     *
+     *  @return The faces of the hull.
+     */
+    std::vector<cv::Vec3i> getFaces();
+    
+    /**
+     *  Tells whether the point set does not span a volume, in which case
+     *  getVertexIDs() returns all points and getFaces() is empty.
+     *
+     *  @return True if the hull is degenerate and false otherwise.
+     */
+    bool isDegenerate();
+    
+private:
+    struct Face
+    {
+        cv::Vec3i v;
+        
+        // the neighboring faces across the edges (v0, v1), (v1, v2) and (v2, v0)
+        cv::Vec3i adjacent;
+        
+        cv::Vec3d normal;
+        double offset;
+        
+        std::vector<int> outside;
+        
+        bool removed;
+        
+        int visited;
+    };
+    
+    std::vector<cv::Vec3d> points;
+    
+    std::vector<Face> faces;
+    
+    std::vector<int> vertexIDs;
+    
+    // a point inside the initial tetrahedron used to orient its faces outwards
+    cv::Vec3d interior;
+    
+    bool degenerate;
+    
+    double epsilon;
+    
+    bool initSimplex();
+    
+    int addFace(int a, int b, int c);
+    
+    double distance(const Face &face, int p);
+};
+
+#endif /* CONVEX_HULL_H */
@@ -10,6 +10,7 @@
 
 #include "object3d.h"
 #include "pose_estimator6d.h"
+#include "pose_log.h"
 
 using namespace std;
 using namespace cv;
@@ -47,24 +48,6 @@ cv::Mat drawResultOverlay(const vector<Object3D*>& objects, const cv::Mat& frame
     return result;
 }
 
-void savePoseToFile(const cv::Matx44f& pose, int frameIndex, const std::string& filename)
-{
-    std::ofstream file(filename, std::ios::app);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open pose output file: " << filename << std::endl;
-        return;
-    }
-
-    file << std::fixed << std::setprecision(6);
-    file << frameIndex << "\t";
-    for (int i = 0; i < 12; ++i)
-    {
-        file << pose.val[i] << "\t";
-    }
-    file << "\n";
-    file.close();
-}
-
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
@@ -112,6 +95,9 @@ int main(int argc, char *argv[])
         cerr << "Failed to open video writer!" << endl;
         return -1;
     }
+    // log the predicted poses into a binary file, which is converted into text at the end
+    PoseLogWriter poseLog("predicted_cube.rpl", "cube_new.obj", "frames");
+    
     for (int i = 0; i <=644; ++i)
     {
         std::stringstream ss;
@@ -139,7 +125,7 @@ int main(int argc, char *argv[])
         }
 
         // 保存预测的位姿矩阵
-        savePoseToFile(objects[0]->getPose(), i, "predicted_cube.txt");
+        poseLog.write(i, objects[0]->getPose());
 
         // 绘制结果
         cv::Mat result = drawResultOverlay(objects, frame);
@@ -148,6 +134,11 @@ int main(int argc, char *argv[])
         cv::waitKey(1);  // 等待1ms，以便显示结果
     }
     writer.release();
+    
+    // keep the row-major layout of the 4x4 matrix after the frame index, which the evaluation of this file expects
+    poseLog.close();
+    convertPoseLogToText("predicted_cube.rpl", "predicted_cube.txt", true, true);
+    
     // deactivate the offscreen rendering OpenGL context
     RenderingEngine::Instance()->doneCurrent();
 
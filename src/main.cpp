@@ -9,6 +9,8 @@
 #include <iomanip>
 #include "object3d.h"
 #include "pose_estimator6d.h"
+#include "profiler.h"
+#include "pose_log.h"
 
 using namespace std;
 using namespace cv;
@@ -41,18 +43,6 @@ vector<Matx44f> loadPoses(const string& filename) {
     return poses;
 }
 
-// 保存位姿到文件
-void savePoseToFile(const Matx44f& pose, const string& filename) {
-    ofstream file(filename, ios::app);
-    file << fixed << setprecision(6);
-    for (int i = 0; i < 3; ++i)
-        for (int j = 0; j < 3; ++j)
-            file << pose(i, j) << "\t";
-    for (int i = 0; i < 3; ++i)
-        file << pose(i, 3) << "\t";
-    file << "\n";
-}
-
 // 绘制结果叠加
 Mat drawResultOverlay(const vector<Object3D*>& objects, const Mat& frame) {
     RenderingEngine::Instance()->setLevel(0);
@@ -89,7 +79,8 @@ int main(int argc, char *argv[]) {
     vector<float> distances = {200.0f, 400.0f,  600.0f};
 
     vector<Object3D*> objects;
-    Object3D* obj = new Object3D("/media/jyj/JYJ/RBOT-dataset/bakingsoda/bakingsoda.obj",
+    string modelPath = "/media/jyj/JYJ/RBOT-dataset/bakingsoda/bakingsoda.obj";
+    Object3D* obj = new Object3D(modelPath,
                                  0, 0, 500, 0, 0, 0, 1.0, 0.55f, distances);
     obj->setPose(gtPoses[0]);
     obj->setInitialPose(gtPoses[0]);
@@ -98,11 +89,19 @@ int main(int argc, char *argv[]) {
     PoseEstimator6D* estimator = new PoseEstimator6D(width, height, zNear, zFar, K, distCoeffs, objects);
     RenderingEngine::Instance()->makeCurrent();
 
+#ifdef RBOT_ENABLE_PROFILING
+    // 记录各作用域的时间线，用于导出 Chrome trace
+    Profiler::Instance()->setTraceEnabled(true);
+#endif
+
     // 运行时统计
     TickMeter timer;
     double totalTimeMs = 0.0;
     int validFrames = 0;
 
+    // 预测位姿写入二进制日志，结束时再转换为文本格式
+    PoseLogWriter poseLog("predicted_poses_bs.rpl", modelPath, "a_regular");
+
     for (int i = 0; i <= 1000; ++i) {
         stringstream ss;
         //ss << "/media/jyj/JYJ/RBOT-dataset/RBOT_dataset_p3/duck/frames/a_regular"
@@ -132,13 +131,10 @@ int main(int argc, char *argv[]) {
             Vec3f t_gt(gt(0,3), gt(1,3), gt(2,3));
             float t_err = norm((t_pred - t_gt) * 0.001f); // mm -> m
 
-            Matx33f R_pred(pred.val);  // 前3x3
-            Matx33f R_gt(gt.val);
-            Matx33f R_err = R_pred.t() * R_gt;
-            float trace_R = R_err(0,0) + R_err(1,1) + R_err(2,2);
-            float angle_rad = acosf(std::max(-1.0f, std::min(1.0f, (trace_R - 1.0f) / 2.0f)));
-            savePoseToFile(objects[0]->getPose(), "predicted_poses_bs.txt");
-            if (t_err > 0.05f || angle_rad > 0.0873f) {
+            float angle_rad = Transformations::rotationError(pred, gt);
+            bool lost = (t_err > 0.05f || angle_rad > 0.0873f);
+            poseLog.write(i, objects[0]->getPose(), lost ? PoseLogRecord::LOST : PoseLogRecord::TRACKING);
+            if (lost) {
                 objects[0]->setPose(gt);
                 //objects[0]->setInitialPose(gt);
                 //estimator->toggleTracking(frame, 0, true);
@@ -153,14 +149,15 @@ int main(int argc, char *argv[]) {
         validFrames++;
         timer.reset();
 
-        //savePoseToFile(objects[0]->getPose(), "predicted_poses_cat.txt");
-
         // 可视化（可选）
         Mat result = drawResultOverlay(objects, frame);
         imshow("Tracking Result", result);
         waitKey(1);
     }
 
+    poseLog.close();
+    convertPoseLogToText("predicted_poses_bs.rpl", "predicted_poses_bs.txt");
+
     // 输出平均耗时
     if (validFrames > 0) {
         double avgRuntime = totalTimeMs / validFrames;
@@ -168,6 +165,13 @@ int main(int argc, char *argv[]) {
         cout << "Avg. Runtime per frame: " << fixed << setprecision(2) << avgRuntime << " ms" << endl;
     }
 
+#ifdef RBOT_ENABLE_PROFILING
+    // 导出各阶段耗时与计数
+    Profiler::Instance()->exportCSV("profile_frames.csv");
+    Profiler::Instance()->exportJSON("profile_frames.json");
+    Profiler::Instance()->exportChromeTrace("profile_trace.json");
+#endif
+
     RenderingEngine::Instance()->doneCurrent();
     RenderingEngine::Instance()->destroy();
     for (auto* o : objects) delete o;
@@ -0,0 +1,395 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "mesh_decimation.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace cv;
+
+MeshDecimation::MeshDecimation(const vector<Vec3f> &vertices, const vector<unsigned int> &indices, float creaseAngle)
+{
+    this->vertices = vertices;
+    
+    int numVertices = (int)vertices.size();
+    
+    vertexRemoved.assign(numVertices, false);
+    vertexTriangles.resize(numVertices);
+    quadrics.assign(numVertices, Matx44d::zeros());
+    
+    numTriangles = 0;
+    
+    vector<Vec3d> faceNormals;
+    
+    for(int i = 0; i + 2 < indices.size(); i += 3)
+    {
+        Vec3i tri(indices[i], indices[i + 1], indices[i + 2]);
+        
+        Vec3d a = vertices[tri[0]], b = vertices[tri[1]], c = vertices[tri[2]];
+        Vec3d n = (b - a).cross(c - a);
+        double area2 = norm(n);
+        
+        bool degenerate = tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2] || area2 == 0;
+        
+        int t = (int)triangles.size();
+        triangles.push_back(tri);
+        triangleRemoved.push_back(degenerate);
+        faceNormals.push_back(degenerate ? Vec3d(0, 0, 0) : n/area2);
+        
+        if(degenerate)
+            continue;
+        
+        numTriangles++;
+        
+        for(int k = 0; k < 3; k++)
+        {
+            vertexTriangles[tri[k]].push_back(t);
+            
+            // the quadric of the supporting plane weighted by the triangle area
+            addPlaneQuadric(tri[k], faceNormals[t], a, area2/2);
+        }
+    }
+    
+    // collect all undirected edges with their adjacent triangles
+    vector<pair<pair<int, int>, int> > edges;
+    for(int t = 0; t < triangles.size(); t++)
+    {
+        if(triangleRemoved[t])
+            continue;
+        
+        for(int k = 0; k < 3; k++)
+        {
+            int v0 = triangles[t][k];
+            int v1 = triangles[t][(k + 1)%3];
+            edges.push_back(make_pair(make_pair(std::min(v0, v1), std::max(v0, v1)), t));
+        }
+    }
+    sort(edges.begin(), edges.end());
+    
+    double cosCrease = cos(creaseAngle*CV_PI/180.0);
+    
+    // penalize moving the vertices of boundary and crease edges away from the planes perpendicular to them
+    for(int i = 0; i < edges.size();)
+    {
+        int j = i;
+        while(j < edges.size() && edges[j].first == edges[i].first)
+            j++;
+        
+        int v0 = edges[i].first.first;
+        int v1 = edges[i].first.second;
+        
+        Vec3d p0 = vertices[v0];
+        Vec3d p1 = vertices[v1];
+        Vec3d e = p1 - p0;
+        double length2 = e.dot(e);
+        
+        bool boundary = (j - i) == 1;
+        bool crease = (j - i) == 2 && faceNormals[edges[i].second].dot(faceNormals[edges[i + 1].second]) < cosCrease;
+        
+        if(boundary || crease)
+        {
+            for(int k = i; k < j; k++)
+            {
+                Vec3d n = e.cross(faceNormals[edges[k].second]);
+                double l = norm(n);
+                if(l == 0)
+                    continue;
+                
+                addPlaneQuadric(v0, n/l, p0, 100.0*length2);
+                addPlaneQuadric(v1, n/l, p0, 100.0*length2);
+            }
+        }
+        
+        i = j;
+    }
+    
+    for(int v = 0; v < numVertices; v++)
+    {
+        pushCollapses(v);
+    }
+}
+
+
+int MeshDecimation::decimate(int targetTriangles)
+{
+    while(numTriangles > targetTriangles && !heap.empty())
+    {
+        Collapse c = heap.top();
+        heap.pop();
+        
+        if(vertexRemoved[c.from] || vertexRemoved[c.to])
+            continue;
+        
+        // the costs only grow as quadrics are accumulated, so outdated entries are re-queued lazily
+        double cost = computeCost(c.from, c.to);
+        if(cost > c.cost*(1.0 + 1e-6) + 1e-12)
+        {
+            c.cost = cost;
+            heap.push(c);
+            continue;
+        }
+        
+        if(!isCollapseValid(c.from, c.to))
+            continue;
+        
+        collapse(c.from, c.to);
+        
+        pushCollapses(c.to);
+    }
+    
+    return numTriangles;
+}
+
+
+vector<unsigned int> MeshDecimation::getIndices()
+{
+    vector<unsigned int> indices;
+    indices.reserve(3*numTriangles);
+    
+    for(int t = 0; t < triangles.size(); t++)
+    {
+        if(triangleRemoved[t])
+            continue;
+        
+        indices.push_back(triangles[t][0]);
+        indices.push_back(triangles[t][1]);
+        indices.push_back(triangles[t][2]);
+    }
+    
+    return indices;
+}
+
+
+vector<int> MeshDecimation::getVertexIDs()
+{
+    vector<bool> used(vertices.size(), false);
+    
+    for(int t = 0; t < triangles.size(); t++)
+    {
+        if(triangleRemoved[t])
+            continue;
+        
+        for(int k = 0; k < 3; k++)
+            used[triangles[t][k]] = true;
+    }
+    
+    vector<int> ids;
+    for(int v = 0; v < used.size(); v++)
+    {
+        if(used[v])
+            ids.push_back(v);
+    }
+    
+    return ids;
+}
+
+
+float MeshDecimation::getMeanEdgeLength()
+{
+    double sum = 0;
+    int count = 0;
+    
+    for(int t = 0; t < triangles.size(); t++)
+    {
+        if(triangleRemoved[t])
+            continue;
+        
+        for(int k = 0; k < 3; k++)
+        {
+            sum += norm(vertices[triangles[t][k]] - vertices[triangles[t][(k + 1)%3]]);
+            count++;
+        }
+    }
+    
+    return count > 0 ? (float)(sum/count) : 0.0f;
+}
+
+
+int MeshDecimation::getNumTriangles()
+{
+    return numTriangles;
+}
+
+
+void MeshDecimation::addPlaneQuadric(int v, const Vec3d &normal, const Vec3d &point, double weight)
+{
+    Vec4d p(normal[0], normal[1], normal[2], -normal.dot(point));
+    
+    quadrics[v] += weight*(Matx41d(p)*Matx41d(p).t());
+}
+
+
+double MeshDecimation::computeCost(int from, int to)
+{
+    Vec3f v = vertices[to];
+    Matx41d p(v[0], v[1], v[2], 1.0);
+    
+    return ((p.t()*(quadrics[from] + quadrics[to]))*p)(0, 0);
+}
+
+
+void MeshDecimation::pushCollapses(int v)
+{
+    vector<int> neighbors;
+    getNeighbors(v, neighbors);
+    
+    for(int i = 0; i < neighbors.size(); i++)
+    {
+        int w = neighbors[i];
+        
+        Collapse c1 = {computeCost(v, w), v, w};
+        Collapse c2 = {computeCost(w, v), w, v};
+        heap.push(c1);
+        heap.push(c2);
+    }
+}
+
+
+void MeshDecimation::getNeighbors(int v, vector<int> &neighbors)
+{
+    neighbors.clear();
+    
+    const vector<int> &tris = vertexTriangles[v];
+    for(int i = 0; i < tris.size(); i++)
+    {
+        int t = tris[i];
+        if(triangleRemoved[t])
+            continue;
+        
+        for(int k = 0; k < 3; k++)
+        {
+            if(triangles[t][k] != v)
+                neighbors.push_back(triangles[t][k]);
+        }
+    }
+    
+    sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(unique(neighbors.begin(), neighbors.end()), neighbors.end());
+}
+
+
+bool MeshDecimation::isCollapseValid(int from, int to)
+{
+    vector<int> neighborsFrom, neighborsTo;
+    getNeighbors(from, neighborsFrom);
+    getNeighbors(to, neighborsTo);
+    
+    if(!binary_search(neighborsFrom.begin(), neighborsFrom.end(), to))
+        return false;
+    
+    int numShared = 0;
+    
+    const vector<int> &tris = vertexTriangles[from];
+    for(int i = 0; i < tris.size(); i++)
+    {
+        int t = tris[i];
+        if(triangleRemoved[t])
+            continue;
+        
+        Vec3i tri = triangles[t];
+        if(tri[0] == to || tri[1] == to || tri[2] == to)
+        {
+            numShared++;
+            continue;
+        }
+        
+        // the triangle must not flip or degenerate when moving the vertex
+        Vec3d target = vertices[to];
+        Vec3d p[3], q[3];
+        for(int k = 0; k < 3; k++)
+        {
+            p[k] = vertices[tri[k]];
+            q[k] = tri[k] == from ? target : p[k];
+        }
+        
+        Vec3d n0 = (p[1] - p[0]).cross(p[2] - p[0]);
+        Vec3d n1 = (q[1] - q[0]).cross(q[2] - q[0]);
+        
+        if(norm(n1) == 0 || n0.dot(n1) <= 0)
+            return false;
+    }
+    
+    // link condition: the edge may only share the opposite vertices of its triangles
+    vector<int> common;
+    set_intersection(neighborsFrom.begin(), neighborsFrom.end(), neighborsTo.begin(), neighborsTo.end(), back_inserter(common));
+    
+    return (int)common.size() == numShared;
+}
+
+
+void MeshDecimation::collapse(int from, int to)
+{
+    vector<int> &trisFrom = vertexTriangles[from];
+    vector<int> &trisTo = vertexTriangles[to];
+    
+    for(int i = 0; i < trisFrom.size(); i++)
+    {
+        int t = trisFrom[i];
+        if(triangleRemoved[t])
+            continue;
+        
+        Vec3i &tri = triangles[t];
+        if(tri[0] == to || tri[1] == to || tri[2] == to)
+        {
+            triangleRemoved[t] = true;
+            numTriangles--;
+        }
+        else
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                if(tri[k] == from)
+                    tri[k] = to;
+            }
+            trisTo.push_back(t);
+        }
+    }
+    
+    quadrics[to] += quadrics[from];
+    
+    vertexRemoved[from] = true;
+    trisFrom.clear();
+    
+    // drop the triangles that have just been removed from the adjacency of the remaining vertex
+    vector<int> alive;
+    for(int i = 0; i < trisTo.size(); i++)
+    {
+        if(!triangleRemoved[trisTo[i]])
+            alive.push_back(trisTo[i]);
+    }
+    trisTo.swap(alive);
+}
@@ -0,0 +1,152 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef MESH_DECIMATION_H
+#define MESH_DECIMATION_H
+
+#include <vector>
+#include <queue>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  This class implements quadric error metric based mesh decimation by
+ *  half-edge collapses (Garland and Heckbert, Surface Simplification Using
+ *  Quadric Error Metrics, 1997). A vertex is always collapsed onto one of its
+ *  neighbors, so that the remaining vertices keep their original positions and
+ *  indices. This allows the decimated meshes to share the vertex data and any
+ *  per vertex information (e.g. the tclc-histograms) with the original mesh.
+ *  Boundary edges and sharp crease edges, which are likely to form the
+ *  silhouette of the object, are preserved by additional constraint quadrics.
+ *  Decimation is incremental, i.e. a chain of levels of detail is obtained by
+ *  calling decimate() with decreasing numbers of triangles.
+ */
+class MeshDecimation
+{
+public:
+    /**
+     *  Constructor setting up the decimation of an indexed triangle mesh.
+     *
+     *  @param  vertices The 3D vertex positions of the mesh.
+     *  @param  indices The triangle list with three vertex indices per triangle.
+     *  @param  creaseAngle The minimal dihedral angle in degrees of edges to be preserved (default = 60).
+     */
+    MeshDecimation(const std::vector<cv::Vec3f> &vertices, const std::vector<unsigned int> &indices, float creaseAngle = 60.0f);
+    
+    /**
+     *  Collapses edges in the order of increasing quadric error until the mesh
+     *  has at most the given number of triangles or no further edge can be
+     *  collapsed without flipping a triangle or breaking the manifold topology.
+     *
+     *  @param  targetTriangles The desired number of remaining triangles.
+     *
+     *  @return The number of remaining triangles.
+     */
+    int decimate(int targetTriangles);
+    
+    /**
+     *  Returns the triangle list of the current decimated mesh indexing the
+     *  original vertices.
+     *
+     *  @return The triangle list of the decimated mesh.
+     */
+    std::vector<unsigned int> getIndices();
+    
+    /**
+     *  Returns the indices of all vertices referenced by the current decimated mesh
+     *  in ascending order.
+     *
+     *  @return The indices of the remaining vertices.
+     */
+    std::vector<int> getVertexIDs();
+    
+    /**
+     *  Returns the average length of all edges of the current decimated mesh.
+     *
+     *  @return The average edge length in model coordinates.
+     */
+    float getMeanEdgeLength();
+    
+    /**
+     *  Returns the number of triangles of the current decimated mesh.
+     *
+     *  @return The number of remaining triangles.
+     */
+    int getNumTriangles();
+    
+private:
+    struct Collapse
+    {
+        double cost;
+        int from;
+        int to;
+        
+        bool operator<(const Collapse &c) const
+        {
+            // smallest cost first within a std::priority_queue
+            return cost > c.cost;
+        }
+    };
+    
+    std::vector<cv::Vec3f> vertices;
+    std::vector<cv::Vec3i> triangles;
+    std::vector<bool> triangleRemoved;
+    std::vector<bool> vertexRemoved;
+    
+    // the triangles adjacent to every vertex, including removed ones that are skipped lazily
+    std::vector<std::vector<int> > vertexTriangles;
+    
+    std::vector<cv::Matx44d> quadrics;
+    
+    std::priority_queue<Collapse> heap;
+    
+    int numTriangles;
+    
+    void addPlaneQuadric(int v, const cv::Vec3d &normal, const cv::Vec3d &point, double weight);
+    
+    double computeCost(int from, int to);
+    
+    void pushCollapses(int v);
+    
+    void getNeighbors(int v, std::vector<int> &neighbors);
+    
+    bool isCollapseValid(int from, int to);
+    
+    void collapse(int from, int to);
+};
+
+#endif /* MESH_DECIMATION_H */
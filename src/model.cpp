@@ -35,8 +35,12 @@
 
 #include "model.h"
 #include "tclc_histograms.h"
+#include "mesh_decimation.h"
+#include "convex_hull.h"
 
 #include <limits>
+#include <deque>
+#include <algorithm>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -68,6 +72,14 @@ Model::Model(const string modelFilename, float tx, float ty, float tz, float alp
     
     hasNormals = false;
     
+    T_q = Matx44f::eye();
+    
+    indexType = GL_UNSIGNED_INT;
+    
+    lodThreshold = 3.0f;
+    
+    transformedLOD = 0;
+    
     vertexBuffer = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
     normalBuffer = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
     indexBuffer = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
@@ -80,10 +92,19 @@ Model::~Model()
 {
     vertices.clear();
     normals.clear();
+    hullVertices.clear();
     
     indices.clear();
     offsets.clear();
     
+    weldIDs.clear();
+    
+    lodIndices.clear();
+    lodVertexIDs.clear();
+    lodEdges.clear();
+    lodFacePlanes.clear();
+    lodProjections.clear();
+    
     if(buffersInitialsed)
     {
         vertexBuffer.release();
@@ -98,25 +119,224 @@ Model::~Model()
 
 void Model::initBuffers()
 {
+    // all levels of detail share the vertices and are stored one after the other in the index buffer
+    vector<GLuint> gpuIndices = indices;
+    
+    lodOffsets.clear();
+    lodOffsets.push_back(0);
+    for(int l = 0; l < lodIndices.size(); l++)
+    {
+        lodOffsets.push_back((GLuint)gpuIndices.size());
+        gpuIndices.insert(gpuIndices.end(), lodIndices[l].begin(), lodIndices[l].end());
+    }
+    
+    // reorder the triangles of every index range for the post-transform vertex cache
+    for(int i = 0; i < (int)offsets.size() - 1; i++)
+    {
+        optimizeVertexCache(gpuIndices, offsets[i], offsets[i + 1], (int)vertices.size(), 16);
+    }
+    for(int l = 1; l < lodOffsets.size(); l++)
+    {
+        optimizeVertexCache(gpuIndices, lodOffsets[l], lodOffsets[l] + (int)lodIndices[l - 1].size(), (int)vertices.size(), 16);
+    }
+    
+    // renumber the vertices in the order of their first use, so that they are fetched sequentially
+    vector<int> remap(vertices.size(), -1);
+    vector<int> order;
+    for(int i = 0; i < gpuIndices.size(); i++)
+    {
+        GLuint v = gpuIndices[i];
+        if(remap[v] < 0)
+        {
+            remap[v] = (int)order.size();
+            order.push_back(v);
+        }
+        gpuIndices[i] = remap[v];
+    }
+    for(int v = 0; v < vertices.size(); v++)
+    {
+        if(remap[v] < 0)
+        {
+            remap[v] = (int)order.size();
+            order.push_back(v);
+        }
+    }
+    
+    // quantize the positions to normalized 16 bit integers within the bounding box
+    Vec3f center = (rtf + lbn)/2;
+    Vec3f extent = (rtf - lbn)/2;
+    for(int k = 0; k < 3; k++)
+    {
+        if(extent[k] <= 0)
+            extent[k] = 1.0f;
+    }
+    
+    T_q = Matx44f::eye();
+    for(int k = 0; k < 3; k++)
+    {
+        T_q(k, k) = extent[k];
+        T_q(k, 3) = center[k];
+    }
+    
+    vector<GLshort> positions(4*order.size(), 0);
+    vector<Vec3f> gpuNormals;
+    for(int i = 0; i < order.size(); i++)
+    {
+        Vec3f p = vertices[order[i]];
+        for(int k = 0; k < 3; k++)
+        {
+            positions[4*i + k] = (GLshort)cvRound(std::max(-1.0f, std::min(1.0f, (p[k] - center[k])/extent[k]))*32767.0f);
+        }
+        
+        if(hasNormals)
+        {
+            gpuNormals.push_back(normals[order[i]]);
+        }
+    }
+    
     vertexBuffer.create();
     vertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
     vertexBuffer.bind();
-    vertexBuffer.allocate(vertices.data(), (int)vertices.size() * sizeof(Vec3f));
+    vertexBuffer.allocate(positions.data(), (int)positions.size() * sizeof(GLshort));
     
     normalBuffer.create();
     normalBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
     normalBuffer.bind();
-    normalBuffer.allocate(normals.data(), (int)normals.size() * sizeof(Vec3f));
+    normalBuffer.allocate(gpuNormals.data(), (int)gpuNormals.size() * sizeof(Vec3f));
     
     indexBuffer.create();
     indexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
     indexBuffer.bind();
-    indexBuffer.allocate(indices.data(), (int)indices.size() * sizeof(int));
+    
+    // use 16 bit indices whenever all vertices can be addressed with them
+    if(order.size() <= 65536)
+    {
+        vector<GLushort> shortIndices(gpuIndices.begin(), gpuIndices.end());
+        
+        indexType = GL_UNSIGNED_SHORT;
+        indexBuffer.allocate(shortIndices.data(), (int)shortIndices.size() * sizeof(GLushort));
+    }
+    else
+    {
+        indexType = GL_UNSIGNED_INT;
+        indexBuffer.allocate(gpuIndices.data(), (int)gpuIndices.size() * sizeof(GLuint));
+    }
     
     buffersInitialsed = true;
 }
 
 
+void Model::optimizeVertexCache(vector<GLuint> &indices, int begin, int end, int numVertices, int cacheSize)
+{
+    // Tipsify (Sander et al., Fast Triangle Reordering for Vertex Locality and Reduced Overdraw, 2007)
+    int numTriangles = (end - begin)/3;
+    if(numTriangles < 2)
+        return;
+    
+    const GLuint *tris = indices.data() + begin;
+    
+    // vertex-triangle adjacency
+    vector<int> live(numVertices, 0);
+    for(int i = 0; i < 3*numTriangles; i++)
+    {
+        live[tris[i]]++;
+    }
+    
+    vector<int> adjacencyOffsets(numVertices + 1, 0);
+    for(int v = 0; v < numVertices; v++)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + live[v];
+    }
+    
+    vector<int> adjacency(adjacencyOffsets[numVertices]);
+    vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for(int i = 0; i < 3*numTriangles; i++)
+    {
+        adjacency[fill[tris[i]]++] = i/3;
+    }
+    
+    vector<int> cacheTime(numVertices, 0);
+    vector<bool> emitted(numTriangles, false);
+    vector<int> deadEnd;
+    vector<int> candidates;
+    
+    vector<GLuint> result;
+    result.reserve(3*numTriangles);
+    
+    int timeStamp = cacheSize + 1;
+    int cursor = 0;
+    int fanning = tris[0];
+    
+    while(fanning >= 0)
+    {
+        candidates.clear();
+        
+        // emit all remaining triangles of the current fanning vertex
+        for(int a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+        {
+            int t = adjacency[a];
+            if(emitted[t])
+                continue;
+            
+            for(int k = 0; k < 3; k++)
+            {
+                int v = tris[3*t + k];
+                
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                
+                live[v]--;
+                
+                if(timeStamp - cacheTime[v] > cacheSize)
+                {
+                    cacheTime[v] = timeStamp++;
+                }
+            }
+            emitted[t] = true;
+        }
+        
+        // prefer the candidate that will remain longest in the cache
+        fanning = -1;
+        int maxPriority = -1;
+        for(int c = 0; c < candidates.size(); c++)
+        {
+            int v = candidates[c];
+            if(live[v] > 0)
+            {
+                int priority = 0;
+                if(timeStamp - cacheTime[v] + 2*live[v] <= cacheSize)
+                {
+                    priority = timeStamp - cacheTime[v];
+                }
+                if(priority > maxPriority)
+                {
+                    maxPriority = priority;
+                    fanning = v;
+                }
+            }
+        }
+        
+        // otherwise continue with a recently used or the next unprocessed vertex
+        while(fanning < 0 && !deadEnd.empty())
+        {
+            int v = deadEnd.back();
+            deadEnd.pop_back();
+            if(live[v] > 0)
+                fanning = v;
+        }
+        while(fanning < 0 && cursor < numVertices)
+        {
+            if(live[cursor] > 0)
+                fanning = cursor;
+            cursor++;
+        }
+    }
+    
+    std::copy(result.begin(), result.end(), indices.begin() + begin);
+}
+
+
 void Model::initialize()
 {
     initialized = true;
@@ -129,27 +349,60 @@ bool Model::isInitialized()
 }
 
 
-void Model::draw(QOpenGLShaderProgram *program, GLint primitives)
+void Model::draw(QOpenGLShaderProgram *program, GLint primitives, int lod)
 {
-    vertexBuffer.bind();
-    program->enableAttributeArray("aPosition");
-    program->setAttributeBuffer("aPosition", GL_FLOAT, 0, 3, sizeof(Vec3f));
+    bindAttributes(program);
     
-    normalBuffer.bind();
-    program->enableAttributeArray("aNormal");
-    program->setAttributeBuffer("aNormal", GL_FLOAT, 0, 3, sizeof(Vec3f));
+    if(lod > 0 && lod < lodOffsets.size())
+    {
+        glDrawElements(primitives, (GLsizei)lodIndices[lod - 1].size(), indexType, (GLvoid*)(lodOffsets[lod]*getIndexSize()));
+        return;
+    }
     
-    program->enableAttributeArray("aColor");
-    program->setAttributeBuffer("aColor", GL_UNSIGNED_BYTE, 0, 3, sizeof(Vec3b));
+    for (uint i = 0; i < offsets.size() - 1; i++) {
+        GLuint size = offsets.at(i + 1) - offsets.at(i);
+        GLuint offset = offsets.at(i);
+        
+        glDrawElements(primitives, size, indexType, (GLvoid*)(offset*getIndexSize()));
+    }
+}
+
+
+void Model::drawInstanced(QOpenGLShaderProgram *program, int numInstances, QOpenGLFunctions_3_3_Core *gl, GLint primitives, int lod)
+{
+    bindAttributes(program);
     
-    indexBuffer.bind();
+    if(lod > 0 && lod < lodOffsets.size())
+    {
+        gl->glDrawElementsInstanced(primitives, (GLsizei)lodIndices[lod - 1].size(), indexType, (GLvoid*)(lodOffsets[lod]*getIndexSize()), numInstances);
+        return;
+    }
     
     for (uint i = 0; i < offsets.size() - 1; i++) {
         GLuint size = offsets.at(i + 1) - offsets.at(i);
         GLuint offset = offsets.at(i);
         
-        glDrawElements(primitives, size, GL_UNSIGNED_INT, (GLvoid*)(offset*sizeof(GLuint)));
+        gl->glDrawElementsInstanced(primitives, size, indexType, (GLvoid*)(offset*getIndexSize()), numInstances);
+    }
+}
+
+
+void Model::bindAttributes(QOpenGLShaderProgram *program)
+{
+    // normalized 16 bit positions, padded to 8 bytes per vertex
+    vertexBuffer.bind();
+    program->enableAttributeArray("aPosition");
+    program->setAttributeBuffer("aPosition", GL_SHORT, 0, 3, 4*sizeof(GLshort));
+    
+    // silhouette programs do not fetch any normals
+    if(program->attributeLocation("aNormal") >= 0)
+    {
+        normalBuffer.bind();
+        program->enableAttributeArray("aNormal");
+        program->setAttributeBuffer("aNormal", GL_FLOAT, 0, 3, sizeof(Vec3f));
     }
+    
+    indexBuffer.bind();
 }
 
 
@@ -174,33 +427,289 @@ Matx44f Model::getNormalization()
 }
 
 
-Vec3f Model::getLBN()
+Matx44f Model::getDequantization()
+{
+    return T_q;
+}
+
+
+size_t Model::getIndexSize()
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+
+const Vec3f& Model::getLBN() const
 {
     return lbn;
 }
 
-Vec3f Model::getRTF()
+const Vec3f& Model::getRTF() const
 {
     return rtf;
 }
 
+
+const vector<Vec3f>& Model::getConvexHullVertices() const
+{
+    return hullVertices;
+}
+
+
+const VertexProjection& Model::getConvexHullProjection() const
+{
+    return hullProjection;
+}
+
 float Model::getScaling() {
     
     return scaling;
 }
 
 
-vector<Vec3f> Model::getVertices()
+const vector<Vec3f>& Model::getVertices() const
 {
     return vertices;
 }
 
+const vector<Vec3f>& Model::getNormals() const
+{
+    return normals;
+}
+
+const vector<GLuint>& Model::getIndices() const
+{
+    return indices;
+}
+
 int Model::getNumVertices()
 {
     return (int)vertices.size();
 }
 
 
+int Model::getNumLODs()
+{
+    return (int)lodVertexIDs.size();
+}
+
+
+int Model::selectLOD(float focalLength)
+{
+    return selectLOD(focalLength, T_cm);
+}
+
+
+int Model::selectLOD(float focalLength, const Matx44f &pose)
+{
+    float distance = pose(2, 3);
+    if(distance <= 0)
+        return 0;
+    
+    // the size of one unit of the original model data in pixels at the object's distance
+    float pixelsPerUnit = focalLength*scaling/distance;
+    
+    for(int l = (int)lodEdgeLengths.size() - 1; l > 0; l--)
+    {
+        if(lodEdgeLengths[l]*pixelsPerUnit <= lodThreshold)
+            return l;
+    }
+    return 0;
+}
+
+
+const vector<int>& Model::getVertexIDs(int lod) const
+{
+    if(lod < 0 || lod >= lodVertexIDs.size())
+        lod = 0;
+    
+    return lodVertexIDs[lod];
+}
+
+
+const VertexProjection& Model::getVertexProjection(int lod) const
+{
+    if(lod < 0 || lod >= lodProjections.size())
+        lod = 0;
+    
+    return lodProjections[lod];
+}
+
+
+const vector<Vec3f>& Model::getTransformedVertices(int lod)
+{
+    if(lod < 0 || lod >= lodVertexIDs.size())
+        lod = 0;
+    
+    if(transformedVertices.size() != vertices.size() || transformedPose != T_cm)
+    {
+        transformedVertices.resize(vertices.size());
+        transformedPose = T_cm;
+        transformedLOD = (int)lodVertexIDs.size();
+    }
+    
+    // the vertices of a coarser level of detail are a subset of those of all finer ones
+    if(lod < transformedLOD)
+    {
+        Matx44f T_cm_n = T_cm*T_n;
+        
+        const vector<int> &vertexIDs = lodVertexIDs[lod];
+        for(int i = 0; i < vertexIDs.size(); i++)
+        {
+            int v = vertexIDs[i];
+            const Vec3f &V_m = vertices[v];
+            
+            Vec3f &V_c = transformedVertices[v];
+            V_c[0] = V_m[0]*T_cm_n(0, 0) + V_m[1]*T_cm_n(0, 1) + V_m[2]*T_cm_n(0, 2) + T_cm_n(0, 3);
+            V_c[1] = V_m[0]*T_cm_n(1, 0) + V_m[1]*T_cm_n(1, 1) + V_m[2]*T_cm_n(1, 2) + T_cm_n(1, 3);
+            V_c[2] = V_m[0]*T_cm_n(2, 0) + V_m[1]*T_cm_n(2, 1) + V_m[2]*T_cm_n(2, 2) + T_cm_n(2, 3);
+        }
+        transformedLOD = lod;
+    }
+    
+    return transformedVertices;
+}
+
+
+void Model::computeSilhouetteEdges(const Matx44f &pose, int lod, vector<Vec2i> &edges)
+{
+    edges.clear();
+    
+    if(lod < 0 || lod >= lodEdges.size())
+        lod = 0;
+    
+    // the camera center in unnormalized model coordinates
+    Matx44f T_mc = (pose*T_n).inv();
+    Vec3f c(T_mc(0, 3), T_mc(1, 3), T_mc(2, 3));
+    
+    const vector<Vec4f> &planes = lodFacePlanes[lod];
+    vector<uchar> frontFacing(planes.size());
+    for(int t = 0; t < planes.size(); t++)
+    {
+        const Vec4f &p = planes[t];
+        frontFacing[t] = p[0]*c[0] + p[1]*c[1] + p[2]*c[2] > p[3];
+    }
+    
+    // boundary edges and edges between a front and a back facing triangle
+    const vector<Vec4i> &adjacency = lodEdges[lod];
+    for(int e = 0; e < adjacency.size(); e++)
+    {
+        const Vec4i &edge = adjacency[e];
+        
+        if(edge[3] < 0 ? frontFacing[edge[2]] : frontFacing[edge[2]] != frontFacing[edge[3]])
+        {
+            edges.push_back(Vec2i(edge[0], edge[1]));
+        }
+    }
+}
+
+
+bool Model::projectSilhouette(const Matx33f &K, int lod, vector<vector<Point2f> > &contours, vector<vector<int> > &contourIDs)
+{
+    contours.clear();
+    contourIDs.clear();
+    
+    vector<Vec2i> edges;
+    computeSilhouetteEdges(T_cm, lod, edges);
+    
+    // chain the edges into polylines via the edges adjacent to each of their vertices
+    vector<pair<int, int> > vertexEdges;
+    for(int e = 0; e < edges.size(); e++)
+    {
+        vertexEdges.push_back(make_pair(edges[e][0], e));
+        vertexEdges.push_back(make_pair(edges[e][1], e));
+    }
+    sort(vertexEdges.begin(), vertexEdges.end());
+    
+    vector<bool> visited(edges.size(), false);
+    
+    const vector<Vec3f> &verticesCamera = getTransformedVertices(lod);
+    
+    for(int e = 0; e < edges.size(); e++)
+    {
+        if(visited[e])
+            continue;
+        
+        deque<int> chain;
+        chain.push_back(edges[e][0]);
+        chain.push_back(edges[e][1]);
+        visited[e] = true;
+        
+        // extend the chain at both of its ends
+        for(int end = 0; end < 2; end++)
+        {
+            while(true)
+            {
+                int v = end == 0 ? chain.back() : chain.front();
+                
+                int next = -1;
+                vector<pair<int, int> >::iterator it = lower_bound(vertexEdges.begin(), vertexEdges.end(), make_pair(v, -1));
+                for(; it != vertexEdges.end() && it->first == v; it++)
+                {
+                    if(!visited[it->second])
+                    {
+                        next = it->second;
+                        break;
+                    }
+                }
+                if(next < 0)
+                    break;
+                
+                visited[next] = true;
+                int w = edges[next][0] == v ? edges[next][1] : edges[next][0];
+                
+                if(end == 0)
+                    chain.push_back(w);
+                else
+                    chain.push_front(w);
+            }
+        }
+        
+        vector<Point2f> contour;
+        vector<int> ids;
+        for(int i = 0; i < chain.size(); i++)
+        {
+            // a closed loop ends with its first vertex
+            if(i == chain.size() - 1 && chain[i] == chain[0])
+                break;
+            
+            const Vec3f &V_c = verticesCamera[chain[i]];
+            
+            float X_c = V_c[0];
+            float Y_c = V_c[1];
+            float Z_c = V_c[2];
+            
+            if(Z_c <= 0)
+            {
+                contours.clear();
+                contourIDs.clear();
+                return false;
+            }
+            
+            contour.push_back(Point2f(X_c/Z_c*K(0, 0) + K(0, 2), Y_c/Z_c*K(1, 1) + K(1, 2)));
+            ids.push_back(chain[i]);
+        }
+        
+        contours.push_back(contour);
+        contourIDs.push_back(ids);
+    }
+    
+    return !contours.empty();
+}
+
+
+void Model::setLODThreshold(float pixels)
+{
+    lodThreshold = pixels;
+}
+
+
+float Model::getLODThreshold()
+{
+    return lodThreshold;
+}
+
+
 int Model::getModelID()
 {
     return m_id;
@@ -276,6 +785,56 @@ void Model::loadModel(const string modelFilename)
     offsets.push_back(0);
     offsets.push_back(mesh->mNumFaces*3);
     
+    // the vertices of the convex hull bound the projected silhouette for any pose
+    ConvexHull hull(vertices);
+    if(hull.isDegenerate())
+    {
+        for(int i = 0; i < 8; i++)
+        {
+            hullVertices.push_back(Vec3f((i & 1) ? rtf[0] : lbn[0], (i & 2) ? rtf[1] : lbn[1], (i & 4) ? rtf[2] : lbn[2]));
+        }
+    }
+    else
+    {
+        vector<int> hullIDs = hull.getVertexIDs();
+        for(int i = 0; i < hullIDs.size(); i++)
+        {
+            hullVertices.push_back(vertices[hullIDs[i]]);
+        }
+    }
+    
+    weldVertices();
+    buildLODs(4, 256);
+    
+    hullProjection = VertexProjection(hullVertices);
+    
+    // the welded vertices get the mean normal of all vertices at their position, since flat shaded meshes have one normal per corner
+    vector<Vec3f> weldedNormals(normals.size(), Vec3f(0, 0, 0));
+    for(int v = 0; v < normals.size(); v++)
+    {
+        weldedNormals[weldIDs[v]] += normals[v];
+    }
+    for(int v = 0; v < weldedNormals.size(); v++)
+    {
+        float length = (float)norm(weldedNormals[v]);
+        if(length > 0)
+            weldedNormals[v] /= length;
+    }
+    
+    lodProjections.clear();
+    for(int l = 0; l < getNumLODs(); l++)
+    {
+        lodProjections.push_back(VertexProjection(vertices, weldedNormals, lodVertexIDs[l]));
+    }
+    
+    // edge adjacency of every level of detail for extracting silhouettes on the CPU
+    lodEdges.resize(getNumLODs());
+    lodFacePlanes.resize(getNumLODs());
+    for(int l = 0; l < getNumLODs(); l++)
+    {
+        computeEdgeAdjacency(l == 0 ? indices : lodIndices[l - 1], lodEdges[l], lodFacePlanes[l]);
+    }
+    
     // the center of the 3d bounding box
     Vec3f bbCenter = (rtf + lbn)/2;
     
@@ -284,3 +843,146 @@ void Model::loadModel(const string modelFilename)
     
     //T_n = Transformations::scaleMatrix(scaling);
 }
+
+
+void Model::weldVertices()
+{
+    vector<int> order(vertices.size());
+    for(int v = 0; v < order.size(); v++)
+    {
+        order[v] = v;
+    }
+    
+    // sort the vertices lexicographically by position and by index among equal positions
+    const vector<Vec3f> &positions = vertices;
+    sort(order.begin(), order.end(), [&positions](int a, int b)
+    {
+        const Vec3f &p = positions[a];
+        const Vec3f &q = positions[b];
+        if(p[0] != q[0])
+            return p[0] < q[0];
+        if(p[1] != q[1])
+            return p[1] < q[1];
+        if(p[2] != q[2])
+            return p[2] < q[2];
+        return a < b;
+    });
+    
+    weldIDs.resize(vertices.size());
+    for(int i = 0; i < order.size(); i++)
+    {
+        if(i > 0 && vertices[order[i]] == vertices[order[i - 1]])
+            weldIDs[order[i]] = weldIDs[order[i - 1]];
+        else
+            weldIDs[order[i]] = order[i];
+    }
+}
+
+
+void Model::buildLODs(int numLODs, int minTriangles)
+{
+    lodIndices.clear();
+    lodVertexIDs.clear();
+    lodEdgeLengths.clear();
+    
+    // the original mesh is represented by the welded vertices as well, so that a surface position keeps its ID across all levels
+    vector<int> weldedVertexIDs;
+    for(int v = 0; v < weldIDs.size(); v++)
+    {
+        if(weldIDs[v] == v)
+            weldedVertexIDs.push_back(v);
+    }
+    lodVertexIDs.push_back(weldedVertexIDs);
+    
+    // decimate the welded mesh, triangles collapsed by the weld are dropped by the decimation
+    vector<GLuint> weldedIndices(indices.size());
+    for(int i = 0; i < indices.size(); i++)
+    {
+        weldedIndices[i] = weldIDs[indices[i]];
+    }
+    
+    MeshDecimation decimation(vertices, weldedIndices);
+    lodEdgeLengths.push_back(decimation.getMeanEdgeLength());
+    
+    // a mesh that is still mostly open after welding cannot be simplified sensibly
+    vector<Vec4i> edges;
+    vector<Vec4f> facePlanes;
+    computeEdgeAdjacency(weldedIndices, edges, facePlanes);
+    
+    int numBoundaryEdges = 0;
+    for(int i = 0; i < edges.size(); i++)
+    {
+        if(edges[i][3] < 0)
+            numBoundaryEdges++;
+    }
+    if(2*numBoundaryEdges > edges.size())
+        return;
+    
+    // every pyramid level has a quarter of the pixels of the previous one
+    int numTriangles = decimation.getNumTriangles();
+    for(int l = 1; l < numLODs; l++)
+    {
+        int target = numTriangles >> (2*l);
+        if(target < minTriangles)
+            break;
+        
+        int previous = decimation.getNumTriangles();
+        int remaining = decimation.decimate(target);
+        
+        // stop once the silhouette constraints prevent any substantial reduction
+        if(remaining > 0.8f*previous)
+            break;
+        
+        lodIndices.push_back(decimation.getIndices());
+        lodVertexIDs.push_back(decimation.getVertexIDs());
+        lodEdgeLengths.push_back(decimation.getMeanEdgeLength());
+    }
+}
+
+
+void Model::computeEdgeAdjacency(const vector<GLuint> &indices, vector<Vec4i> &edges, vector<Vec4f> &facePlanes)
+{
+    edges.clear();
+    facePlanes.clear();
+    
+    vector<pair<pair<int, int>, int> > halfEdges;
+    
+    for(int t = 0; t < indices.size()/3; t++)
+    {
+        Vec3f a = vertices[indices[3*t]];
+        Vec3f b = vertices[indices[3*t + 1]];
+        Vec3f c = vertices[indices[3*t + 2]];
+        
+        Vec3f n = (b - a).cross(c - a);
+        facePlanes.push_back(Vec4f(n[0], n[1], n[2], n.dot(a)));
+        
+        // half-edges are matched by their welded end points, so that seams split by vertex attributes stay connected
+        for(int k = 0; k < 3; k++)
+        {
+            int w0 = weldIDs[indices[3*t + k]];
+            int w1 = weldIDs[indices[3*t + (k + 1)%3]];
+            halfEdges.push_back(make_pair(make_pair(std::min(w0, w1), std::max(w0, w1)), t));
+        }
+    }
+    
+    sort(halfEdges.begin(), halfEdges.end());
+    
+    // an edge with more than two triangles is split into several pairs
+    for(int i = 0; i < halfEdges.size();)
+    {
+        // the edge refers to the welded end points, so that adjacent silhouette edges share their vertex IDs
+        Vec4i edge(halfEdges[i].first.first, halfEdges[i].first.second, halfEdges[i].second, -1);
+        
+        if(i + 1 < halfEdges.size() && halfEdges[i + 1].first == halfEdges[i].first)
+        {
+            edge[3] = halfEdges[i + 1].second;
+            i += 2;
+        }
+        else
+        {
+            i++;
+        }
+        
+        edges.push_back(edge);
+    }
+}
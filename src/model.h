@@ -38,11 +38,13 @@
 
 #include <QOpenGLBuffer>
 #include <QOpenGLShaderProgram>
+#include <QOpenGLFunctions_3_3_Core>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
 #include "transformations.h"
+#include "vertex_projection.h"
 
 /**
  *  A 3d model class based on the ASSIMP library mostly implemented
@@ -82,11 +84,31 @@ public:
      *
      *  @param  program    The shader programm to be used.
      *  @param  primitives The primitive type that shall be used for drawing (e.g. GL_POINTS, GL_LINES,...). The default value is set to GL_TRIANGLES.
+     *  @param  lod The level of detail to be drawn (default = 0, i.e. the original mesh).
      */
-    void draw(QOpenGLShaderProgram *program, GLint primitives = GL_TRIANGLES);
+    void draw(QOpenGLShaderProgram *program, GLint primitives = GL_TRIANGLES, int lod = 0);
+    
+    /**
+     *  Draws multiple instances of the model with a single draw call
+     *  per index range using a given shader programm, that is expected
+     *  to obtain the per instance data via gl_InstanceID.
+     *
+     *  @param  program    The shader programm to be used.
+     *  @param  numInstances The number of instances to be drawn.
+     *  @param  gl The OpenGL 3.3 functions of the current context.
+     *  @param  primitives The primitive type that shall be used for drawing (e.g. GL_POINTS, GL_LINES,...). The default value is set to GL_TRIANGLES.
+     *  @param  lod The level of detail to be drawn (default = 0, i.e. the original mesh).
+     */
+    void drawInstanced(QOpenGLShaderProgram *program, int numInstances, QOpenGLFunctions_3_3_Core *gl, GLint primitives = GL_TRIANGLES, int lod = 0);
     
     /**
      *  The 3d data is packed into VOBs and uploaded to the GPU.
+     *  For this, the triangles are reordered for the post-transform
+     *  vertex cache and the vertices are renumbered in the order of
+     *  their first use. The positions are quantized to normalized 16 bit
+     *  integers wrt the bounding box (see getDequantization()) and 16 bit
+     *  indices are used whenever possible. The vertex order of the CPU data
+     *  returned by getVertices() remains unchanged.
      *  Should be called after a valid OpenGL context exists.
      *  Must be called before a model can get rendered!
      */
@@ -161,6 +183,17 @@ public:
      */
     cv::Matx44f getNormalization();
     
+    /**
+     *  Returns the transform that maps the normalized 16 bit vertex positions
+     *  stored on the GPU back to the unnormalized model coordinates, i.e. a
+     *  scaling by the half extents of the bounding box followed by a translation
+     *  to its center. It has to be applied before the normalization when
+     *  rendering the model.
+     *
+     *  @return The dequantization matrix of the GPU vertex positions.
+     */
+    cv::Matx44f getDequantization();
+    
     
     /**
      *  Returns the left (min(X0,... Xn-1)) bottom (min(Y0,... Yn-1))
@@ -169,7 +202,7 @@ public:
      *
      *  @return  The left bottom near corner of the bounding box of the model.
      */
-    cv::Vec3f getLBN();
+    const cv::Vec3f& getLBN() const;
     
     /**
      *  Returns the right (max(X0,... Xn-1)) top (max(Y0,... Yn-1))
@@ -178,7 +211,25 @@ public:
      *
      *  @return  The right top far corner of the bounding box of the model.
      */
-    cv::Vec3f getRTF();
+    const cv::Vec3f& getRTF() const;
+    
+    /**
+     *  Returns the unnormalized vertices of the 3D convex hull of the model
+     *  computed at load time, or the eight corners of the bounding box if the
+     *  model does not span a volume. The projection of the model for any pose
+     *  lies within the convex hull of the projected hull vertices.
+     *
+     *  @return  The vertices of the convex hull of the model.
+     */
+    const std::vector<cv::Vec3f>& getConvexHullVertices() const;
+    
+    /**
+     *  Returns a structure of arrays copy of the convex hull vertices for
+     *  projecting them in batches.
+     *
+     *  @return  The convex hull vertices prepared for batch projection.
+     */
+    const VertexProjection& getConvexHullProjection() const;
     
     /**
      *  Returns the scaling factor specified in the contructor.
@@ -189,11 +240,54 @@ public:
     
     /**
      *  Returns a vector containing all unnormalized 3D model
-     *  verticies [X_m, Y_m, Z_m].
+     *  verticies [X_m, Y_m, Z_m]. The reference remains valid
+     *  as long as the model exists.
      *
      *  @return  A vector containing all unnormalized 3D model verticies.
      */
-    std::vector<cv::Vec3f> getVertices();
+    const std::vector<cv::Vec3f>& getVertices() const;
+    
+    /**
+     *  Returns a vector containing the normals of all 3D model verticies
+     *  in the same order as getVertices(). It is empty if the model file
+     *  does not provide any normals.
+     *
+     *  @return  A vector containing the normals of all 3D model verticies.
+     */
+    const std::vector<cv::Vec3f>& getNormals() const;
+    
+    /**
+     *  Returns the triangle index list of the original mesh, which refers
+     *  to the vertices returned by getVertices().
+     *
+     *  @return  The triangle index list of the original mesh.
+     */
+    const std::vector<GLuint>& getIndices() const;
+    
+    /**
+     *  Returns the vertices of a level of detail transformed into camera
+     *  coordinates [X_c, Y_c, Z_c] wrt the current pose of the model, i.e. by
+     *  T_cm*T_n. Only the entries given by getVertexIDs(lod) are valid. The
+     *  result is cached and only recomputed when the pose changes or a finer
+     *  level of detail is requested, so that repeated calls for the same pose
+     *  within a frame do not transform the mesh again.
+     *
+     *  @param  lod The level of detail.
+     *
+     *  @return  A vector of the size of getVertices() containing the transformed verticies.
+     */
+    const std::vector<cv::Vec3f>& getTransformedVertices(int lod);
+    
+    /**
+     *  Returns a structure of arrays copy of the vertices of a level of detail
+     *  and their normals for projecting them in batches, where the identifier
+     *  of each point is its index in getVertices().
+     *
+     *  @param  lod The level of detail.
+     *
+     *  @return  The vertices of the level of detail prepared for batch projection.
+     */
+    const VertexProjection& getVertexProjection(int lod) const;
     
     /**
      *  Returns the total number of 3D model verticies.
@@ -202,6 +296,90 @@ public:
      */
     int getNumVertices();
     
+    /**
+     *  Returns the number of levels of detail of the model including the
+     *  original mesh. The coarser levels are computed at load time by quadric
+     *  mesh decimation, each with about a quarter of the triangles of the
+     *  previous one. They only consist of original vertices.
+     *
+     *  @return  The number of levels of detail.
+     */
+    int getNumLODs();
+    
+    /**
+     *  Selects the coarsest level of detail whose average edge length projects
+     *  to at most getLODThreshold() pixels wrt the current pose of the model.
+     *
+     *  @param  focalLength The focal length in pixels of the image the model is rendered into.
+     *
+     *  @return  The selected level of detail.
+     */
+    int selectLOD(float focalLength);
+    
+    /**
+     *  Selects the coarsest level of detail whose average edge length projects
+     *  to at most getLODThreshold() pixels wrt a given pose of the model.
+     *
+     *  @param  focalLength The focal length in pixels of the image the model is rendered into.
+     *  @param  pose The 6DOF pose of the model.
+     *
+     *  @return  The selected level of detail.
+     */
+    int selectLOD(float focalLength, const cv::Matx44f &pose);
+    
+    /**
+     *  Returns the indices of all vertices used by a level of detail, which
+     *  refer to the vertices returned by getVertices(). Of all vertices at the
+     *  same position only the one with the lowest index is used, so that every
+     *  level of detail identifies a surface position by the same vertex index.
+     *
+     *  @param  lod The level of detail.
+     *
+     *  @return  The indices of the vertices of the level of detail.
+     */
+    const std::vector<int>& getVertexIDs(int lod) const;
+    
+    /**
+     *  Finds all silhouette edges of a level of detail wrt a given pose without rendering,
+     *  i.e. all edges between a front and a back facing triangle as well as all boundary
+     *  edges, based on the edge adjacency precomputed at load time. Note that this includes
+     *  silhouette edges that are hidden by other parts of non-convex models.
+     *
+     *  @param  pose The 6DOF pose of the model.
+     *  @param  lod The level of detail.
+     *  @param  edges The resulting silhouette edges as pairs of vertex indices.
+     */
+    void computeSilhouetteEdges(const cv::Matx44f &pose, int lod, std::vector<cv::Vec2i> &edges);
+    
+    /**
+     *  Computes the silhouette edges of a level of detail wrt the current pose of the model,
+     *  chains them into polylines and projects these into the image.
+     *
+     *  @param  K The intrinsic camera matrix of the image.
+     *  @param  lod The level of detail.
+     *  @param  contours The resulting projected contour polylines.
+     *  @param  contourIDs The vertex indices corresponding to each point of the contours.
+     *
+     *  @return  False if there is no silhouette or if it is (partially) behind the camera.
+     */
+    bool projectSilhouette(const cv::Matx33f &K, int lod, std::vector<std::vector<cv::Point2f> > &contours, std::vector<std::vector<int> > &contourIDs);
+    
+    /**
+     *  Sets the maximal projected average edge length in pixels that
+     *  is tolerated when selecting a level of detail.
+     *
+     *  @param  pixels The maximal projected average edge length (default = 3).
+     */
+    void setLODThreshold(float pixels);
+    
+    /**
+     *  Returns the maximal projected average edge length in pixels that
+     *  is tolerated when selecting a level of detail.
+     *
+     *  @return  The maximal projected average edge length.
+     */
+    float getLODThreshold();
+    
     /**
      *  Returns the index of the model. These indices should be
      *  unique and within [1,255] as they also define the rendering
@@ -235,19 +413,51 @@ private:
     
     cv::Matx44f T_n;
     
+    // dequantization of the GPU vertex positions
+    cv::Matx44f T_q;
+    
     bool initialized;
     
     bool hasNormals;
     
     std::vector<cv::Vec3f> vertices;
     std::vector<cv::Vec3f> normals;
+    std::vector<cv::Vec3f> hullVertices;
     std::vector<GLuint> indices;
     std::vector<GLuint> offsets;
     
+    // the triangle lists of the coarser levels of detail 1, 2, ... and their offsets in the index buffer
+    std::vector<std::vector<GLuint> > lodIndices;
+    std::vector<GLuint> lodOffsets;
+    
+    // the vertex with the lowest index at the same position for every vertex, seams split by normals or texture coordinates are closed by it
+    std::vector<int> weldIDs;
+    
+    // the vertices and average edge lengths of all levels of detail including the original mesh
+    std::vector<std::vector<int> > lodVertexIDs;
+    std::vector<float> lodEdgeLengths;
+    
+    float lodThreshold;
+    
+    // the vertices in camera coordinates wrt the cached pose, valid for all levels of detail >= transformedLOD
+    std::vector<cv::Vec3f> transformedVertices;
+    cv::Matx44f transformedPose;
+    int transformedLOD;
+    
+    // structure of arrays copies of the vertices of all levels of detail and the convex hull
+    std::vector<VertexProjection> lodProjections;
+    VertexProjection hullProjection;
+    
+    // per level of detail: every edge as (v0, v1, t0, t1) with t1 = -1 on boundaries and every triangle's plane (n, n*p)
+    std::vector<std::vector<cv::Vec4i> > lodEdges;
+    std::vector<std::vector<cv::Vec4f> > lodFacePlanes;
+    
     QOpenGLBuffer vertexBuffer;
     QOpenGLBuffer normalBuffer;
     QOpenGLBuffer indexBuffer;
     
+    GLenum indexType;
+    
     bool buffersInitialsed;
     
     cv::Vec3f lbn;
@@ -255,6 +465,52 @@ private:
     float scaling;
     
     
+    void bindAttributes(QOpenGLShaderProgram *program);
+    
+    size_t getIndexSize();
+    
+    /**
+     *  Reorders the triangles within a range of a triangle index list in order
+     *  to improve the hit rate of the post-transform vertex cache of the GPU.
+     *
+     *  @param  indices The triangle index list to be reordered in place.
+     *  @param  begin The first index of the range.
+     *  @param  end The end of the range (exclusive).
+     *  @param  numVertices The total number of vertices.
+     *  @param  cacheSize The assumed number of entries of the vertex cache.
+     */
+    static void optimizeVertexCache(std::vector<GLuint> &indices, int begin, int end, int numVertices, int cacheSize);
+    
+    /**
+     *  Maps every vertex to the vertex with the lowest index at exactly the
+     *  same position, so that meshes stored as triangle soups with per-corner
+     *  attributes become connected for decimation and adjacency.
+     */
+    void weldVertices();
+    
+    /**
+     *  Computes a chain of levels of detail by incremental quadric mesh decimation.
+     *  The decimation works on the position-welded mesh, so the indices of all coarser
+     *  levels and the vertex IDs of all levels refer to the representative vertices of weldIDs. No
+     *  levels of detail are built if the welded mesh is not closed for the most part.
+     *
+     *  @param  numLODs The maximal number of levels of detail including the original mesh.
+     *  @param  minTriangles The minimal number of triangles of a level of detail.
+     */
+    void buildLODs(int numLODs, int minTriangles);
+    
+    /**
+     *  Computes the edges of a triangle mesh with their adjacent triangles and
+     *  the supporting plane of every triangle. Edges are matched and stored
+     *  by their position-welded end points (see weldIDs), so that silhouette
+     *  edges can be chained into polylines across seams of the mesh.
+     *
+     *  @param  indices The triangle indices of the mesh.
+     *  @param  edges The resulting edges as (v0, v1, t0, t1) with t1 = -1 on boundaries.
+     *  @param  facePlanes The resulting plane (n, n*p) of every triangle.
+     */
+    void computeEdgeAdjacency(const std::vector<GLuint> &indices, std::vector<cv::Vec4i> &edges, std::vector<cv::Vec4f> &facePlanes);
+    
     /**
      *  Loads the model data from the specified file.
      *
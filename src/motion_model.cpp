@@ -0,0 +1,127 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "motion_model.h"
+
+using namespace std;
+using namespace cv;
+
+MotionModel::MotionModel(bool useKalmanFilter, float processNoise, float measurementNoise)
+{
+    this->useKalmanFilter = useKalmanFilter;
+    
+    this->processNoise = processNoise;
+    this->measurementNoise = measurementNoise;
+    
+    // the velocity is modeled as a random walk that is measured directly
+    kalmanFilter.init(6, 6, 0, CV_32F);
+    
+    reset();
+}
+
+
+MotionModel::~MotionModel()
+{
+    
+}
+
+
+void MotionModel::update(const Matx44f &pose)
+{
+    if(numObservations > 0)
+    {
+        Matx61f measuredVelocity = Transformations::log((PoseSE3(pose)*PoseSE3(lastPose).inverse()).toMatx44f());
+        
+        if(useKalmanFilter)
+        {
+            if(numObservations == 1)
+            {
+                kalmanFilter.statePost = Mat(measuredVelocity).clone();
+                setIdentity(kalmanFilter.errorCovPost, Scalar::all(measurementNoise));
+            }
+            else
+            {
+                kalmanFilter.predict();
+                Mat corrected = kalmanFilter.correct(Mat(measuredVelocity));
+                
+                measuredVelocity = Matx61f((float*)corrected.ptr<float>());
+            }
+        }
+        
+        velocity = measuredVelocity;
+    }
+    
+    lastPose = pose;
+    
+    numObservations++;
+}
+
+
+Matx44f MotionModel::predict()
+{
+    if(numObservations == 0)
+        return Matx44f::eye();
+    
+    return (PoseSE3(Transformations::exp(velocity))*PoseSE3(lastPose)).toMatx44f();
+}
+
+
+Matx61f MotionModel::getVelocity()
+{
+    return velocity;
+}
+
+
+int MotionModel::getNumObservations()
+{
+    return numObservations;
+}
+
+
+void MotionModel::reset()
+{
+    lastPose = Matx44f::eye();
+    velocity = Matx61f::zeros();
+    
+    numObservations = 0;
+    
+    setIdentity(kalmanFilter.transitionMatrix);
+    setIdentity(kalmanFilter.measurementMatrix);
+    setIdentity(kalmanFilter.processNoiseCov, Scalar::all(processNoise));
+    setIdentity(kalmanFilter.measurementNoiseCov, Scalar::all(measurementNoise));
+    setIdentity(kalmanFilter.errorCovPost, Scalar::all(1));
+    kalmanFilter.statePost = Mat::zeros(6, 1, CV_32F);
+}
@@ -0,0 +1,116 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MOTION_MODEL_H
+#define MOTION_MODEL_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/video.hpp>
+
+#include "transformations.h"
+
+/**
+ *  This class implements a constant velocity motion model for predicting the
+ *  6DOF pose of a rigid object in the next camera frame. The velocity is the
+ *  relative motion between the two most recent poses expressed in twist
+ *  coordinates in the camera frame, i.e. T_t = exp(xi)*T_t-1. It can optionally
+ *  be smoothed by a Kalman filter to reduce the influence of pose jitter.
+ */
+class MotionModel
+{
+public:
+    /**
+     *  Constructor of the motion model.
+     *
+     *  @param  useKalmanFilter A flag telling whether the velocity should be Kalman filtered (default = false).
+     *  @param  processNoise The variance of the velocity change between two frames used by the Kalman filter.
+     *  @param  measurementNoise The variance of the measured velocity used by the Kalman filter.
+     */
+    MotionModel(bool useKalmanFilter = false, float processNoise = 1e-4f, float measurementNoise = 1e-3f);
+    
+    ~MotionModel();
+    
+    /**
+     *  Adds the pose of the object estimated in the current frame and updates
+     *  the velocity estimate accordingly.
+     *
+     *  @param  pose The estimated 6DOF pose of the object.
+     */
+    void update(const cv::Matx44f &pose);
+    
+    /**
+     *  Predicts the 6DOF pose of the object in the next frame by applying the
+     *  current velocity estimate to the most recent pose. Without any prior
+     *  observations the identity is returned.
+     *
+     *  @return  The predicted 6DOF pose of the object.
+     */
+    cv::Matx44f predict();
+    
+    /**
+     *  Returns the current velocity estimate in twist coordinates.
+     *
+     *  @return  The relative motion per frame in twist coordinates.
+     */
+    cv::Matx61f getVelocity();
+    
+    /**
+     *  Returns the number of poses that have been added since the last reset.
+     *
+     *  @return  The number of observed poses.
+     */
+    int getNumObservations();
+    
+    /**
+     *  Clears all observations and the velocity estimate.
+     */
+    void reset();
+    
+private:
+    bool useKalmanFilter;
+    
+    float processNoise;
+    float measurementNoise;
+    
+    cv::KalmanFilter kalmanFilter;
+    
+    cv::Matx44f lastPose;
+    cv::Matx61f velocity;
+    
+    int numObservations;
+};
+
+#endif /* MOTION_MODEL_H */
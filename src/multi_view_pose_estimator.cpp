@@ -0,0 +1,366 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "multi_view_pose_estimator.h"
+#include "transformations.h"
+#include "profiler.h"
+
+using namespace std;
+using namespace cv;
+
+MultiViewPoseEstimator::MultiViewPoseEstimator(const vector<CameraCalibration> &cameras, float zNear, float zFar, vector<Object3D*> &objects, RenderingEngine *renderingEngine)
+{
+    sharedRenderingEngine = (renderingEngine == NULL);
+    
+    if(sharedRenderingEngine)
+        renderingEngine = RenderingEngine::Instance();
+    
+    this->renderingEngine = renderingEngine;
+    optimizationEngine = new OptimizationEngine(cameras[0].width, cameras[0].height, renderingEngine);
+    
+    iterations[0] = 1;
+    iterations[1] = 2;
+    iterations[2] = 4;
+    
+    initialized = false;
+    
+    //start initialization
+    renderingEngine->init(cameras[0].K, cameras[0].width, cameras[0].height, zNear, zFar, 4);
+    
+    renderingEngine->makeCurrent();
+    
+    for(int c = 0; c < cameras.size(); c++)
+    {
+        CameraView view;
+        view.calibration = cameras[c];
+        
+        const CameraCalibration &calib = view.calibration;
+        
+        initUndistortRectifyMap(calib.K, calib.distCoeffs, cv::noArray(), calib.K, Size(calib.width, calib.height), CV_16SC2, view.map1, view.map2);
+        
+        // the first camera is the one the rendering engine has been initialized with
+        if(c == 0)
+            view.renderCamera = 0;
+        else
+            view.renderCamera = renderingEngine->addCamera(calib.K, calib.width, calib.height);
+        
+        view.Ad_cw = Transformations::adjoint(calib.T_cw);
+        
+        view.centersIDs.resize(objects.size());
+        
+        views.push_back(view);
+    }
+    
+    for(int i = 0; i < objects.size(); i++)
+    {
+        objects[i]->setModelID(i+1);
+        this->objects.push_back(objects[i]);
+        this->objects[i]->initBuffers();
+        this->objects[i]->reset();
+    }
+    
+    renderingEngine->setCamera(0);
+    
+    renderingEngine->doneCurrent();
+}
+
+
+MultiViewPoseEstimator::~MultiViewPoseEstimator()
+{
+    if(sharedRenderingEngine)
+        renderingEngine->destroy();
+    
+    delete optimizationEngine;
+}
+
+
+int MultiViewPoseEstimator::getNumCameras()
+{
+    return (int)views.size();
+}
+
+
+void MultiViewPoseEstimator::prepareFrames(vector<Mat> &frames, bool undistortFrames)
+{
+    RBOT_PROFILE_SCOPE("imagePyramid");
+    
+    for(int v = 0; v < views.size(); v++)
+    {
+        Mat &frame = frames[v];
+        
+        if(undistortFrames)
+            remap(frame, frame, views[v].map1, views[v].map2, INTER_LINEAR);
+        
+        vector<Mat> &imagePyramid = views[v].imagePyramid;
+        imagePyramid.clear();
+        
+        Mat frameCpy = frame.clone();
+        imagePyramid.push_back(frameCpy);
+        
+        for(int l = 1; l < 4; l++)
+        {
+            resize(frame, frameCpy, Size(frame.cols/pow(2, l), frame.rows/pow(2, l)));
+            imagePyramid.push_back(frameCpy);
+        }
+    }
+}
+
+
+void MultiViewPoseEstimator::selectView(int v, const vector<Matx44f> &worldPoses)
+{
+    CameraView &view = views[v];
+    
+    renderingEngine->setCamera(view.renderCamera);
+    
+    // the objects are temporarily moved into the coordinates of the selected camera
+    for(int o = 0; o < objects.size(); o++)
+    {
+        objects[o]->setPose(view.calibration.T_cw*worldPoses[o]);
+        
+        if(objects[o]->isInitialized())
+            objects[o]->getTCLCHistograms()->setCentersAndIDs(view.centersIDs[o]);
+    }
+}
+
+
+void MultiViewPoseEstimator::updateHistograms(int v, int objectIndex)
+{
+    CameraView &view = views[v];
+    
+    // the frame is expected to already be rendered into the target of the selected camera
+    Mat mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
+    Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
+    
+    float zNear = renderingEngine->getZNear();
+    float zFar = renderingEngine->getZFar();
+    
+    TCLCHistograms *tclcHistograms = objects[objectIndex]->getTCLCHistograms();
+    tclcHistograms->update(view.imagePyramid[0], mask, depth, view.calibration.K, zNear, zFar);
+    
+    view.centersIDs[objectIndex] = tclcHistograms->getCentersAndIDs();
+}
+
+
+void MultiViewPoseEstimator::toggleTracking(vector<Mat> &frames, int objectIndex, bool undistortFrames)
+{
+    RBOT_PROFILE_SCOPE("toggleTracking");
+    
+    if(objectIndex >= objects.size() || frames.size() != views.size())
+        return;
+    
+    if(!objects[objectIndex]->isInitialized())
+    {
+        prepareFrames(frames, undistortFrames);
+        
+        objects[objectIndex]->initialize();
+        
+        vector<Matx44f> worldPoses;
+        for(int o = 0; o < objects.size(); o++)
+        {
+            worldPoses.push_back(objects[o]->getPose());
+        }
+        
+        // the histograms are built from all views one after another
+        for(int v = 0; v < views.size(); v++)
+        {
+            selectView(v, worldPoses);
+            
+            renderingEngine->setLevel(0);
+            renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
+            
+            updateHistograms(v, objectIndex);
+        }
+        
+        for(int o = 0; o < objects.size(); o++)
+        {
+            objects[o]->setPose(worldPoses[o]);
+        }
+        
+        renderingEngine->setCamera(0);
+        
+        initialized = true;
+    }
+    else
+    {
+        objects[objectIndex]->reset();
+        
+        for(int v = 0; v < views.size(); v++)
+        {
+            views[v].centersIDs[objectIndex].clear();
+        }
+        
+        initialized = false;
+        for(int o = 0; o < objects.size(); o++)
+        {
+            initialized |= objects[o]->isInitialized();
+        }
+    }
+}
+
+
+void MultiViewPoseEstimator::estimatePoses(vector<Mat> &frames, bool undistortFrames)
+{
+    RBOT_PROFILE_FRAME();
+    RBOT_PROFILE_SCOPE("estimatePoses");
+    
+    if(frames.size() != views.size())
+        return;
+    
+    prepareFrames(frames, undistortFrames);
+    
+    if(initialized)
+    {
+        vector<Matx44f> worldPoses;
+        for(int o = 0; o < objects.size(); o++)
+        {
+            worldPoses.push_back(objects[o]->getPose());
+        }
+        
+        {
+            RBOT_PROFILE_SCOPE("optimization");
+            
+            // coarse to fine optimization over all views jointly
+            for(int level = 2; level >= 0; level--)
+            {
+                for(int iter = 0; iter < iterations[level]; iter++)
+                {
+                    runIteration(worldPoses, level);
+                }
+            }
+        }
+        
+        for(int v = 0; v < views.size(); v++)
+        {
+            selectView(v, worldPoses);
+            
+            renderingEngine->setLevel(0);
+            renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
+            
+            for(int o = 0; o < objects.size(); o++)
+            {
+                if(objects[o]->isInitialized())
+                    updateHistograms(v, o);
+            }
+        }
+        
+        for(int o = 0; o < objects.size(); o++)
+        {
+            objects[o]->setPose(worldPoses[o]);
+        }
+        
+        renderingEngine->setCamera(0);
+    }
+}
+
+
+void MultiViewPoseEstimator::runIteration(vector<Matx44f> &worldPoses, int level)
+{
+    vector<Matx66f> wJTJSum(objects.size(), Matx66f::zeros());
+    vector<Matx61f> JTSum(objects.size(), Matx61f::zeros());
+    vector<bool> validSum(objects.size(), false);
+    
+    vector<Matx66f> wJTJ;
+    vector<Matx61f> JT;
+    vector<bool> valid;
+    
+    for(int v = 0; v < views.size(); v++)
+    {
+        selectView(v, worldPoses);
+        
+        optimizationEngine->computeJacobians(views[v].imagePyramid, objects, level, wJTJ, JT, valid);
+        
+        // a camera space step d_c relates to the world space step d_w by d_c = Ad(T_cw)*d_w
+        const Matx66f &Ad = views[v].Ad_cw;
+        
+        for(int o = 0; o < objects.size(); o++)
+        {
+            if(valid[o])
+            {
+                wJTJSum[o] += Ad.t()*wJTJ[o]*Ad;
+                JTSum[o] += Ad.t()*JT[o];
+                validSum[o] = true;
+            }
+        }
+    }
+    
+    for(int o = 0; o < objects.size(); o++)
+    {
+        if(validSum[o])
+        {
+            // Gauss-Newton step in se3 wrt world coordinates
+            Matx61f delta_xi = -wJTJSum[o].inv(DECOMP_CHOLESKY)*JTSum[o];
+            
+            PoseSE3 T_wm = PoseSE3(worldPoses[o]);
+            T_wm = PoseSE3(Transformations::exp(delta_xi))*T_wm;
+            
+            worldPoses[o] = T_wm.toMatx44f();
+        }
+    }
+}
+
+
+void MultiViewPoseEstimator::reset()
+{
+    for(int i = 0; i < objects.size(); i++)
+    {
+        objects[i]->reset();
+    }
+    
+    for(int v = 0; v < views.size(); v++)
+    {
+        for(int i = 0; i < views[v].centersIDs.size(); i++)
+        {
+            views[v].centersIDs[i].clear();
+        }
+    }
+    
+    initialized = false;
+}
+
+
+Matx44f MultiViewPoseEstimator::getPoseInCamera(int objectIndex, int camera)
+{
+    return views[camera].calibration.T_cw*objects[objectIndex]->getPose();
+}
+
+
+void MultiViewPoseEstimator::setOptimizationIterations(int iterationsLevel2, int iterationsLevel1, int iterationsLevel0)
+{
+    iterations[0] = iterationsLevel0;
+    iterations[1] = iterationsLevel1;
+    iterations[2] = iterationsLevel2;
+}
@@ -0,0 +1,194 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef MULTI_VIEW_POSE_ESTIMATOR_H
+#define MULTI_VIEW_POSE_ESTIMATOR_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "object3d.h"
+#include "rendering_engine.h"
+#include "optimization_engine.h"
+
+/**
+ *  The calibration of a single camera observing the tracked objects.
+ */
+struct CameraCalibration
+{
+    // the image resolution at full size
+    int width;
+    int height;
+    
+    cv::Matx33f K;
+    cv::Matx14f distCoeffs;
+    
+    // the extrinsics, i.e. the rigid transformation from world into camera coordinates
+    cv::Matx44f T_cw;
+};
+
+
+/**
+ *  This class implements region-based 6DOF pose tracking of multiple rigid
+ *  3D objects in the synchronized images of several calibrated cameras.
+ *  Every camera has its own intrinsics, undistortion maps and render targets
+ *  within the rendering engine, while the objects and their tclc-histograms
+ *  are shared by all views. In each Gauss-Newton iteration the Jacobian terms
+ *  of all views are transformed into world coordinates via the adjoint of the
+ *  camera extrinsics and summed, resulting in a single pose update per object.
+ *  The poses of the objects (i.e. getPose()) are given wrt world coordinates.
+ *  Unlike PoseEstimator6D, this class only tracks and does not detect objects
+ *  after tracking has been lost.
+ */
+class MultiViewPoseEstimator
+{
+public:
+    /**
+     *  Constructor of the multi-view pose estimator initializing the rendering
+     *  engine with a camera and rectification maps for every view and the
+     *  OpenGL rendering buffers of all provided 3D objects.
+     *
+     *  @param  cameras The calibrations of all cameras (at least one).
+     *  @param  zNear The distance of the OpenGL near plane.
+     *  @param  zFar The distance of the OpenGL far plane.
+     *  @param  objects A collection of all 3D objects to be tracked.
+     *  @param  renderingEngine A rendering engine owned by the caller (default = NULL, i.e. RenderingEngine::Instance(), which is destroyed along with the estimator).
+     */
+    MultiViewPoseEstimator(const std::vector<CameraCalibration> &cameras, float zNear, float zFar, std::vector<Object3D*> &objects, RenderingEngine *renderingEngine = NULL);
+    
+    ~MultiViewPoseEstimator();
+    
+    /**
+     *  Returns the number of cameras.
+     *
+     *  @return  The number of cameras.
+     */
+    int getNumCameras();
+    
+    /**
+     *  Initializes/starts tracking for a specified 3D object using its initial
+     *  pose (wrt world coordinates) by building the first set of tclc-histograms
+     *  from the current frames of all cameras. If the object was already
+     *  initialized this method will reset/stop tracking for it instead.
+     *
+     *  @param  frames The current frames of all cameras in the order of their calibrations (RGB, uchar).
+     *  @param  objectIndex The index of the object to be initialized.
+     *  @param  undistortFrames A flag indicating whether the images should first be undistorted (default = true).
+     */
+    void toggleTracking(std::vector<cv::Mat> &frames, int objectIndex, bool undistortFrames = true);
+    
+    /**
+     *  Tracks the 6DOF poses of all currently initialized objects by jointly
+     *  minimizing the region-based cost function in the frames of all cameras
+     *  and updates their tclc-histograms from every view afterwards.
+     *
+     *  @param  frames The current frames of all cameras in the order of their calibrations (RGB, uchar).
+     *  @param  undistortFrames A flag indicating whether the images should first be undistorted (default = true).
+     */
+    void estimatePoses(std::vector<cv::Mat> &frames, bool undistortFrames = true);
+    
+    /**
+     *  Resets/stops pose tracking for all objects by clearing the
+     *  respective sets of tclc-histograms.
+     */
+    void reset();
+    
+    /**
+     *  Returns the pose of an object wrt the coordinates of one of the cameras.
+     *
+     *  @param  objectIndex The index of the object.
+     *  @param  camera The index of the camera.
+     *  @return The pose of the object in camera coordinates.
+     */
+    cv::Matx44f getPoseInCamera(int objectIndex, int camera);
+    
+    /**
+     *  Sets the number of joint Gauss-Newton iterations per image pyramid level
+     *  performed in each frame.
+     *
+     *  @param  iterationsLevel2 The number of iterations at pyramid level 2 (default = 4).
+     *  @param  iterationsLevel1 The number of iterations at pyramid level 1 (default = 2).
+     *  @param  iterationsLevel0 The number of iterations at pyramid level 0 (default = 1).
+     */
+    void setOptimizationIterations(int iterationsLevel2, int iterationsLevel1, int iterationsLevel0);
+    
+private:
+    /**
+     *  The per camera state of the estimator.
+     */
+    struct CameraView
+    {
+        CameraCalibration calibration;
+        
+        cv::Mat map1;
+        cv::Mat map2;
+        
+        // the index of the camera within the rendering engine
+        int renderCamera;
+        
+        // the adjoint of the extrinsics mapping pose updates from world into camera coordinates
+        cv::Matx66f Ad_cw;
+        
+        // the histogram centers of every object within this view from its last update
+        std::vector<std::vector<cv::Point3i> > centersIDs;
+        
+        std::vector<cv::Mat> imagePyramid;
+    };
+    
+    std::vector<CameraView> views;
+    
+    std::vector<Object3D*> objects;
+    
+    RenderingEngine *renderingEngine;
+    OptimizationEngine *optimizationEngine;
+    
+    bool sharedRenderingEngine;
+    
+    int iterations[3];
+    
+    bool initialized;
+    
+    void prepareFrames(std::vector<cv::Mat> &frames, bool undistortFrames);
+    
+    void selectView(int v, const std::vector<cv::Matx44f> &worldPoses);
+    
+    void runIteration(std::vector<cv::Matx44f> &worldPoses, int level);
+    
+    void updateHistograms(int v, int objectIndex);
+};
+
+#endif /* MULTI_VIEW_POSE_ESTIMATOR_H */
@@ -33,6 +33,8 @@
  * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <map>
+
 #include "object3d.h"
 #include "tclc_histograms.h"
 #include "template_view.h"
@@ -55,6 +57,8 @@ Object3D::Object3D(const string objFilename, float tx, float ty, float tz, float
     
     this->numDistances = (int)templateDistances.size();
     
+    this->sharedTemplates = false;
+    
     this->tclcHistograms = new TCLCHistograms(this, 32, 40, 10.0f);
     
     // icosahedron geometry for generating the base templates
@@ -71,49 +75,12 @@ Object3D::Object3D(const string objFilename, float tx, float ty, float tz, float
     baseIcosahedron.push_back(Vec3f(1.61803, 0, 1));
     baseIcosahedron.push_back(Vec3f(1, -1.61803, 0));
     
-    // sub-divided icosahedron geometry for generating the neighboring templates
-    subdivIcosahedron.push_back(Vec3f(0, 1.90811, 0));
-    subdivIcosahedron.push_back(Vec3f(-0.589637, 1.54369, 0.954053));
-    subdivIcosahedron.push_back(Vec3f(0.589637, 1.54369, 0.954053));
-    subdivIcosahedron.push_back(Vec3f(0.589637, 1.54369, -0.954053));
-    subdivIcosahedron.push_back(Vec3f(-0.589637, 1.54369, -0.954053));
-    subdivIcosahedron.push_back(Vec3f(0, 0, -1.90811));
-    subdivIcosahedron.push_back(Vec3f(0.954053, 0.589637, -1.54369));
-    subdivIcosahedron.push_back(Vec3f(0.954053, -0.589637, -1.54369));
-    subdivIcosahedron.push_back(Vec3f(-0.954053, -0.589637, -1.54369));
-    subdivIcosahedron.push_back(Vec3f(-0.954053, 0.589637, -1.54369));
-    subdivIcosahedron.push_back(Vec3f(-1.90811, 0, 0));
-    subdivIcosahedron.push_back(Vec3f(-1.54369, -0.954053, -0.589637));
-    subdivIcosahedron.push_back(Vec3f(-1.54369, -0.954053, 0.589637));
-    subdivIcosahedron.push_back(Vec3f(-1.54369, 0.954053, 0.589637));
-    subdivIcosahedron.push_back(Vec3f(-1.54369, 0.954053, -0.589637));
-    subdivIcosahedron.push_back(Vec3f(0, 0, 1.90811));
-    subdivIcosahedron.push_back(Vec3f(-0.954053, 0.589637, 1.54369));
-    subdivIcosahedron.push_back(Vec3f(-0.954053, -0.589637, 1.54369));
-    subdivIcosahedron.push_back(Vec3f(0.954053, -0.589637, 1.54369));
-    subdivIcosahedron.push_back(Vec3f(0.954053, 0.589637, 1.54369));
-    subdivIcosahedron.push_back(Vec3f(1.90811, 0, 0));
-    subdivIcosahedron.push_back(Vec3f(1.54369, -0.954053, 0.589637));
-    subdivIcosahedron.push_back(Vec3f(1.54369, -0.954053, -0.589637));
-    subdivIcosahedron.push_back(Vec3f(1.54369, 0.954053, -0.589637));
-    subdivIcosahedron.push_back(Vec3f(1.54369, 0.954053, 0.589637));
-    subdivIcosahedron.push_back(Vec3f(0, -1.90811, 0));
-    subdivIcosahedron.push_back(Vec3f(-0.589637, -1.54369, -0.954053));
-    subdivIcosahedron.push_back(Vec3f(0.589637, -1.54369, -0.954053));
-    subdivIcosahedron.push_back(Vec3f(0.589637, -1.54369, 0.954053));
-    subdivIcosahedron.push_back(Vec3f(-0.589637, -1.54369, 0.954053));
-    subdivIcosahedron.push_back(Vec3f(-1.00074, 1.61923, 0));
-    subdivIcosahedron.push_back(Vec3f(0, 1.00074, 1.61923));
-    subdivIcosahedron.push_back(Vec3f(1.00074, 1.61923, 0));
-    subdivIcosahedron.push_back(Vec3f(0, 1.00074, -1.61923));
-    subdivIcosahedron.push_back(Vec3f(1.61923, 0, -1.00074));
-    subdivIcosahedron.push_back(Vec3f(0, -1.00074, -1.61923));
-    subdivIcosahedron.push_back(Vec3f(-1.61923, 0, -1.00074));
-    subdivIcosahedron.push_back(Vec3f(-1.00074, -1.61923, 0));
-    subdivIcosahedron.push_back(Vec3f(-1.61923, 0, 1.00074));
-    subdivIcosahedron.push_back(Vec3f(0, -1.00074, 1.61923));
-    subdivIcosahedron.push_back(Vec3f(1.61923, 0, 1.00074));
-    subdivIcosahedron.push_back(Vec3f(1.00074, -1.61923, 0));
+    // default hierarchy: the base views are rotated in-plane in 90 degree steps,
+    // the views of one subdivision in 30 degree steps
+    templateInPlaneSteps.push_back(90);
+    templateInPlaneSteps.push_back(30);
+    
+    templateNeighbors = 6;
 }
 
 
@@ -121,17 +88,23 @@ Object3D::~Object3D()
 {
     delete tclcHistograms;
     
-    for(int i = 0; i < baseTemplates.size(); i++)
-    {
-        delete baseTemplates[i];
-    }
-    baseTemplates.clear();
-    
-    for(int i = 0; i < neighboringTemplates.size(); i++)
+    deleteTemplates();
+}
+
+
+void Object3D::deleteTemplates()
+{
+    if(!sharedTemplates)
     {
-        delete neighboringTemplates[i];
+        for(int l = 0; l < templateHierarchy.size(); l++)
+        {
+            for(int i = 0; i < templateHierarchy[l].size(); i++)
+            {
+                delete templateHierarchy[l][i];
+            }
+        }
     }
-    neighboringTemplates.clear();
+    templateHierarchy.clear();
 }
 
 
@@ -157,87 +130,180 @@ TCLCHistograms *Object3D::getTCLCHistograms()
 }
 
 
-void Object3D::generateTemplates()
+void Object3D::setTemplateHierarchy(const vector<int> &inPlaneSteps, int numNeighbors)
 {
-    int numLevels = 4;
+    if(inPlaneSteps.size() < 2)
+        return;
     
-    int numBaseRotations = 4;
+    templateInPlaneSteps = inPlaneSteps;
+    templateNeighbors = numNeighbors;
+}
+
+
+vector<vector<Vec3f> > Object3D::computeGeodesicViewpoints(int numLevels)
+{
+    vector<vector<Vec3f> > viewpoints;
     
-    // create all base templates
+    vector<Vec3f> vertices;
     for(int i = 0; i < baseIcosahedron.size(); i++)
     {
-        Vec3f v = baseIcosahedron[i];
-        
-        float r = norm(v);
-        float alpha = acos(v[1]/r)*180.0f/float(CV_PI) - 90.0f;
-        float beta = atan2(v[0], v[2])*180.0f/float(CV_PI);
-        
-        for(int gamma = 0; gamma < 360; gamma += 90)
+        vertices.push_back(normalize(baseIcosahedron[i]));
+    }
+    
+    // the faces of the icosahedron are all triples of mutually adjacent vertices
+    float edgeLength = FLT_MAX;
+    for(int i = 1; i < vertices.size(); i++)
+    {
+        edgeLength = std::min(edgeLength, (float)norm(vertices[0] - vertices[i]));
+    }
+    
+    vector<Vec3i> faces;
+    for(int i = 0; i < vertices.size(); i++)
+    {
+        for(int j = i+1; j < vertices.size(); j++)
         {
-            for(int d = 0; d < numDistances; d++)
+            for(int k = j+1; k < vertices.size(); k++)
             {
-                baseTemplates.push_back(new TemplateView(this, alpha, beta, gamma, templateDistances[d], numLevels, true));
+                if(norm(vertices[i] - vertices[j]) < 1.01f*edgeLength
+                   && norm(vertices[j] - vertices[k]) < 1.01f*edgeLength
+                   && norm(vertices[i] - vertices[k]) < 1.01f*edgeLength)
+                {
+                    faces.push_back(Vec3i(i, j, k));
+                }
             }
         }
     }
     
-    int gamma2Precision = 30;
+    viewpoints.push_back(vertices);
     
-    // create all neighboring templates
-    for(int i = 0; i < subdivIcosahedron.size(); i++)
+    // each subdivision keeps all previous vertices and adds the projected edge midpoints
+    for(int l = 1; l < numLevels; l++)
     {
-        Vec3f v = subdivIcosahedron[i];
-        
-        float r = norm(v);
-        float alpha = acos(v[1]/r)*180.0f/float(CV_PI) - 90.0f;
-        float beta = atan2(v[0], v[2])*180.0f/float(CV_PI);
+        map<pair<int, int>, int> midpoints;
+        vector<Vec3i> subdivFaces;
         
-        for(int gamma = 0; gamma < 360; gamma += gamma2Precision)
+        for(int f = 0; f < faces.size(); f++)
         {
-            for(int d = 0; d < numDistances; d++)
+            int m[3];
+            for(int e = 0; e < 3; e++)
             {
-                neighboringTemplates.push_back(new TemplateView(this, alpha, beta, gamma, templateDistances[d], numLevels, true));
+                int v1 = faces[f][e];
+                int v2 = faces[f][(e+1)%3];
+                
+                pair<int, int> key(std::min(v1, v2), std::max(v1, v2));
+                
+                map<pair<int, int>, int>::iterator it = midpoints.find(key);
+                if(it == midpoints.end())
+                {
+                    vertices.push_back(normalize(vertices[v1] + vertices[v2]));
+                    m[e] = (int)vertices.size() - 1;
+                    midpoints[key] = m[e];
+                }
+                else
+                {
+                    m[e] = it->second;
+                }
             }
+            
+            subdivFaces.push_back(Vec3i(faces[f][0], m[0], m[2]));
+            subdivFaces.push_back(Vec3i(faces[f][1], m[1], m[0]));
+            subdivFaces.push_back(Vec3i(faces[f][2], m[2], m[1]));
+            subdivFaces.push_back(Vec3i(m[0], m[1], m[2]));
         }
+        
+        faces = subdivFaces;
+        
+        viewpoints.push_back(vertices);
     }
     
-    int gamma2Steps = 360/gamma2Precision;
+    return viewpoints;
+}
+
+
+void Object3D::generateTemplates(RenderingEngine *renderingEngine)
+{
+    int numLevels = 4;
     
-    // associate each base template with its corresponding neighboring templates
-    for(int i = 0; i < baseIcosahedron.size(); i++)
+    int numTreeLevels = (int)templateInPlaneSteps.size();
+    
+    vector<vector<Vec3f> > viewpoints = computeGeodesicViewpoints(numTreeLevels);
+    
+    vector<int> numRotations;
+    
+    // create all templates of each level of the viewpoint hierarchy
+    templateHierarchy.resize(numTreeLevels);
+    for(int l = 0; l < numTreeLevels; l++)
     {
-        Vec3f v1 = baseIcosahedron[i];
+        int gammaPrecision = templateInPlaneSteps[l];
         
-        vector<pair<float, int> > distanceMap;
+        numRotations.push_back((360 + gammaPrecision - 1)/gammaPrecision);
         
-        for(int j = 0; j < subdivIcosahedron.size(); j++)
+        for(int i = 0; i < viewpoints[l].size(); i++)
         {
-            Vec3f v2 = subdivIcosahedron[j];
+            Vec3f v = viewpoints[l][i];
+            
+            float r = norm(v);
+            float alpha = acos(v[1]/r)*180.0f/float(CV_PI) - 90.0f;
+            float beta = atan2(v[0], v[2])*180.0f/float(CV_PI);
             
-            float d = norm(v1 - v2);
-            distanceMap.push_back(pair<float, int>(d, j));
+            for(int gamma = 0; gamma < 360; gamma += gammaPrecision)
+            {
+                for(int d = 0; d < numDistances; d++)
+                {
+                    templateHierarchy[l].push_back(new TemplateView(this, alpha, beta, gamma, templateDistances[d], numLevels, l < numTreeLevels - 1, renderingEngine));
+                }
+            }
         }
+    }
+    
+    // associate each template with its closest templates of the next finer level
+    for(int l = 0; l < numTreeLevels - 1; l++)
+    {
+        int gamma2Precision = templateInPlaneSteps[l+1];
+        int gamma2Steps = numRotations[l+1];
         
-        sort(distanceMap.begin(), distanceMap.end(), sortDistance);
+        vector<Vec3f> &views1 = viewpoints[l];
+        vector<Vec3f> &views2 = viewpoints[l+1];
         
-        for(int n = 0; n < 6; n++)
+        for(int i = 0; i < views1.size(); i++)
         {
-            for(int g = 0; g < numBaseRotations; g++)
+            Vec3f v1 = views1[i];
+            
+            vector<pair<float, int> > distanceMap;
+            
+            for(int j = 0; j < views2.size(); j++)
             {
-                for(int d = 0; d < numDistances; d++)
+                Vec3f v2 = views2[j];
+                
+                float d = norm(v1 - v2);
+                distanceMap.push_back(pair<float, int>(d, j));
+            }
+            
+            sort(distanceMap.begin(), distanceMap.end(), sortDistance);
+            
+            for(int n = 0; n < std::min(templateNeighbors, (int)distanceMap.size()); n++)
+            {
+                for(int g = 0; g < numRotations[l]; g++)
                 {
-                    TemplateView *kv = baseTemplates[i*numBaseRotations*numDistances + numDistances*g + d];
-                    float gamma1 = kv->getGamma();
-                    
-                    int g2 = gamma1/gamma2Precision;
-                    
-                    kv->addNeighborTemplate(neighboringTemplates[distanceMap[n].second*gamma2Steps*numDistances + g2*numDistances + d]);
-                    
-                    int g3 = (g2+gamma2Steps+1)%gamma2Steps;
-                    kv->addNeighborTemplate(neighboringTemplates[distanceMap[n].second*gamma2Steps*numDistances + g3*numDistances + d]);
-                    
-                    int g4 = (g2+gamma2Steps-1)%gamma2Steps;
-                    kv->addNeighborTemplate(neighboringTemplates[distanceMap[n].second*gamma2Steps*numDistances + g4*numDistances + d]);
+                    for(int d = 0; d < numDistances; d++)
+                    {
+                        TemplateView *kv = templateHierarchy[l][i*numRotations[l]*numDistances + numDistances*g + d];
+                        float gamma1 = kv->getGamma();
+                        
+                        int g2 = gamma1/gamma2Precision;
+                        int g3 = (g2+gamma2Steps+1)%gamma2Steps;
+                        int g4 = (g2+gamma2Steps-1)%gamma2Steps;
+                        
+                        int neighborBase = distanceMap[n].second*gamma2Steps*numDistances;
+                        
+                        kv->addNeighborTemplate(templateHierarchy[l+1][neighborBase + g2*numDistances + d]);
+                        
+                        if(g3 != g2)
+                            kv->addNeighborTemplate(templateHierarchy[l+1][neighborBase + g3*numDistances + d]);
+                        
+                        if(g4 != g2 && g4 != g3)
+                            kv->addNeighborTemplate(templateHierarchy[l+1][neighborBase + g4*numDistances + d]);
+                    }
                 }
             }
         }
@@ -250,7 +316,16 @@ void Object3D::generateTemplates()
 
 vector<TemplateView*> Object3D::getTemplateViews()
 {
-    return baseTemplates;
+    if(templateHierarchy.empty())
+        return vector<TemplateView*>();
+    
+    return templateHierarchy[0];
+}
+
+
+int Object3D::getNumTemplateLevels()
+{
+    return (int)templateHierarchy.size();
 }
 
 
@@ -260,6 +335,23 @@ int Object3D::getNumDistances()
 }
 
 
+vector<vector<TemplateView*> > Object3D::releaseTemplates()
+{
+    sharedTemplates = true;
+    
+    return templateHierarchy;
+}
+
+
+void Object3D::useSharedTemplates(const vector<vector<TemplateView*> > &templateHierarchy)
+{
+    deleteTemplates();
+    
+    this->templateHierarchy = templateHierarchy;
+    sharedTemplates = true;
+}
+
+
 void Object3D::reset()
 {
     Model::reset();
@@ -40,6 +40,7 @@
 
 class TCLCHistograms;
 class TemplateView;
+class RenderingEngine;
 
 /**
  *  A representation of a 3D object that provides all nessecary information
@@ -102,23 +103,46 @@ public:
      */
     TCLCHistograms *getTCLCHistograms();
     
+    /**
+     *  Configures the viewpoint hierarchy used for template generation. The
+     *  viewpoints of the first level are the vertices of an icosahedron, each
+     *  further level is obtained by subdividing the previous one (i.e. 12, 42,
+     *  162, ... viewpoints). Every template is linked to the templates of its
+     *  closest viewpoints on the next level at similar in-plane rotations. Must
+     *  be called before the templates are generated.
+     *
+     *  @param  inPlaneSteps The in-plane rotation step in degrees per level of the hierarchy, at least two levels (default = [90, 30]).
+     *  @param  numNeighbors The number of closest viewpoints of the next level linked to each template (default = 6).
+     */
+    void setTemplateHierarchy(const std::vector<int> &inPlaneSteps, int numNeighbors = 6);
+    
     /**
      *  Generates all base and neighboring templates required for
      *  the pose detection algorithm after a tracking loss.
      *  Must be called after the rendering buffers of the
      *  corresponding 3D model have been initialized and while
      *  the offscreen rendering OpenGL context is active.
+     *
+     *  @param  renderingEngine The rendering engine whose context is active (default = NULL, i.e. RenderingEngine::Instance()).
      */
-    void generateTemplates();
+    void generateTemplates(RenderingEngine *renderingEngine = NULL);
     
     /**
-     *  Returns the set of all pre-generated base and neighboring template views
-     *  of this object used during pose detection.
+     *  Returns the set of all pre-generated base template views of this object,
+     *  i.e. the first level of the viewpoint hierarchy, used during pose detection.
+     *  The templates of the finer levels can be reached through their neighbors.
      *
-     *  @return  The set of all template views for this object.
+     *  @return  The set of all base template views for this object.
      */
     std::vector<TemplateView*> getTemplateViews();
     
+    /**
+     *  Returns the number of levels of the template viewpoint hierarchy.
+     *
+     *  @return  The number of levels of the template viewpoint hierarchy.
+     */
+    int getNumTemplateLevels();
+    
     /**
      *  Returns the number of Z-distances used during template view generation
      *  for this object.
@@ -127,6 +151,26 @@ public:
      */
     int getNumDistances();
     
+    /**
+     *  Hands the ownership of all generated template views over to the caller,
+     *  e.g. a TemplateCache. The object keeps using them for pose detection
+     *  but does not delete them anymore.
+     *
+     *  @return  The template views of all levels of the viewpoint hierarchy.
+     */
+    std::vector<std::vector<TemplateView*> > releaseTemplates();
+    
+    /**
+     *  Uses template views generated for another instance of the same 3D model
+     *  instead of generating them, e.g. when several tracking sessions detect the
+     *  same objects. The templates are only read during pose detection and are
+     *  not deleted by this object. They must have been generated for the same
+     *  model, scale, template distances and camera intrinsics.
+     *
+     *  @param  templateHierarchy The template views of all levels of the viewpoint hierarchy.
+     */
+    void useSharedTemplates(const std::vector<std::vector<TemplateView*> > &templateHierarchy);
+    
     /**
      *  Clears all tclc-histograms and resets the pose of the object to the initial
      *  configuration.
@@ -143,12 +187,20 @@ private:
     std::vector<float> templateDistances;
     
     std::vector<cv::Vec3f> baseIcosahedron;
-    std::vector<cv::Vec3f> subdivIcosahedron;
+    
+    std::vector<int> templateInPlaneSteps;
+    int templateNeighbors;
     
     TCLCHistograms *tclcHistograms;
     
-    std::vector<TemplateView*> baseTemplates;
-    std::vector<TemplateView*> neighboringTemplates;
+    std::vector<std::vector<TemplateView*> > templateHierarchy;
+    
+    // whether the templates are owned by someone else and must not be deleted
+    bool sharedTemplates;
+    
+    void deleteTemplates();
+    
+    std::vector<std::vector<cv::Vec3f> > computeGeodesicViewpoints(int numLevels);
     
 };
 
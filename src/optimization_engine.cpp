@@ -34,19 +34,22 @@
  */
 
 #include "optimization_engine.h"
+#include "profiler.h"
 
 using namespace std;
 using namespace cv;
 
 
-OptimizationEngine::OptimizationEngine(int width, int height)
+OptimizationEngine::OptimizationEngine(int width, int height, RenderingEngine *renderingEngine)
 {
-    renderingEngine = RenderingEngine::Instance();
+    this->renderingEngine = renderingEngine ? renderingEngine : RenderingEngine::Instance();
     
     SDT2D = new SignedDistanceTransform2D(8.0f);
     
     this->width = width;
     this->height = height;
+    
+    setIterations(4, 2, 1);
 }
 
 OptimizationEngine::~OptimizationEngine()
@@ -57,22 +60,24 @@ OptimizationEngine::~OptimizationEngine()
 
 void OptimizationEngine::minimize(vector<Mat>& imagePyramid, vector<Object3D*>& objects, int runs)
 {
+    RBOT_PROFILE_SCOPE("optimization");
+    
     // OPTIMIZATION ITERATIONS
     
     // level 2
-    for(int iter = 0; iter < runs*4; iter++)
+    for(int iter = 0; iter < runs*iterations[2]; iter++)
     {
         runIteration(objects, imagePyramid, 2);
     }
     
     // level 1
-    for(int iter = 0; iter < runs*2; iter++)
+    for(int iter = 0; iter < runs*iterations[1]; iter++)
     {
         runIteration(objects, imagePyramid, 1);
     }
     
     // level 0
-    for(int iter = 0; iter < runs*1; iter++)
+    for(int iter = 0; iter < runs*iterations[0]; iter++)
     {
         runIteration(objects, imagePyramid, 0);
     }
@@ -80,12 +85,45 @@ void OptimizationEngine::minimize(vector<Mat>& imagePyramid, vector<Object3D*>&
 
 
 
+void OptimizationEngine::setIterations(int iterationsLevel2, int iterationsLevel1, int iterationsLevel0)
+{
+    iterations[2] = iterationsLevel2;
+    iterations[1] = iterationsLevel1;
+    iterations[0] = iterationsLevel0;
+}
+
+
 void OptimizationEngine::runIteration(vector<Object3D*>& objects, const vector<Mat>& imagePyramid, int level)
+{
+    RBOT_PROFILE_SCOPE("runIteration");
+    
+    vector<Matx66f> wJTJ;
+    vector<Matx61f> JT;
+    vector<bool> valid;
+    
+    computeJacobians(imagePyramid, objects, level, wJTJ, JT, valid);
+    
+    for(int o = 0; o < objects.size(); o++)
+    {
+        if(valid[o])
+        {
+            // update the pose by computing the Gauss-Newton step
+            applyStepGaussNewton(objects[o], wJTJ[o], JT[o]);
+        }
+    }
+}
+
+
+void OptimizationEngine::computeJacobians(const vector<Mat>& imagePyramid, vector<Object3D*>& objects, int level, vector<Matx66f>& wJTJ, vector<Matx61f>& JT, vector<bool>& valid)
 {
     Rect roi;
     Mat mask, depth, depthInv, sdt, xyPos;
     Mat croppedMask, croppedDepth, croppedDepthInv;
     
+    wJTJ.assign(objects.size(), Matx66f::zeros());
+    JT.assign(objects.size(), Matx61f::zeros());
+    valid.assign(objects.size(), false);
+    
     renderingEngine->setLevel(level);
     
     int numInitialized = 0;
@@ -96,7 +134,7 @@ void OptimizationEngine::runIteration(vector<Object3D*>& objects, const vector<M
     {
         if(objects[o]->isInitialized())
         {
-            roi = compute2DROI(objects[o], Size(width/pow(2, level), height/pow(2, level)), 8);
+            roi = compute2DROI(objects[o], imagePyramid[level].size(), 8);
             
             if(roi.area() != 0)
             {
@@ -104,13 +142,15 @@ void OptimizationEngine::runIteration(vector<Object3D*>& objects, const vector<M
                 {
                     level--;
                     renderingEngine->setLevel(level);
-                    roi = compute2DROI(objects[o], Size(width/pow(2, level), height/pow(2, level)), 8);
+                    roi = compute2DROI(objects[o], imagePyramid[level].size(), 8);
                 }
             }
             numInitialized++;
         }
     }
     
+    RBOT_PROFILE_COUNT("iterations_level" + to_string(level), 1);
+    
     // render the common silhouette mask
     renderingEngine->setLevel(level);
     renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
@@ -134,13 +174,15 @@ void OptimizationEngine::runIteration(vector<Object3D*>& objects, const vector<M
         if(objects[o]->isInitialized())
         {
             // compute the 2D region of interest containing the silhouette of the current object
-            roi = compute2DROI(objects[o], Size(width/pow(2, level), height/pow(2, level)), 8);
+            roi = compute2DROI(objects[o], imagePyramid[level].size(), 8);
             
             if(roi.area() == 0)
             {
                 continue;
             }
             
+            RBOT_PROFILE_COUNT("roi_area", roi.area());
+            
             // render the individual inverse depth buffer per object
             renderingEngine->renderSilhouette(objects[o], GL_FILL, true);
             depthInv = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
@@ -155,16 +197,13 @@ void OptimizationEngine::runIteration(vector<Object3D*>& objects, const vector<M
             // compute the 2D signed distance transform of the silhouette
             SDT2D->computeTransform(croppedMask, sdt, xyPos, 8, m_id);
             
-            // the hessian approximation
-            Matx66f wJTJ;
-            // the gradient
-            Matx61f JT;
+            // the number of pixels within the contour band contributing to the Jacobians
+            RBOT_PROFILE_COUNT("band_pixels", countNonZero(abs(sdt) <= 8.0f));
             
             // compute the Jacobian terms (i.e. the gradient and the hessian approx.) needed for the Gauss-Newton step
-            parallel_computeJacobians(objects[o], imagePyramid[level], croppedDepth, croppedDepthInv, sdt, xyPos, roi, croppedMask, m_id, level, wJTJ, JT, roi.height);
+            parallel_computeJacobians(objects[o], imagePyramid[level], croppedDepth, croppedDepthInv, sdt, xyPos, roi, croppedMask, m_id, level, wJTJ[o], JT[o], roi.height);
             
-            // update the pose by computing the Gauss-Newton step
-            applyStepGaussNewton(objects[o], wJTJ, JT);
+            valid[o] = true;
         }
     }
 }
@@ -172,6 +211,8 @@ void OptimizationEngine::runIteration(vector<Object3D*>& objects, const vector<M
 
 void OptimizationEngine::parallel_computeJacobians(Object3D* object, const Mat& frame, const Mat& depth, const Mat& depthInv, const Mat& sdt, const Mat& xyPos, const Rect& roi, const cv::Mat& mask, int m_id, int level, Matx66f& wJTJ, Matx61f &JT, int threads)
 {
+    RBOT_PROFILE_SCOPE("jacobians");
+    
     float zNear = renderingEngine->getZNear();
     float zFar = renderingEngine->getZFar();
     Matx33f K = renderingEngine->getCalibrationMatrix().get_minor<3, 3>(0, 0);
@@ -202,11 +243,16 @@ void OptimizationEngine::parallel_computeJacobians(Object3D* object, const Mat&
 
 Rect OptimizationEngine::compute2DROI(Object3D* object, const cv::Size& maxSize, int offset)
 {
-    // PROJECT THE 3D BOUNDING BOX AS 2D ROI
+    // PROJECT THE 3D CONVEX HULL AS 2D ROI
     Rect boundingRect;
     vector<Point2f> projections;
     
-    renderingEngine->projectBoundingBox(object, projections, boundingRect);
+    if(!renderingEngine->projectConvexHull(object, projections, boundingRect))
+    {
+        // fall back to the 3D bounding box if the object is partially behind the camera
+        projections.clear();
+        renderingEngine->projectBoundingBox(object, projections, boundingRect);
+    }
     
     if(boundingRect.x >= maxSize.width || boundingRect.y >= maxSize.height
        || boundingRect.x + boundingRect.width <= 0 || boundingRect.y + boundingRect.height <= 0)
@@ -241,12 +287,12 @@ void OptimizationEngine::applyStepGaussNewton(Object3D* object, const Matx66f& w
     Matx61f delta_xi = -wJTJ.inv(DECOMP_CHOLESKY)*JT;
     
     // get the current pose
-    Matx44f T_cm = object->getPose();
+    PoseSE3 T_cm = PoseSE3(object->getPose());
     
     // apply the update step in SE3
-    T_cm = Transformations::exp(delta_xi)*T_cm;
+    T_cm = PoseSE3(Transformations::exp(delta_xi))*T_cm;
     
     // set the updated pose
-    object->setPose(T_cm);
+    object->setPose(T_cm.toMatx44f());
 }
 
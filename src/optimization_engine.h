@@ -60,8 +60,9 @@ public:
      *
      *  @param width  The width in pixels of the camera frame at full resolution.
      *  @param height  The height in pixels of the camera frame at full resolution.
+     *  @param renderingEngine  The rendering engine to be used (default = NULL, i.e. RenderingEngine::Instance()).
      */
-    OptimizationEngine(int width, int height);
+    OptimizationEngine(int width, int height, RenderingEngine *renderingEngine = NULL);
     
     ~OptimizationEngine();
     
@@ -80,6 +81,31 @@ public:
      */
     void minimize(std::vector<cv::Mat> &imagePyramid, std::vector<Object3D*> &objects, int runs = 1);
     
+    /**
+     *  Sets the default number of Gauss-Newton iterations performed per
+     *  image pyramid level within a single run of minimize().
+     *
+     *  @param  iterationsLevel2 The number of iterations at pyramid level 2 (default = 4).
+     *  @param  iterationsLevel1 The number of iterations at pyramid level 1 (default = 2).
+     *  @param  iterationsLevel0 The number of iterations at pyramid level 0 (default = 1).
+     */
+    void setIterations(int iterationsLevel2, int iterationsLevel1, int iterationsLevel0);
+    
+    /**
+     *  Computes the Jacobian terms of a single Gauss-Newton iteration for all
+     *  initialized objects wrt the camera currently selected in the rendering
+     *  engine, without updating their poses. This allows combining the terms
+     *  of several views of the same objects into a single pose update.
+     *
+     *  @param  imagePyramid A coarse to fine image pyramid of the camera frame (at least 3 levels, RGB, uchar).
+     *  @param  objects A collection 3d objects of which the poses are supposed to be optimized.
+     *  @param  level The pyramid level, which is lowered if an object appears too small at this level.
+     *  @param  wJTJ The hessian approximations per object wrt a pose update in camera coordinates.
+     *  @param  JT The gradients per object wrt a pose update in camera coordinates.
+     *  @param  valid Tells for every object whether its terms were computed, i.e. whether it is initialized and visible.
+     */
+    void computeJacobians(const std::vector<cv::Mat> &imagePyramid, std::vector<Object3D*> &objects, int level, std::vector<cv::Matx66f> &wJTJ, std::vector<cv::Matx61f> &JT, std::vector<bool> &valid);
+    
 private:
     static OptimizationEngine *instance;
     
@@ -90,6 +116,8 @@ private:
     int width;
     int height;
     
+    int iterations[3];
+    
     void runIteration(std::vector<Object3D*> &objects, const std::vector<cv::Mat> &imagePyramid, int level);
     
     void parallel_computeJacobians(Object3D *object, const cv::Mat &frame, const cv::Mat &depth, const cv::Mat &depthInv, const cv::Mat &sdt, const cv::Mat &xyPos, const cv::Rect &roi, const cv::Mat &mask, int m_id, int level, cv::Matx66f &wJTJ, cv::Matx61f &JT, int threads);
@@ -34,20 +34,20 @@
  */
 
 #include "pose_estimator6d.h"
+#include "profiler.h"
 
 using namespace std;
 using namespace cv;
 
-bool sortTemplateView(std::pair<float, TemplateView*> a, std::pair<float, TemplateView*> b)
+PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar, const cv::Matx33f &K, const cv::Matx14f &distCoeffs, vector<Object3D*> &objects, RenderingEngine *renderingEngine)
 {
-    return a.first < b.first;
-}
-
-
-PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar, const cv::Matx33f &K, const cv::Matx14f &distCoeffs, vector<Object3D*> &objects)
-{
-    renderingEngine = RenderingEngine::Instance();
-    optimizationEngine = new OptimizationEngine(width, height);
+    sharedRenderingEngine = (renderingEngine == NULL);
+    
+    if(sharedRenderingEngine)
+        renderingEngine = RenderingEngine::Instance();
+    
+    this->renderingEngine = renderingEngine;
+    optimizationEngine = new OptimizationEngine(width, height, renderingEngine);
     
     SDT2D = new SignedDistanceTransform2D(8.0f);
     
@@ -61,6 +61,12 @@ PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar,
     
     initialized = false;
     
+    relocalizationBudget = 0.0f;
+    
+    relocalizationWorker = NULL;
+    
+    motionPrediction = false;
+    
     //start initialization
     renderingEngine->init(K, width, height, zNear, zFar, 4);
     
@@ -71,10 +77,19 @@ PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar,
         objects[i]->setModelID(i+1);
         this->objects.push_back(objects[i]);
         this->objects[i]->initBuffers();
-        this->objects[i]->generateTemplates();
+        // templates shared through a TemplateCache are not generated again
+        if(this->objects[i]->getNumTemplateLevels() == 0)
+            this->objects[i]->generateTemplates(renderingEngine);
         this->objects[i]->reset();
     }
     
+    relocalizationStates.resize(this->objects.size());
+    
+    for(int i = 0; i < this->objects.size(); i++)
+    {
+        motionModels.push_back(new MotionModel());
+    }
+    
     renderingEngine->doneCurrent();
     
     tmp = 0;
@@ -83,7 +98,16 @@ PoseEstimator6D::PoseEstimator6D(int width, int height, float zNear, float zFar,
 
 PoseEstimator6D::~PoseEstimator6D()
 {
-    renderingEngine->destroy();
+    if(relocalizationWorker)
+        delete relocalizationWorker;
+    
+    for(int i = 0; i < motionModels.size(); i++)
+    {
+        delete motionModels[i];
+    }
+    
+    if(sharedRenderingEngine)
+        renderingEngine->destroy();
     
     delete optimizationEngine;
     
@@ -93,6 +117,8 @@ PoseEstimator6D::~PoseEstimator6D()
 
 void PoseEstimator6D::toggleTracking(cv::Mat &frame, int objectIndex, bool undistortFrame)
 {
+    RBOT_PROFILE_SCOPE("toggleTracking");
+    
     if(objectIndex >= objects.size())
         return;
     
@@ -115,11 +141,18 @@ void PoseEstimator6D::toggleTracking(cv::Mat &frame, int objectIndex, bool undis
         
         objects[objectIndex]->getTCLCHistograms()->update(frame, mask, depth, K, zNear, zFar);
         
+        motionModels[objectIndex]->reset();
+        motionModels[objectIndex]->update(objects[objectIndex]->getPose());
+        
         initialized = true;
     }
     else
     {
+        if(relocalizationWorker)
+            relocalizationWorker->cancel(objectIndex);
+        
         objects[objectIndex]->reset();
+        relocalizationStates[objectIndex].reset();
         
         initialized = false;
         for(int o = 0; o < objects.size(); o++)
@@ -132,22 +165,39 @@ void PoseEstimator6D::toggleTracking(cv::Mat &frame, int objectIndex, bool undis
 
 void PoseEstimator6D::estimatePoses(cv::Mat &frame, bool undistortFrame, bool checkForLoss)
 {
-    if(undistortFrame)
-        remap(frame, frame, map1, map2, INTER_LINEAR);
-
-    vector<Mat> imagePyramid;
-    
-    Mat frameCpy = frame.clone();
-    imagePyramid.push_back(frameCpy);
+    RBOT_PROFILE_FRAME();
+    RBOT_PROFILE_SCOPE("estimatePoses");
     
-    for(int l = 1; l < 4; l++)
+    vector<Mat> imagePyramid;
     {
-        resize(frame, frameCpy, Size(frame.cols/pow(2, l), frame.rows/pow(2, l)));
+        RBOT_PROFILE_SCOPE("imagePyramid");
+        
+        if(undistortFrame)
+            remap(frame, frame, map1, map2, INTER_LINEAR);
+        
+        Mat frameCpy = frame.clone();
         imagePyramid.push_back(frameCpy);
+        
+        for(int l = 1; l < 4; l++)
+        {
+            resize(frame, frameCpy, Size(frame.cols/pow(2, l), frame.rows/pow(2, l)));
+            imagePyramid.push_back(frameCpy);
+        }
     }
     
     if(initialized)
     {
+        if(motionPrediction)
+        {
+            for(int i = 0; i < objects.size(); i++)
+            {
+                if(objects[i]->isInitialized() && !objects[i]->isTrackingLost() && motionModels[i]->getNumObservations() > 1)
+                {
+                    objects[i]->setPose(motionModels[i]->predict());
+                }
+            }
+        }
+        
         optimizationEngine->minimize(imagePyramid, objects);
         
         renderingEngine->setLevel(0);
@@ -175,180 +225,197 @@ void PoseEstimator6D::estimatePoses(cv::Mat &frame, bool undistortFrame, bool ch
                     {
                         objects[i]->setTrackingLost(true);
                         objects[i]->setPose(Matx44f());
+                        relocalizationStates[i].reset();
+                        motionModels[i]->reset();
                     }
                     else
                     {
                         objects[i]->getTCLCHistograms()->update(frame, mask, depth, K, zNear, zFar);
+                        
+                        motionModels[i]->update(objects[i]->getPose());
                     }
                 }
                 else
                 {
-                    relocalize(objects[i], imagePyramid);
+                    relocalize(i, imagePyramid);
                 }
             }
         }
     }
 }
 
-void PoseEstimator6D::relocalize(Object3D *object, vector<Mat> &imagePyramid)
+void PoseEstimator6D::relocalize(int objectIndex, vector<Mat> &imagePyramid)
 {
-    vector<TemplateView*> templateViews = object->getTemplateViews();
-    
-    int numDistances = object->getNumDistances();
-    
-    int level = 3;
+    RBOT_PROFILE_SCOPE("relocalize");
     
-    // PREPARE FRAME FOR LOWEST LEVEL
-    Mat binned;
-    parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[level], binned, object->getTCLCHistograms()->getNumBins(), 8));
+    Object3D *object = objects[objectIndex];
+    RelocalizationState &state = relocalizationStates[objectIndex];
     
-    Mat prMap;
-    parallel_for_(cv::Range(0, 8), Parallel_For_createPosteriorResponseMap(object->getTCLCHistograms(), binned, prMap, 8));
-    
-    parallel_for_(cv::Range(0, (int)templateViews.size()), Parallel_For_exhaustiveSearch(object, templateViews, binned, prMap, level, 4, -1));
-    
-    parallel_for_(cv::Range(0, (int)templateViews.size()), Parallel_For_exhaustiveSearch(object, templateViews, binned, prMap, level, 1, 2));
-    
-    
-    // KEEP ONLY THE BEST MATCHING DISTANCE PER TEMPLATE
-    vector<pair<float, TemplateView*> > errorKVMap0;
-    
-    for(int i = 0; i < templateViews.size(); i+=numDistances)
+    if(relocalizationWorker && state.stage < RelocalizationState::REFINEMENT)
     {
-        float minE = FLT_MAX;
-        int minIdx = -1;
-        for(int j = 0; j < numDistances; j++)
+        // the template search is performed in the background, only refinement is done here
+        if(!state.pending)
         {
-            TemplateView *templateView = templateViews[i+j];
-            Point3f offset = templateView->getCurrentOffset(level);
-            
-            if(offset.z < minE)
-            {
-                minE = offset.z;
-                minIdx = j;
-            }
+            relocalizationWorker->submit(object, objectIndex, imagePyramid);
+            state.pending = true;
         }
-        if(minE > 0.0f && minIdx >= 0)
+        
+        if(!relocalizationWorker->fetchResult(objectIndex, state))
         {
-            errorKVMap0.push_back(pair<float, TemplateView*>(minE, templateViews[i + minIdx]));
+            object->setPose(Matx44f());
+            return;
         }
+        
+        state.pending = false;
     }
     
-    sort(errorKVMap0.begin(), errorKVMap0.end(), sortTemplateView);
+    // the binned images are only computed for the levels actually needed within this frame
+    vector<Mat> binnedPyramid(imagePyramid.size());
     
-    level = 2;
+    int64 startTicks = getTickCount();
     
-    // PREPARE FRAME FOR 2ND LOWEST LEVEL
-    parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[level], binned, object->getTCLCHistograms()->getNumBins(), 8));
+    bool finished = false;
+    do
+    {
+        finished = relocalizationStep(object, state, imagePyramid, binnedPyramid);
+    }
+    while(!finished && (relocalizationBudget <= 0.0f || 1000.0*(getTickCount() - startTicks)/getTickFrequency() < relocalizationBudget));
     
-    vector<pair<float, TemplateView*> > errorKVMap;
+    if(!finished)
+    {
+        // detection is resumed with the next frame
+        object->setPose(Matx44f());
+        return;
+    }
     
-    for(int i = 0; i < errorKVMap0.size()/2; i++)
+    if(state.found)
     {
-        float kve = errorKVMap0[i].first;
-        TemplateView *templateView = errorKVMap0[i].second;
+        object->setPose(state.finalPose);
+        object->setTrackingLost(false);
+        
+        // the velocity is unknown after a detection
+        motionModels[objectIndex]->reset();
+        motionModels[objectIndex]->update(state.finalPose);
         
-        if(kve > 0.0f && kve < 1.0f)
+        // the histogram centers are updated from the rendered mask with the next frame
+        object->getTCLCHistograms()->updateCentersAndIds(K, imagePyramid[0].size());
+    }
+    else
+    {
+        object->setPose(Matx44f());
+    }
+    
+    // start over with the next frame if nothing was found
+    state.reset();
+}
+
+
+bool PoseEstimator6D::relocalizationStep(Object3D *object, RelocalizationState &state, vector<Mat> &imagePyramid, vector<Mat> &binnedPyramid)
+{
+    switch(state.stage)
+    {
+        case RelocalizationState::EXHAUSTIVE_SEARCH:
+        case RelocalizationState::NEIGHBOR_SEARCH:
+        {
+            RelocalizationWorker::searchStep(object, state, imagePyramid, binnedPyramid);
+            
+            return false;
+        }
+        case RelocalizationState::REFINEMENT:
         {
-            parallel_for_(cv::Range(0, (int)templateView->getNeighborTemplates().size()), Parallel_For_neighborSearch(object, templateView, binned, level, 1));
+            int level = 2;
+            
+            if(state.next >= std::min(4, (int)state.neighborCandidates.size()))
+            {
+                evaluateRefinedPoses(object, state, imagePyramid, binnedPyramid);
+                
+                state.stage = RelocalizationState::FINISHED;
+                return true;
+            }
+            
+            TemplateMatch match = state.neighborCandidates[state.next];
+            TemplateView *templateView = match.templateView;
+            
+            state.next++;
             
-            for(int n = 0; n < templateView->getNeighborTemplates().size(); n++)
+            Point3f offset = match.offset;
+            int offsetX = offset.x;
+            int offsetY = offset.y;
+            float offsetE = offset.z;
+            
+            if(offsetE > 0 && offsetE < 1.0f)
             {
-                TemplateView* kvn = templateView->getNeighborTemplates()[n];
+                Rect roi = templateView->getROI(level);
+                
+                Vec3f offsetVec((-roi.x+offsetX)*pow(2, level)+imagePyramid[0].cols/2, (-roi.y+offsetY)*pow(2, level)+imagePyramid[0].rows/2, 1);
                 
-                float e = kvn->getCurrentOffset(level).z;
+                Matx44f pose = templateView->getPose();
                 
-                if(e > 0.0f && e < 1.0f)
-                    errorKVMap.push_back(pair<float, TemplateView*>(e, kvn));
+                offsetVec = K.inv()*offsetVec;
+                pose(0, 3) = offsetVec[0]*pose(2, 3);
+                pose(1, 3) = offsetVec[1]*pose(2, 3);
+                
+                object->setPose(pose);
+                
+                // the centers only select the local histograms during refinement, no render is needed
+                object->getTCLCHistograms()->updateCentersAndIds(K, imagePyramid[0].size());
+                
+                vector<Object3D*> tmp;
+                tmp.push_back(object);
+                
+                optimizationEngine->minimize(imagePyramid, tmp, 2);
+                
+                // all refined candidates are evaluated together once the last one has been refined
+                state.refinedPoses.push_back(object->getPose());
             }
+            
+            return false;
         }
+        default:
+            return true;
     }
+}
+
+
+void PoseEstimator6D::evaluateRefinedPoses(Object3D *object, RelocalizationState &state, vector<Mat> &imagePyramid, vector<Mat> &binnedPyramid)
+{
+    if(state.refinedPoses.empty())
+        return;
     
-    sort(errorKVMap.begin(), errorKVMap.end(), sortTemplateView);
-    
-    parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[0], binned, object->getTCLCHistograms()->getNumBins(), 8));
+    const Mat &binned = RelocalizationWorker::getBinned(object->getTCLCHistograms(), imagePyramid, binnedPyramid, 0);
     
-    float minE = FLT_MAX;
-    int finalIdx = -1;
-    Matx44f finalPose;
+    // render all refined candidates into one atlas and download it at once
+    renderingEngine->setLevel(0);
+    bool atlas = renderingEngine->renderSilhouetteAtlas(object, state.refinedPoses, GL_FILL);
     
-    bool trackingLost = true;
+    vector<Mat> masks, depths;
+    if(atlas)
+    {
+        renderingEngine->downloadAtlas(RenderingEngine::MASK, masks);
+        renderingEngine->downloadAtlas(RenderingEngine::DEPTH, depths);
+    }
     
-    for(int i = 0; i < std::min(4, (int)errorKVMap.size()); i++)
+    for(int i = 0; i < state.refinedPoses.size(); i++)
     {
-        TemplateView *templateView = errorKVMap[i].second;
+        object->setPose(state.refinedPoses[i]);
         
-        Point3f offset = templateView->getCurrentOffset(level);;
-        int offsetX = offset.x;
-        int offsetY = offset.y;
-        float offsetE = offset.z;
+        float e;
+        if(atlas)
+            e = evaluateEnergyFunction(object, masks[i], depths[i], binned, 0, 8);
+        else
+            e = evaluateEnergyFunction(object, binned, 0, 8);
         
-        if(offsetE > 0 && offsetE < 1.0f)
+        if(e > 0.0f && e < state.minE)
         {
-            Rect roi = templateView->getROI(level);
-            
-            Vec3f offsetVec((-roi.x+offsetX)*pow(2, level)+imagePyramid[0].cols/2, (-roi.y+offsetY)*pow(2, level)+imagePyramid[0].rows/2, 1);
-            
-            Matx44f pose = templateView->getPose();
-            
-            offsetVec = K.inv()*offsetVec;
-            pose(0, 3) = offsetVec[0]*pose(2, 3);
-            pose(1, 3) = offsetVec[1]*pose(2, 3);
-            
-            object->setPose(pose);
-            
-            renderingEngine->setLevel(0);
-            renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
+            state.minE = e;
+            state.finalPose = state.refinedPoses[i];
             
-            Mat mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
-            Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
-            
-            float zNear = renderingEngine->getZNear();
-            float zFar = renderingEngine->getZFar();
-            
-            object->getTCLCHistograms()->updateCentersAndIds(mask, depth, K, zNear, zFar, 0);
-            
-            vector<Object3D*> tmp;
-            tmp.push_back(object);
-            
-            optimizationEngine->minimize(imagePyramid, tmp, 2);
-            
-            float e = evaluateEnergyFunction(object, binned, 0, 8);
-            
-            if(e > 0.0f && e < minE)
+            if(e < object->getQualityThreshold())
             {
-                minE = e;
-                finalPose = object->getPose();
-                
-                if(e < object->getQualityThreshold())
-                {
-                    trackingLost = false;
-                    finalIdx = i;
-                }
+                state.found = true;
             }
         }
     }
-    if(!trackingLost)
-    {
-        object->setPose(finalPose);
-        object->setTrackingLost(false);
-        
-        renderingEngine->setLevel(0);
-        renderingEngine->renderSilhouette(vector<Model*>(objects.begin(), objects.end()), GL_FILL);
-        
-        Mat mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
-        Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
-        
-        float zNear = renderingEngine->getZNear();
-        float zFar = renderingEngine->getZFar();
-        
-        object->getTCLCHistograms()->updateCentersAndIds(mask, depth, K, zNear, zFar, 0);
-        
-    }
-    else
-    {
-        object->setPose(Matx44f());
-    }
 }
 
 
@@ -397,6 +464,8 @@ float PoseEstimator6D::evaluateEnergyFunction(Object3D *object, const Mat &binne
 
 float PoseEstimator6D::evaluateEnergyFunction(Object3D *object, const Mat &mask, const Mat &depth, const Mat &binned, int level, int threads)
 {
+    RBOT_PROFILE_SCOPE("energyEvaluation");
+    
     float zNear = renderingEngine->getZNear();
     float zFar = renderingEngine->getZFar();
     
@@ -463,8 +532,66 @@ void PoseEstimator6D::reset()
 {
     for(int i = 0; i < objects.size(); i++)
     {
+        if(relocalizationWorker)
+            relocalizationWorker->cancel(i);
+        
         objects[i]->reset();
+        relocalizationStates[i].reset();
+        motionModels[i]->reset();
     }
     
     initialized = false;
 }
+
+
+void PoseEstimator6D::setRelocalizationBudget(float milliseconds)
+{
+    relocalizationBudget = milliseconds;
+}
+
+
+float PoseEstimator6D::getRelocalizationBudget()
+{
+    return relocalizationBudget;
+}
+
+
+void PoseEstimator6D::setAsynchronousRelocalization(bool enabled)
+{
+    if(enabled && !relocalizationWorker)
+    {
+        relocalizationWorker = new RelocalizationWorker();
+        relocalizationWorker->start();
+    }
+    else if(!enabled && relocalizationWorker)
+    {
+        delete relocalizationWorker;
+        relocalizationWorker = NULL;
+        
+        for(int i = 0; i < relocalizationStates.size(); i++)
+        {
+            relocalizationStates[i].reset();
+        }
+    }
+}
+
+
+void PoseEstimator6D::setMotionPrediction(bool enabled, bool useKalmanFilter)
+{
+    motionPrediction = enabled;
+    
+    for(int i = 0; i < motionModels.size(); i++)
+    {
+        delete motionModels[i];
+        motionModels[i] = new MotionModel(useKalmanFilter);
+        
+        if(objects[i]->isInitialized() && !objects[i]->isTrackingLost())
+            motionModels[i]->update(objects[i]->getPose());
+    }
+}
+
+
+void PoseEstimator6D::setOptimizationIterations(int iterationsLevel2, int iterationsLevel1, int iterationsLevel0)
+{
+    optimizationEngine->setIterations(iterationsLevel2, iterationsLevel1, iterationsLevel0);
+}
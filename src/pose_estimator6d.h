@@ -45,6 +45,8 @@
 #include "optimization_engine.h"
 #include "signed_distance_transform2d.h"
 #include "template_view.h"
+#include "relocalization_worker.h"
+#include "motion_model.h"
 
 /**
  *  This class implements a region-based 6DOF pose estimator in form of a
@@ -64,7 +66,8 @@ public:
      *      [0  0  1]
      *  and distortion coefficients (as needed by OpenCV).
      *  It also initializes the OpenGL rendering buffers for all
-     *  provided 3D objects using the OpenGL context of the engine.
+     *  provided 3D objects using the OpenGL context of the engine and
+     *  generates their templates, unless they already use shared ones.
      *
      *  @param  width The width in pixels of the camera frame at full resolution.
      *  @param  height The height in pixels of the camera frame at full resolution.
@@ -73,8 +76,9 @@ public:
      *  @param  K The intrinsic camera matrix.
      *  @param  distCoeffs The cameras lens distortion coefficients.
      *  @param  objects A collection of all 3D objects to be tracked.
+     *  @param  renderingEngine A rendering engine owned by the caller, e.g. one per tracking thread (default = NULL, i.e. RenderingEngine::Instance(), which is destroyed along with the estimator).
      */
-    PoseEstimator6D(int width, int height, float zNear, float zFar, const cv::Matx33f &K, const cv::Matx14f &distCoeffs, std::vector<Object3D*> &objects);
+    PoseEstimator6D(int width, int height, float zNear, float zFar, const cv::Matx33f &K, const cv::Matx14f &distCoeffs, std::vector<Object3D*> &objects, RenderingEngine *renderingEngine = NULL);
     
     ~PoseEstimator6D();
     
@@ -115,6 +119,57 @@ public:
      */
     void reset();
     
+    /**
+     *  Sets the maximum time per frame that may be spent on detecting
+     *  the pose of objects for which tracking has been lost. Detection
+     *  is then spread across several consecutive frames and resumed
+     *  where it was suspended. At least one detection step is performed
+     *  per frame regardless of the budget.
+     *
+     *  @param  milliseconds The time budget per frame in ms (0 = unbounded, i.e. detection completes within a single frame).
+     */
+    void setRelocalizationBudget(float milliseconds);
+    
+    /**
+     *  Returns the current time budget per frame for pose detection.
+     *
+     *  @return  The time budget per frame in ms (0 = unbounded).
+     */
+    float getRelocalizationBudget();
+    
+    /**
+     *  Enables or disables performing the template matching stages of pose
+     *  detection within a background thread. When enabled, the search for
+     *  lost objects no longer delays tracking of all other objects and only
+     *  the final refinement of the best matching templates is performed
+     *  within estimatePoses().
+     *
+     *  @param  enabled True to search for lost objects in the background (default = false).
+     */
+    void setAsynchronousRelocalization(bool enabled);
+    
+    /**
+     *  Enables or disables predicting the pose of every tracked object from
+     *  its previous motion using a constant velocity model. The prediction is
+     *  used as the starting point of the pose optimization instead of the pose
+     *  of the previous frame.
+     *
+     *  @param  enabled True to predict poses before optimization (default = false).
+     *  @param  useKalmanFilter A flag telling whether the estimated velocities should be Kalman filtered (default = false).
+     */
+    void setMotionPrediction(bool enabled, bool useKalmanFilter = false);
+    
+    /**
+     *  Sets the number of Gauss-Newton iterations per image pyramid level
+     *  performed for tracking in each frame. With motion prediction enabled,
+     *  fewer iterations are usually required.
+     *
+     *  @param  iterationsLevel2 The number of iterations at pyramid level 2 (default = 4).
+     *  @param  iterationsLevel1 The number of iterations at pyramid level 1 (default = 2).
+     *  @param  iterationsLevel0 The number of iterations at pyramid level 0 (default = 1).
+     */
+    void setOptimizationIterations(int iterationsLevel2, int iterationsLevel1, int iterationsLevel0);
+    
 private:
     int width;
     int height;
@@ -129,6 +184,9 @@ private:
     
     RenderingEngine *renderingEngine;
     OptimizationEngine *optimizationEngine;
+    
+    // whether the engine is the process-wide instance to be destroyed along with the estimator
+    bool sharedRenderingEngine;
 
     SignedDistanceTransform2D *SDT2D;
     
@@ -138,10 +196,24 @@ private:
     
     int tmp;
     
-    void relocalize(Object3D *object, std::vector<cv::Mat> &imagePyramid);
+    float relocalizationBudget;
+    
+    std::vector<RelocalizationState> relocalizationStates;
+    
+    RelocalizationWorker *relocalizationWorker;
+    
+    bool motionPrediction;
+    
+    std::vector<MotionModel*> motionModels;
+    
+    void relocalize(int objectIndex, std::vector<cv::Mat> &imagePyramid);
+    
+    bool relocalizationStep(Object3D *object, RelocalizationState &state, std::vector<cv::Mat> &imagePyramid, std::vector<cv::Mat> &binnedPyramid);
     
     cv::Rect computeBoundingBox(const std::vector<cv::Point3i> &centersIDs, int offset, int level, const cv::Size &maxSize);
     
+    void evaluateRefinedPoses(Object3D *object, RelocalizationState &state, std::vector<cv::Mat> &imagePyramid, std::vector<cv::Mat> &binnedPyramid);
+    
     float evaluateEnergyFunction(Object3D *object, const cv::Mat &binned, int level, int threads);
     
     float evaluateEnergyFunction(Object3D *object, const cv::Mat &mask, const cv::Mat &depth, const cv::Mat &binned, int level, int threads);
@@ -606,9 +678,11 @@ public:
 class Parallel_For_exhaustiveSearch: public Parallel_For_templateMatcher
 {
 private:
-    Object3D *object;
+    TCLCHistograms *tclcHistograms;
     std::vector<TemplateView*> templateViews;
     
+    cv::Point3f *offsetsData;
+    
     cv::Mat binned;
     cv::Mat prMap;
     
@@ -617,11 +691,14 @@ private:
     int diameter;
     
 public:
-    Parallel_For_exhaustiveSearch(Object3D *object, std::vector<TemplateView*> &templateViews, const cv::Mat &binned, const cv::Mat &prMap, int level, int step, int diameter)
+    Parallel_For_exhaustiveSearch(TCLCHistograms *tclcHistograms, std::vector<TemplateView*> &templateViews, std::vector<cv::Point3f> &offsets, const cv::Mat &binned, const cv::Mat &prMap, int level, int step, int diameter)
     {
-        this->object = object;
+        this->tclcHistograms = tclcHistograms;
         this->templateViews = templateViews;
         
+        offsets.resize(templateViews.size());
+        this->offsetsData = offsets.data();
+        
         this->binned = binned;
         this->prMap = prMap;
         
@@ -672,8 +749,6 @@ public:
     {
         for(int t = r.start; t < r.end; t++)
         {
-            TCLCHistograms *tclcHistograms = object->getTCLCHistograms();
-            
             int innerOffset = tclcHistograms->getRadius()/pow(2, level);
             
             TemplateView *tv = templateViews[t];
@@ -697,7 +772,7 @@ public:
             }
             else
             {
-                cv::Point3f offset = tv->getCurrentOffset(level);
+                cv::Point3f offset = offsetsData[t];
                 xStart = offset.x - diameter;
                 xEnd = offset.x + diameter+1;
                 yStart = offset.y - diameter;
@@ -740,8 +815,7 @@ public:
                 }
             }
             
-            cv::Point3f offset = cv::Point3f(finalX, finalY, minE);
-            tv->setCurrentOffset(offset, level);
+            offsetsData[t] = cv::Point3f(finalX, finalY, minE);
         }
     }
 };
@@ -756,10 +830,11 @@ public:
 class Parallel_For_neighborSearch: public Parallel_For_templateMatcher
 {
 private:
-    Object3D *object;
-    TemplateView *templateView;
+    TCLCHistograms *tclcHistograms;
     std::vector<TemplateView*> neighbors;
     
+    cv::Point3f *offsetsData;
+    
     cv::Mat binned;
     
     int offsetX0;
@@ -772,16 +847,18 @@ private:
     int levelDiff;
     
 public:
-    Parallel_For_neighborSearch(Object3D *object, TemplateView *templateView, const cv::Mat &binned, int level, int levelDiff)
+    Parallel_For_neighborSearch(TCLCHistograms *tclcHistograms, const TemplateMatch &match, std::vector<cv::Point3f> &offsets, const cv::Mat &binned, int level, int levelDiff)
     {
-        this->object = object;
-        this->templateView = templateView;
-        this->neighbors = templateView->getNeighborTemplates();
+        this->tclcHistograms = tclcHistograms;
+        this->neighbors = match.templateView->getNeighborTemplates();
+        
+        offsets.resize(neighbors.size());
+        this->offsetsData = offsets.data();
         
         this->binned = binned;
         
-        cv::Point3f offset0 = templateView->getCurrentOffset(level);
-        cv::Rect roi0 = templateView->getROI(level);
+        cv::Point3f offset0 = match.offset;
+        cv::Rect roi0 = match.templateView->getROI(level);
         
         this->offsetX0 = offset0.x*pow(2, levelDiff);
         this->offsetY0 = offset0.y*pow(2, levelDiff);
@@ -798,8 +875,6 @@ public:
     {
         for(int t = r.start; t < r.end; t++)
         {
-            TCLCHistograms *tclcHistograms = object->getTCLCHistograms();
-            
             TemplateView *neighbor = neighbors[t];
             cv::Rect roi = neighbor->getROI(level);
             cv::Mat heaviside = neighbor->getHeaviside(level);
@@ -815,9 +890,7 @@ public:
             
             float e = evaluateEnergyFunction(tclcHistograms, compressedPixelData, binned, roi, offsetX, offsetY);
             
-            cv::Point3f offset(offsetX, offsetY, e);
-            
-            neighbor->setCurrentOffset(offset, level);
+            offsetsData[t] = cv::Point3f(offsetX, offsetY, e);
         }
     }
 };
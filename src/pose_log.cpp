@@ -0,0 +1,329 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pose_log.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+using namespace std;
+using namespace cv;
+
+static const char poseLogMagic[8] = {'R', 'B', 'O', 'T', 'P', 'O', 'S', 'E'};
+
+static const uint32_t poseLogVersion = 1;
+
+PoseLogWriter::PoseLogWriter(const string &filename, const string &model, const string &sequence, int bufferSize)
+{
+    this->bufferSize = max(bufferSize, 1);
+    buffer.reserve(this->bufferSize);
+    
+    memset(&header, 0, sizeof(PoseLogHeader));
+    memcpy(header.magic, poseLogMagic, sizeof(poseLogMagic));
+    header.version = poseLogVersion;
+    header.headerSize = sizeof(PoseLogHeader);
+    header.recordSize = sizeof(PoseLogRecord);
+    header.numRecords = 0;
+    strncpy(header.model, model.c_str(), sizeof(header.model) - 1);
+    strncpy(header.sequence, sequence.c_str(), sizeof(header.sequence) - 1);
+    
+    startTicks = getTickCount();
+    
+    file = fopen(filename.c_str(), "wb");
+    if(file)
+    {
+        fwrite(&header, sizeof(PoseLogHeader), 1, file);
+    }
+}
+
+
+PoseLogWriter::~PoseLogWriter()
+{
+    close();
+}
+
+
+bool PoseLogWriter::isOpen()
+{
+    return file != NULL;
+}
+
+
+void PoseLogWriter::write(int frame, const Matx44f &pose, int status, double timestamp)
+{
+    if(!file)
+        return;
+    
+    PoseLogRecord record;
+    record.frame = frame;
+    record.status = status;
+    record.timestamp = (timestamp < 0) ? (getTickCount() - startTicks)/getTickFrequency() : timestamp;
+    
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            record.pose[i*3 + j] = pose(i, j);
+        }
+        record.pose[9 + i] = pose(i, 3);
+    }
+    
+    buffer.push_back(record);
+    
+    if(buffer.size() >= bufferSize)
+        flush();
+}
+
+
+void PoseLogWriter::flush()
+{
+    if(!file)
+        return;
+    
+    if(!buffer.empty())
+    {
+        fwrite(buffer.data(), sizeof(PoseLogRecord), buffer.size(), file);
+        header.numRecords += buffer.size();
+        buffer.clear();
+    }
+    
+    fflush(file);
+}
+
+
+void PoseLogWriter::close()
+{
+    if(!file)
+        return;
+    
+    flush();
+    
+    // update the number of records in the header to mark the log as complete
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(PoseLogHeader), 1, file);
+    
+    fclose(file);
+    file = NULL;
+}
+
+
+
+PoseLogReader::PoseLogReader(const string &filename) : file(QString::fromStdString(filename))
+{
+    data = NULL;
+    header = NULL;
+    numRecords = 0;
+    
+    if(!file.open(QIODevice::ReadOnly) || file.size() < (qint64)sizeof(PoseLogHeader))
+        return;
+    
+    data = file.map(0, file.size());
+    if(!data)
+        return;
+    
+    const PoseLogHeader *h = (const PoseLogHeader*)data;
+    if(memcmp(h->magic, poseLogMagic, sizeof(poseLogMagic)) != 0 || h->recordSize != sizeof(PoseLogRecord) || h->headerSize < sizeof(PoseLogHeader))
+    {
+        file.unmap(data);
+        data = NULL;
+        return;
+    }
+    
+    header = h;
+    
+    // a log whose writer did not finish still contains all complete records that were flushed
+    int available = (int)((file.size() - header->headerSize)/header->recordSize);
+    numRecords = (header->numRecords > 0) ? min((int)header->numRecords, available) : available;
+}
+
+
+PoseLogReader::~PoseLogReader()
+{
+    if(data)
+        file.unmap(data);
+    file.close();
+}
+
+
+bool PoseLogReader::isOpen()
+{
+    return header != NULL;
+}
+
+
+bool PoseLogReader::isPoseLog(const string &filename)
+{
+    ifstream file(filename.c_str(), ios::binary);
+    
+    char magic[8];
+    if(!file.read(magic, sizeof(magic)))
+        return false;
+    
+    return memcmp(magic, poseLogMagic, sizeof(poseLogMagic)) == 0;
+}
+
+
+int PoseLogReader::getNumRecords()
+{
+    return numRecords;
+}
+
+
+string PoseLogReader::getModel()
+{
+    return header ? string(header->model, strnlen(header->model, sizeof(header->model))) : string();
+}
+
+
+string PoseLogReader::getSequence()
+{
+    return header ? string(header->sequence, strnlen(header->sequence, sizeof(header->sequence))) : string();
+}
+
+
+const PoseLogRecord &PoseLogReader::getRecord(int i)
+{
+    return ((const PoseLogRecord*)(data + header->headerSize))[i];
+}
+
+
+Matx44f PoseLogReader::getPose(int i)
+{
+    const float *p = getRecord(i).pose;
+    
+    return Matx44f(p[0], p[1], p[2], p[9],
+                   p[3], p[4], p[5], p[10],
+                   p[6], p[7], p[8], p[11],
+                   0, 0, 0, 1);
+}
+
+
+
+bool convertPoseLogToText(const string &logFile, const string &textFile, bool withFrameIndex, bool rowMajor)
+{
+    PoseLogReader reader(logFile);
+    if(!reader.isOpen())
+        return false;
+    
+    ofstream file(textFile.c_str());
+    if(!file.is_open())
+        return false;
+    
+    file << fixed << setprecision(6);
+    
+    for(int i = 0; i < reader.getNumRecords(); i++)
+    {
+        const PoseLogRecord &record = reader.getRecord(i);
+        
+        if(withFrameIndex)
+            file << record.frame << "\t";
+        
+        if(rowMajor)
+        {
+            Matx44f pose = reader.getPose(i);
+            for(int j = 0; j < 12; j++)
+            {
+                file << pose.val[j] << "\t";
+            }
+        }
+        else
+        {
+            for(int j = 0; j < 12; j++)
+            {
+                file << record.pose[j] << "\t";
+            }
+        }
+        file << "\n";
+    }
+    
+    return true;
+}
+
+
+bool convertTextToPoseLog(const string &textFile, const string &logFile, const string &model, const string &sequence, bool withFrameIndex, bool rowMajor)
+{
+    ifstream file(textFile.c_str());
+    if(!file.is_open())
+        return false;
+    
+    PoseLogWriter writer(logFile, model, sequence);
+    if(!writer.isOpen())
+        return false;
+    
+    int frame = 0;
+    
+    string line;
+    while(getline(file, line))
+    {
+        istringstream iss(line);
+        
+        if(withFrameIndex && !(iss >> frame))
+            continue;
+        
+        float vals[12];
+        int n = 0;
+        while(n < 12 && iss >> vals[n])
+            n++;
+        if(n < 12)
+            continue;
+        
+        Matx44f pose;
+        if(rowMajor)
+        {
+            pose = Matx44f(vals[0], vals[1], vals[2], vals[3],
+                           vals[4], vals[5], vals[6], vals[7],
+                           vals[8], vals[9], vals[10], vals[11],
+                           0, 0, 0, 1);
+        }
+        else
+        {
+            pose = Matx44f(vals[0], vals[1], vals[2], vals[9],
+                           vals[3], vals[4], vals[5], vals[10],
+                           vals[6], vals[7], vals[8], vals[11],
+                           0, 0, 0, 1);
+        }
+        
+        writer.write(frame, pose, PoseLogRecord::TRACKING, 0);
+        frame++;
+    }
+    
+    writer.close();
+    
+    return true;
+}
@@ -0,0 +1,250 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef POSE_LOG_H
+#define POSE_LOG_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QFile>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  The fixed size header at the beginning of every binary pose log. All
+ *  values are stored in the byte order of the writing machine.
+ */
+struct PoseLogHeader
+{
+    // "RBOTPOSE"
+    char magic[8];
+    
+    uint32_t version;
+    
+    // the size of the header and of each record in bytes, for forward compatibility
+    uint32_t headerSize;
+    uint32_t recordSize;
+    
+    uint32_t reserved;
+    
+    // the number of records, which is written when the log is closed and 0 if the writer did not finish
+    uint64_t numRecords;
+    
+    // the model file and sequence name as zero terminated strings
+    char model[256];
+    char sequence[256];
+};
+
+
+/**
+ *  A single pose of the log (64 bytes).
+ */
+struct PoseLogRecord
+{
+    enum Status
+    {
+        LOST = 0,
+        TRACKING = 1,
+        REINITIALIZED = 2
+    };
+    
+    int32_t frame;
+    
+    uint32_t status;
+    
+    // in seconds since the log was opened
+    double timestamp;
+    
+    // the rotation row by row followed by the translation, as in the text format of the RBOT dataset
+    float pose[12];
+};
+
+
+/**
+ *  This class writes a binary pose log. Records are collected in memory and
+ *  written to the file in blocks, so that logging a pose per frame does not
+ *  cause a file access per frame.
+ */
+class PoseLogWriter
+{
+public:
+    /**
+     *  Constructor creating a new pose log, replacing an existing file.
+     *
+     *  @param  filename The path of the pose log file.
+     *  @param  model The model file of the tracked object stored in the header.
+     *  @param  sequence A name of the sequence stored in the header.
+     *  @param  bufferSize The number of records that are buffered before being written to the file.
+     */
+    PoseLogWriter(const std::string &filename, const std::string &model = "", const std::string &sequence = "", int bufferSize = 1024);
+    
+    ~PoseLogWriter();
+    
+    /**
+     *  Tells whether the file could be created.
+     *
+     *  @return True if the log is open and false otherwise.
+     */
+    bool isOpen();
+    
+    /**
+     *  Appends a pose to the log.
+     *
+     *  @param  frame The index of the frame.
+     *  @param  pose The pose of the object.
+     *  @param  status The tracking status (see PoseLogRecord::Status).
+     *  @param  timestamp The time in seconds or a negative value to use the time since the log was opened.
+     */
+    void write(int frame, const cv::Matx44f &pose, int status = PoseLogRecord::TRACKING, double timestamp = -1.0);
+    
+    /**
+     *  Writes all buffered records to the file.
+     */
+    void flush();
+    
+    /**
+     *  Writes all buffered records and the final number of records and closes the file.
+     */
+    void close();
+    
+private:
+    FILE *file;
+    
+    PoseLogHeader header;
+    
+    std::vector<PoseLogRecord> buffer;
+    
+    int bufferSize;
+    
+    int64 startTicks;
+};
+
+
+/**
+ *  This class reads a binary pose log by mapping the file into memory, so
+ *  that the records can be accessed directly without parsing or copying.
+ */
+class PoseLogReader
+{
+public:
+    /**
+     *  Constructor mapping a pose log file into memory.
+     *
+     *  @param  filename The path of the pose log file.
+     */
+    PoseLogReader(const std::string &filename);
+    
+    ~PoseLogReader();
+    
+    /**
+     *  Tells whether the file is a valid pose log that could be mapped.
+     *
+     *  @return True if the log is open and false otherwise.
+     */
+    bool isOpen();
+    
+    /**
+     *  Checks whether a file starts with the pose log magic number.
+     *
+     *  @param  filename The path of the file.
+     *  @return True if the file is a binary pose log and false otherwise.
+     */
+    static bool isPoseLog(const std::string &filename);
+    
+    int getNumRecords();
+    
+    std::string getModel();
+    
+    std::string getSequence();
+    
+    /**
+     *  Returns a record of the log, which is valid as long as the reader exists.
+     *
+     *  @param  i The index of the record.
+     *  @return The record.
+     */
+    const PoseLogRecord &getRecord(int i);
+    
+    /**
+     *  Returns the pose of a record of the log as a 4x4 matrix.
+     *
+     *  @param  i The index of the record.
+     *  @return The pose.
+     */
+    cv::Matx44f getPose(int i);
+    
+private:
+    QFile file;
+    
+    uchar *data;
+    
+    const PoseLogHeader *header;
+    
+    int numRecords;
+};
+
+
+/**
+ *  Converts a binary pose log into the text format of the RBOT dataset, i.e.
+ *  one line with the 9 rotation and 3 translation values per record.
+ *
+ *  @param  logFile The path of the binary pose log.
+ *  @param  textFile The path of the text file to be written.
+ *  @param  withFrameIndex Whether each line starts with the frame index.
+ *  @param  rowMajor Whether to write the first three rows of the 4x4 pose matrix instead of the RBOT order.
+ *  @return True if the conversion succeeded and false otherwise.
+ */
+bool convertPoseLogToText(const std::string &logFile, const std::string &textFile, bool withFrameIndex = false, bool rowMajor = false);
+
+/**
+ *  Converts poses in the text format of the RBOT dataset into a binary pose
+ *  log. The frames are either read from the first column or numbered consecutively.
+ *
+ *  @param  textFile The path of the text file.
+ *  @param  logFile The path of the binary pose log to be written.
+ *  @param  model The model file stored in the header.
+ *  @param  sequence The sequence name stored in the header.
+ *  @param  withFrameIndex Whether each line starts with the frame index.
+ *  @param  rowMajor Whether the lines hold the first three rows of the 4x4 pose matrix instead of the RBOT order.
+ *  @return True if the conversion succeeded and false otherwise.
+ */
+bool convertTextToPoseLog(const std::string &textFile, const std::string &logFile, const std::string &model = "", const std::string &sequence = "", bool withFrameIndex = false, bool rowMajor = false);
+
+#endif /* POSE_LOG_H */
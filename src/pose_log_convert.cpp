@@ -0,0 +1,133 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pose_log.h"
+
+using namespace std;
+
+static void printUsage()
+{
+    cout << "Usage: pose_log_convert [options] <input> <output>" << endl
+         << "  Converts a binary pose log (.rpl) into the text format of the RBOT dataset or vice versa," << endl
+         << "  depending on the format of the input file." << endl
+         << "  --frames          each line of the text starts with the frame index" << endl
+         << "  --row_major       the text holds the first three rows of the pose matrix instead of the RBOT order" << endl
+         << "  --model=<file>    the model file stored in the header of a new pose log" << endl
+         << "  --sequence=<name> the sequence name stored in the header of a new pose log" << endl
+         << "  --info            only print the header and number of records of a pose log" << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+    bool withFrameIndex = false;
+    bool rowMajor = false;
+    bool info = false;
+    string model, sequence;
+    vector<string> files;
+    
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        
+        if(arg == "--frames")
+            withFrameIndex = true;
+        else if(arg == "--row_major")
+            rowMajor = true;
+        else if(arg == "--info")
+            info = true;
+        else if(arg.compare(0, 8, "--model=") == 0)
+            model = arg.substr(8);
+        else if(arg.compare(0, 11, "--sequence=") == 0)
+            sequence = arg.substr(11);
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            printUsage();
+            return arg == "--help" ? 0 : -1;
+        }
+        else
+            files.push_back(arg);
+    }
+    
+    if(info && files.size() == 1)
+    {
+        PoseLogReader reader(files[0]);
+        if(!reader.isOpen())
+        {
+            cerr << "Not a pose log: " << files[0] << endl;
+            return -1;
+        }
+        
+        int lost = 0;
+        for(int i = 0; i < reader.getNumRecords(); i++)
+        {
+            if(reader.getRecord(i).status == PoseLogRecord::LOST)
+                lost++;
+        }
+        
+        cout << "Model:    " << reader.getModel() << endl
+             << "Sequence: " << reader.getSequence() << endl
+             << "Records:  " << reader.getNumRecords() << endl
+             << "Lost:     " << lost << endl;
+        
+        return 0;
+    }
+    
+    if(files.size() != 2)
+    {
+        printUsage();
+        return -1;
+    }
+    
+    bool success;
+    if(PoseLogReader::isPoseLog(files[0]))
+        success = convertPoseLogToText(files[0], files[1], withFrameIndex, rowMajor);
+    else
+        success = convertTextToPoseLog(files[0], files[1], model, sequence, withFrameIndex, rowMajor);
+    
+    if(!success)
+    {
+        cerr << "Failed to convert " << files[0] << " into " << files[1] << endl;
+        return -1;
+    }
+    
+    return 0;
+}
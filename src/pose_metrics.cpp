@@ -0,0 +1,257 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pose_metrics.h"
+#include "convex_hull.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+using namespace cv;
+
+// the maximum number of points within a leaf of the k-d tree that are searched linearly
+static const int kdTreeLeafSize = 8;
+
+PoseMetrics::PoseMetrics(const vector<Vec3f> &points)
+{
+    treePoints = points;
+    splitAxes.resize(points.size(), 0);
+    
+    buildTree(0, (int)treePoints.size());
+    
+    diameter = computeDiameter(points);
+}
+
+
+float PoseMetrics::getDiameter() const
+{
+    return diameter;
+}
+
+
+int PoseMetrics::getNumPoints() const
+{
+    return (int)treePoints.size();
+}
+
+
+float PoseMetrics::computeADD(const Matx44f &T_gt, const Matx44f &T_pred) const
+{
+    if(treePoints.empty())
+        return 0;
+    
+    // (R_gt*p + t_gt) - (R_pred*p + t_pred) = dR*p + dt
+    Matx44f dT = T_gt - T_pred;
+    
+    double sum = 0;
+    
+    for(int i = 0; i < treePoints.size(); i++)
+    {
+        const Vec3f &p = treePoints[i];
+        
+        float dx = dT(0, 0)*p[0] + dT(0, 1)*p[1] + dT(0, 2)*p[2] + dT(0, 3);
+        float dy = dT(1, 0)*p[0] + dT(1, 1)*p[1] + dT(1, 2)*p[2] + dT(1, 3);
+        float dz = dT(2, 0)*p[0] + dT(2, 1)*p[1] + dT(2, 2)*p[2] + dT(2, 3);
+        
+        sum += sqrtf(dx*dx + dy*dy + dz*dz);
+    }
+    
+    return (float)(sum/treePoints.size());
+}
+
+
+float PoseMetrics::computeADDS(const Matx44f &T_gt, const Matx44f &T_pred) const
+{
+    if(treePoints.empty())
+        return 0;
+    
+    // the closest point to T_gt*p within T_pred*M has the same distance as the closest point to T_pred^-1*T_gt*p within M,
+    // so that the tree of the untransformed model can be used for all poses
+    Matx33f R_pred = T_pred.get_minor<3, 3>(0, 0);
+    Vec3f t_pred(T_pred(0, 3), T_pred(1, 3), T_pred(2, 3));
+    
+    Matx33f R_gt = T_gt.get_minor<3, 3>(0, 0);
+    Vec3f t_gt(T_gt(0, 3), T_gt(1, 3), T_gt(2, 3));
+    
+    Matx33f R = R_pred.t()*R_gt;
+    Vec3f t = R_pred.t()*(t_gt - t_pred);
+    
+    double sum = 0;
+    
+    for(int i = 0; i < treePoints.size(); i++)
+    {
+        Vec3f q = R*treePoints[i] + t;
+        
+        float minDistSq = numeric_limits<float>::max();
+        nearestNeighbor(q, 0, (int)treePoints.size(), minDistSq);
+        
+        sum += sqrtf(minDistSq);
+    }
+    
+    return (float)(sum/treePoints.size());
+}
+
+
+float PoseMetrics::rotationError(const Matx44f &T_gt, const Matx44f &T_pred)
+{
+    Matx33f R_gt = T_gt.get_minor<3, 3>(0, 0);
+    Matx33f R_pred = T_pred.get_minor<3, 3>(0, 0);
+    
+    Matx33f R_diff = R_pred.t()*R_gt;
+    
+    float c = (R_diff(0, 0) + R_diff(1, 1) + R_diff(2, 2) - 1.0f)/2.0f;
+    c = min(1.0f, max(-1.0f, c));
+    
+    return acosf(c)*180.0f/CV_PI;
+}
+
+
+float PoseMetrics::translationError(const Matx44f &T_gt, const Matx44f &T_pred)
+{
+    Vec3f t_gt(T_gt(0, 3), T_gt(1, 3), T_gt(2, 3));
+    Vec3f t_pred(T_pred(0, 3), T_pred(1, 3), T_pred(2, 3));
+    
+    return (float)norm(t_gt - t_pred);
+}
+
+
+void PoseMetrics::buildTree(int begin, int end)
+{
+    if(end - begin <= kdTreeLeafSize)
+        return;
+    
+    // split along the axis of the largest extent
+    Vec3f lbn = treePoints[begin];
+    Vec3f rtf = treePoints[begin];
+    for(int i = begin + 1; i < end; i++)
+    {
+        const Vec3f &p = treePoints[i];
+        for(int k = 0; k < 3; k++)
+        {
+            lbn[k] = min(lbn[k], p[k]);
+            rtf[k] = max(rtf[k], p[k]);
+        }
+    }
+    
+    Vec3f extent = rtf - lbn;
+    int axis = 0;
+    if(extent[1] > extent[axis]) axis = 1;
+    if(extent[2] > extent[axis]) axis = 2;
+    
+    int mid = (begin + end)/2;
+    
+    nth_element(treePoints.begin() + begin, treePoints.begin() + mid, treePoints.begin() + end, [axis](const Vec3f &a, const Vec3f &b)
+    {
+        return a[axis] < b[axis];
+    });
+    
+    splitAxes[mid] = (uchar)axis;
+    
+    buildTree(begin, mid);
+    buildTree(mid + 1, end);
+}
+
+
+void PoseMetrics::nearestNeighbor(const Vec3f &q, int begin, int end, float &minDistSq) const
+{
+    if(end - begin <= kdTreeLeafSize)
+    {
+        for(int i = begin; i < end; i++)
+        {
+            Vec3f d = treePoints[i] - q;
+            float distSq = d.dot(d);
+            if(distSq < minDistSq)
+                minDistSq = distSq;
+        }
+        return;
+    }
+    
+    int mid = (begin + end)/2;
+    int axis = splitAxes[mid];
+    
+    Vec3f d = treePoints[mid] - q;
+    float distSq = d.dot(d);
+    if(distSq < minDistSq)
+        minDistSq = distSq;
+    
+    float delta = q[axis] - treePoints[mid][axis];
+    
+    // descend into the half containing the query first and only visit the other one if it can contain a closer point
+    if(delta < 0)
+    {
+        nearestNeighbor(q, begin, mid, minDistSq);
+        if(delta*delta < minDistSq)
+            nearestNeighbor(q, mid + 1, end, minDistSq);
+    }
+    else
+    {
+        nearestNeighbor(q, mid + 1, end, minDistSq);
+        if(delta*delta < minDistSq)
+            nearestNeighbor(q, begin, mid, minDistSq);
+    }
+}
+
+
+float PoseMetrics::computeDiameter(const vector<Vec3f> &points)
+{
+    // the two points furthest apart are always vertices of the convex hull,
+    // so only the pairs of hull vertices have to be compared
+    ConvexHull convexHull(points);
+    vector<int> hullIDs = convexHull.getVertexIDs();
+    
+    vector<Vec3f> hullVertices;
+    for(int i = 0; i < hullIDs.size(); i++)
+    {
+        hullVertices.push_back(points[hullIDs[i]]);
+    }
+    
+    float maxDistSq = 0;
+    
+    for(int i = 0; i < hullVertices.size(); i++)
+    {
+        for(int j = i + 1; j < hullVertices.size(); j++)
+        {
+            Vec3f d = hullVertices[i] - hullVertices[j];
+            float distSq = d.dot(d);
+            if(distSq > maxDistSq)
+                maxDistSq = distSq;
+        }
+    }
+    
+    return sqrtf(maxDistSq);
+}
@@ -0,0 +1,200 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef POSE_METRICS_H
+#define POSE_METRICS_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  This class evaluates estimated 6DOF poses of a model against ground truth
+ *  poses. It computes the diameter of the model from the vertices of its
+ *  convex hull and organizes the model points in a k-d tree, so that the
+ *  closest point distances needed for ADD-S (the average distance for
+ *  symmetric objects) can be found in logarithmic time per point. All methods
+ *  are const after construction and can be called from multiple threads.
+ */
+class PoseMetrics
+{
+public:
+    /**
+     *  Constructor computing the diameter and the k-d tree of a model.
+     *
+     *  @param  points The 3D points of the model, e.g. its vertices.
+     */
+    PoseMetrics(const std::vector<cv::Vec3f> &points);
+    
+    /**
+     *  Returns the diameter of the model, i.e. the largest distance between
+     *  any two of its points.
+     *
+     *  @return The diameter of the model.
+     */
+    float getDiameter() const;
+    
+    /**
+     *  Returns the number of model points the metrics are averaged over.
+     *
+     *  @return The number of model points.
+     */
+    int getNumPoints() const;
+    
+    /**
+     *  Computes the ADD error, i.e. the average distance between each model
+     *  point transformed by the ground truth pose and the same point
+     *  transformed by the estimated pose.
+     *
+     *  @param  T_gt The ground truth pose.
+     *  @param  T_pred The estimated pose.
+     *  @return The ADD error in model units.
+     */
+    float computeADD(const cv::Matx44f &T_gt, const cv::Matx44f &T_pred) const;
+    
+    /**
+     *  Computes the ADD-S error, i.e. the average distance between each model
+     *  point transformed by the ground truth pose and the closest model point
+     *  transformed by the estimated pose.
+     *
+     *  @param  T_gt The ground truth pose.
+     *  @param  T_pred The estimated pose.
+     *  @return The ADD-S error in model units.
+     */
+    float computeADDS(const cv::Matx44f &T_gt, const cv::Matx44f &T_pred) const;
+    
+    /**
+     *  Computes the angle of the relative rotation between two poses.
+     *
+     *  @param  T_gt The ground truth pose.
+     *  @param  T_pred The estimated pose.
+     *  @return The rotation error in degrees.
+     */
+    static float rotationError(const cv::Matx44f &T_gt, const cv::Matx44f &T_pred);
+    
+    /**
+     *  Computes the distance between the translations of two poses.
+     *
+     *  @param  T_gt The ground truth pose.
+     *  @param  T_pred The estimated pose.
+     *  @return The translation error in model units.
+     */
+    static float translationError(const cv::Matx44f &T_gt, const cv::Matx44f &T_pred);
+    
+private:
+    // the model points reordered such that every subrange is a node of the k-d tree split at its middle element
+    std::vector<cv::Vec3f> treePoints;
+    
+    // the split axis of the node whose middle element is stored at the same index
+    std::vector<uchar> splitAxes;
+    
+    float diameter;
+    
+    void buildTree(int begin, int end);
+    
+    void nearestNeighbor(const cv::Vec3f &q, int begin, int end, float &minDistSq) const;
+    
+    static float computeDiameter(const std::vector<cv::Vec3f> &points);
+};
+
+
+/**
+ *  The evaluation result of a single frame.
+ */
+struct PoseErrors
+{
+    float add;
+    
+    float adds;
+    
+    // in degrees
+    float rotation;
+    
+    float translation;
+};
+
+
+class Parallel_For_evaluatePoses: public cv::ParallelLoopBody
+{
+private:
+    const PoseMetrics *poseMetrics;
+    
+    const cv::Matx44f *gtPoses;
+    const cv::Matx44f *predPoses;
+    
+    PoseErrors *errors;
+    
+    int numPoses;
+    
+    int threads;
+    
+public:
+    Parallel_For_evaluatePoses(const PoseMetrics *poseMetrics, const std::vector<cv::Matx44f> &gtPoses, const std::vector<cv::Matx44f> &predPoses, std::vector<PoseErrors> &errors, int threads)
+    {
+        this->poseMetrics = poseMetrics;
+        
+        this->gtPoses = gtPoses.data();
+        this->predPoses = predPoses.data();
+        
+        numPoses = (int)std::min(gtPoses.size(), predPoses.size());
+        
+        errors.resize(numPoses);
+        this->errors = errors.data();
+        
+        this->threads = threads;
+    }
+    
+    virtual void operator()( const cv::Range &r ) const
+    {
+        int range = numPoses/threads;
+        
+        int iBegin = r.start*range;
+        int iEnd = (r.end == threads) ? numPoses : r.end*range;
+        
+        for(int i = iBegin; i < iEnd; i++)
+        {
+            PoseErrors &e = errors[i];
+            
+            e.add = poseMetrics->computeADD(gtPoses[i], predPoses[i]);
+            e.adds = poseMetrics->computeADDS(gtPoses[i], predPoses[i]);
+            e.rotation = PoseMetrics::rotationError(gtPoses[i], predPoses[i]);
+            e.translation = PoseMetrics::translationError(gtPoses[i], predPoses[i]);
+        }
+    }
+};
+
+#endif /* POSE_METRICS_H */
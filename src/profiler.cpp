@@ -0,0 +1,315 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <set>
+
+#include <QThread>
+
+using namespace std;
+using namespace cv;
+
+Profiler* Profiler::instance;
+
+
+// escapes a string for being written as a JSON string
+static string escapeJSON(const string &s)
+{
+    string res;
+    for(int i = 0; i < s.size(); i++)
+    {
+        if(s[i] == '"' || s[i] == '\\')
+            res.push_back('\\');
+        res.push_back(s[i]);
+    }
+    return res;
+}
+
+
+Profiler::Profiler()
+{
+    startTicks = getTickCount();
+    
+    traceEnabled = false;
+    maxTraceEvents = 1000000;
+}
+
+
+Profiler::~Profiler()
+{
+    frames.clear();
+    events.clear();
+}
+
+
+void Profiler::destroy()
+{
+    delete instance;
+    instance = NULL;
+}
+
+
+void Profiler::beginFrame()
+{
+    QMutexLocker locker(&mutex);
+    
+    ProfileFrame frame;
+    frame.frame = (int)frames.size();
+    frames.push_back(frame);
+}
+
+
+ProfileFrame& Profiler::currentFrame()
+{
+    // measurements taken before the first frame started are collected in a frame of their own
+    if(frames.empty())
+    {
+        ProfileFrame frame;
+        frame.frame = 0;
+        frames.push_back(frame);
+    }
+    return frames.back();
+}
+
+
+int Profiler::currentThreadID()
+{
+    quintptr handle = (quintptr)QThread::currentThreadId();
+    
+    map<quintptr, int>::iterator it = threadIDs.find(handle);
+    if(it != threadIDs.end())
+        return it->second;
+    
+    int id = (int)threadIDs.size();
+    threadIDs[handle] = id;
+    
+    return id;
+}
+
+
+void Profiler::addTime(const string &name, int64 startTicks, int64 endTicks)
+{
+    double ticksPerMicrosecond = getTickFrequency()*1e-6;
+    
+    QMutexLocker locker(&mutex);
+    
+    double duration = (endTicks - startTicks)/ticksPerMicrosecond;
+    
+    currentFrame().times[name] += duration*1e-3;
+    
+    if(traceEnabled)
+    {
+        ProfileEvent event;
+        event.name = name;
+        event.thread = currentThreadID();
+        event.start = (startTicks - this->startTicks)/ticksPerMicrosecond;
+        event.duration = duration;
+        
+        events.push_back(event);
+        
+        // long runs keep a bounded window of the most recent events
+        while((int)events.size() > maxTraceEvents)
+        {
+            events.pop_front();
+        }
+    }
+}
+
+
+void Profiler::addCount(const string &name, double value)
+{
+    QMutexLocker locker(&mutex);
+    
+    currentFrame().counts[name] += value;
+}
+
+
+void Profiler::setTraceEnabled(bool enabled)
+{
+    QMutexLocker locker(&mutex);
+    
+    traceEnabled = enabled;
+}
+
+
+void Profiler::setMaxTraceEvents(int maxEvents)
+{
+    QMutexLocker locker(&mutex);
+    
+    maxTraceEvents = std::max(maxEvents, 1);
+    
+    while((int)events.size() > maxTraceEvents)
+    {
+        events.pop_front();
+    }
+}
+
+
+void Profiler::clear()
+{
+    QMutexLocker locker(&mutex);
+    
+    frames.clear();
+    events.clear();
+}
+
+
+vector<ProfileFrame> Profiler::getFrames()
+{
+    QMutexLocker locker(&mutex);
+    
+    return frames;
+}
+
+
+vector<string> Profiler::collectNames(bool counts)
+{
+    set<string> names;
+    for(int f = 0; f < frames.size(); f++)
+    {
+        const map<string, double> &values = counts ? frames[f].counts : frames[f].times;
+        for(map<string, double>::const_iterator it = values.begin(); it != values.end(); it++)
+        {
+            names.insert(it->first);
+        }
+    }
+    return vector<string>(names.begin(), names.end());
+}
+
+
+bool Profiler::exportCSV(const string &filename)
+{
+    QMutexLocker locker(&mutex);
+    
+    ofstream file(filename.c_str());
+    if(!file.is_open())
+        return false;
+    
+    vector<string> timeNames = collectNames(false);
+    vector<string> countNames = collectNames(true);
+    
+    file << "frame";
+    for(int i = 0; i < timeNames.size(); i++)
+    {
+        file << "," << timeNames[i] << "_ms";
+    }
+    for(int i = 0; i < countNames.size(); i++)
+    {
+        file << "," << countNames[i];
+    }
+    file << "\n";
+    
+    file << fixed << setprecision(4);
+    for(int f = 0; f < frames.size(); f++)
+    {
+        file << frames[f].frame;
+        for(int i = 0; i < timeNames.size(); i++)
+        {
+            map<string, double>::const_iterator it = frames[f].times.find(timeNames[i]);
+            file << "," << (it != frames[f].times.end() ? it->second : 0.0);
+        }
+        for(int i = 0; i < countNames.size(); i++)
+        {
+            map<string, double>::const_iterator it = frames[f].counts.find(countNames[i]);
+            file << "," << (it != frames[f].counts.end() ? it->second : 0.0);
+        }
+        file << "\n";
+    }
+    
+    return file.good();
+}
+
+
+bool Profiler::exportJSON(const string &filename)
+{
+    QMutexLocker locker(&mutex);
+    
+    ofstream file(filename.c_str());
+    if(!file.is_open())
+        return false;
+    
+    file << fixed << setprecision(4);
+    file << "[\n";
+    for(int f = 0; f < frames.size(); f++)
+    {
+        file << "  {\"frame\": " << frames[f].frame << ", \"times\": {";
+        
+        for(map<string, double>::const_iterator it = frames[f].times.begin(); it != frames[f].times.end(); it++)
+        {
+            file << (it == frames[f].times.begin() ? "" : ", ") << "\"" << escapeJSON(it->first) << "\": " << it->second;
+        }
+        
+        file << "}, \"counts\": {";
+        
+        for(map<string, double>::const_iterator it = frames[f].counts.begin(); it != frames[f].counts.end(); it++)
+        {
+            file << (it == frames[f].counts.begin() ? "" : ", ") << "\"" << escapeJSON(it->first) << "\": " << it->second;
+        }
+        
+        file << "}}" << (f + 1 < frames.size() ? "," : "") << "\n";
+    }
+    file << "]\n";
+    
+    return file.good();
+}
+
+
+bool Profiler::exportChromeTrace(const string &filename)
+{
+    QMutexLocker locker(&mutex);
+    
+    ofstream file(filename.c_str());
+    if(!file.is_open())
+        return false;
+    
+    file << fixed << setprecision(3);
+    file << "{\"traceEvents\": [\n";
+    for(int i = 0; i < events.size(); i++)
+    {
+        const ProfileEvent &event = events[i];
+        
+        // complete events with timestamps in microseconds
+        file << "  {\"name\": \"" << escapeJSON(event.name) << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << event.thread
+             << ", \"ts\": " << event.start << ", \"dur\": " << event.duration << "}" << (i + 1 < events.size() ? "," : "") << "\n";
+    }
+    file << "], \"displayTimeUnit\": \"ms\"}\n";
+    
+    return file.good();
+}
@@ -0,0 +1,258 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <vector>
+#include <map>
+#include <deque>
+#include <string>
+
+#include <QMutex>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  The instrumentation macros used within the tracking pipeline. They are only
+ *  compiled if RBOT_ENABLE_PROFILING is defined (see the CMake option of the same
+ *  name) and expand to nothing otherwise, so that their arguments are not even
+ *  evaluated in regular builds.
+ *
+ *  RBOT_PROFILE_FRAME() starts a new per-frame record.
+ *  RBOT_PROFILE_SCOPE(name) measures the time until the end of the enclosing scope.
+ *  RBOT_PROFILE_COUNT(name, value) adds a value to a counter of the current frame.
+ */
+#ifdef RBOT_ENABLE_PROFILING
+#define RBOT_PROFILE_CONCAT_IMPL(a, b) a##b
+#define RBOT_PROFILE_CONCAT(a, b) RBOT_PROFILE_CONCAT_IMPL(a, b)
+#define RBOT_PROFILE_FRAME() Profiler::Instance()->beginFrame()
+#define RBOT_PROFILE_SCOPE(name) ProfileScope RBOT_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define RBOT_PROFILE_COUNT(name, value) Profiler::Instance()->addCount(name, value)
+#else
+#define RBOT_PROFILE_FRAME()
+#define RBOT_PROFILE_SCOPE(name)
+#define RBOT_PROFILE_COUNT(name, value)
+#endif
+
+/**
+ *  The measurements of a single frame, i.e. the accumulated time in
+ *  milliseconds spent in every instrumented stage and the accumulated
+ *  values of all counters (e.g. iterations per pyramid level, pixels
+ *  within the contour band or 2D ROI areas).
+ */
+struct ProfileFrame
+{
+    int frame;
+    
+    std::map<std::string, double> times;
+    std::map<std::string, double> counts;
+};
+
+/**
+ *  A single timed scope in the format of the Chrome trace event viewer
+ *  (chrome://tracing), with start and duration in microseconds relative
+ *  to the creation of the profiler.
+ */
+struct ProfileEvent
+{
+    std::string name;
+    
+    int thread;
+    
+    double start;
+    double duration;
+};
+
+/**
+ *  A singleton collecting the timings and counters of the instrumented parts of
+ *  the tracking pipeline into per-frame records and a trace of all timed scopes.
+ *  Measurements may be added from any thread and are assigned to the frame that is
+ *  currently in progress. The records can be exported as CSV or JSON and the
+ *  trace as a Chrome trace file.
+ */
+class Profiler
+{
+public:
+    static Profiler *Instance(void)
+    {
+        if (instance == NULL) instance = new Profiler();
+        return instance;
+    }
+    
+    /**
+     *  Deletes the profiler instance.
+     */
+    static void destroy();
+    
+    /**
+     *  Starts a new per-frame record, to which all subsequent
+     *  measurements will be added.
+     */
+    void beginFrame();
+    
+    /**
+     *  Adds the time between two tick counts (see cv::getTickCount()) to a stage
+     *  of the current frame and to the trace.
+     *
+     *  @param  name The name of the stage.
+     *  @param  startTicks The tick count at the beginning of the stage.
+     *  @param  endTicks The tick count at the end of the stage.
+     */
+    void addTime(const std::string &name, int64 startTicks, int64 endTicks);
+    
+    /**
+     *  Adds a value to a counter of the current frame.
+     *
+     *  @param  name The name of the counter.
+     *  @param  value The value to be added.
+     */
+    void addCount(const std::string &name, double value);
+    
+    /**
+     *  Enables or disables recording the trace of individual scopes in addition
+     *  to the per-frame records (disabled by default). Only the most recent
+     *  events are kept (see setMaxTraceEvents()).
+     *
+     *  @param  enabled Whether the trace is recorded.
+     */
+    void setTraceEnabled(bool enabled);
+    
+    /**
+     *  Sets the number of trace events kept, beyond which the oldest
+     *  events are dropped (default = 1000000).
+     *
+     *  @param  maxEvents The maximum number of trace events.
+     */
+    void setMaxTraceEvents(int maxEvents);
+    
+    /**
+     *  Discards all recorded frames and trace events.
+     */
+    void clear();
+    
+    /**
+     *  Returns a copy of all recorded per-frame records.
+     *
+     *  @return  The per-frame records.
+     */
+    std::vector<ProfileFrame> getFrames();
+    
+    /**
+     *  Writes the per-frame records into a CSV file with one row per frame and
+     *  one column per stage (in ms) and counter. Values missing in a frame are 0.
+     *
+     *  @param  filename The path of the CSV file.
+     *
+     *  @return  True if the file was written and false otherwise.
+     */
+    bool exportCSV(const std::string &filename);
+    
+    /**
+     *  Writes the per-frame records into a JSON file as an array of objects
+     *  with the members "frame", "times" and "counts".
+     *
+     *  @param  filename The path of the JSON file.
+     *
+     *  @return  True if the file was written and false otherwise.
+     */
+    bool exportJSON(const std::string &filename);
+    
+    /**
+     *  Writes the trace of all timed scopes into a file that can be loaded
+     *  in chrome://tracing or similar trace viewers.
+     *
+     *  @param  filename The path of the trace file.
+     *
+     *  @return  True if the file was written and false otherwise.
+     */
+    bool exportChromeTrace(const std::string &filename);
+    
+private:
+    Profiler();
+    
+    ~Profiler();
+    
+    static Profiler *instance;
+    
+    QMutex mutex;
+    
+    int64 startTicks;
+    
+    bool traceEnabled;
+    int maxTraceEvents;
+    
+    std::vector<ProfileFrame> frames;
+    std::deque<ProfileEvent> events;
+    
+    // small sequential identifiers of all threads that added measurements
+    std::map<quintptr, int> threadIDs;
+    
+    ProfileFrame& currentFrame();
+    
+    int currentThreadID();
+    
+    std::vector<std::string> collectNames(bool counts);
+};
+
+
+/**
+ *  Measures the time between its construction and destruction and adds it to a
+ *  stage of the profiler. Meant to be used via RBOT_PROFILE_SCOPE(name).
+ */
+class ProfileScope
+{
+public:
+    ProfileScope(const char *name)
+    {
+        this->name = name;
+        startTicks = cv::getTickCount();
+    }
+    
+    ~ProfileScope()
+    {
+        Profiler::Instance()->addTime(name, startTicks, cv::getTickCount());
+    }
+    
+private:
+    const char *name;
+    
+    int64 startTicks;
+};
+
+#endif /* PROFILER_H */
@@ -0,0 +1,560 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <QApplication>
+#include <QDir>
+#include <QFileInfo>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "object3d.h"
+#include "pose_estimator6d.h"
+#include "profiler.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ *  The benchmark configuration read from a YAML file (see data/bench.yml).
+ */
+struct BenchConfig
+{
+    string model;
+    float scale;
+    float qualityThreshold;
+    vector<float> templateDistances;
+    
+    int width;
+    int height;
+    Matx33f K;
+    Matx14f distCoeffs;
+    float zNear;
+    float zFar;
+    
+    string gtPoses;
+    
+    string frames;
+    int firstFrame;
+    int numFrames;
+    
+    bool synthetic;
+    string syntheticBackground;
+    Point3f syntheticColor;
+    float syntheticNoise;
+    
+    int warmupFrames;
+    bool resetOnFailure;
+    
+    string outputCSV;
+    string outputTrace;
+};
+
+
+/**
+ *  The results of a single frame.
+ */
+struct BenchFrame
+{
+    int frame;
+    
+    double latency;
+    
+    float translationError;
+    float rotationError;
+    
+    bool success;
+};
+
+
+static bool loadConfig(const string &filename, BenchConfig &config)
+{
+    FileStorage fs(filename, FileStorage::READ);
+    if(!fs.isOpened())
+    {
+        cerr << "Failed to open config: " << filename << endl;
+        return false;
+    }
+    
+    fs["model"] >> config.model;
+    config.scale = fs["scale"].empty() ? 1.0f : (float)fs["scale"];
+    config.qualityThreshold = fs["quality_threshold"].empty() ? 0.55f : (float)fs["quality_threshold"];
+    fs["template_distances"] >> config.templateDistances;
+    if(config.templateDistances.empty())
+    {
+        config.templateDistances.push_back(200.0f);
+        config.templateDistances.push_back(400.0f);
+        config.templateDistances.push_back(600.0f);
+    }
+    
+    config.width = fs["width"].empty() ? 640 : (int)fs["width"];
+    config.height = fs["height"].empty() ? 512 : (int)fs["height"];
+    
+    vector<float> intrinsics;
+    fs["intrinsics"] >> intrinsics;
+    if(intrinsics.size() != 4)
+    {
+        cerr << "The intrinsics must be given as [fx, fy, cx, cy]" << endl;
+        return false;
+    }
+    config.K = Matx33f(intrinsics[0], 0, intrinsics[2], 0, intrinsics[1], intrinsics[3], 0, 0, 1);
+    
+    vector<float> distCoeffs;
+    fs["dist_coeffs"] >> distCoeffs;
+    config.distCoeffs = Matx14f(0, 0, 0, 0);
+    for(int i = 0; i < 4 && i < distCoeffs.size(); i++)
+    {
+        config.distCoeffs(0, i) = distCoeffs[i];
+    }
+    
+    config.zNear = fs["z_near"].empty() ? 10.0f : (float)fs["z_near"];
+    config.zFar = fs["z_far"].empty() ? 10000.0f : (float)fs["z_far"];
+    
+    fs["gt_poses"] >> config.gtPoses;
+    
+    fs["frames"] >> config.frames;
+    config.firstFrame = (int)fs["first_frame"];
+    config.numFrames = fs["num_frames"].empty() ? -1 : (int)fs["num_frames"];
+    
+    config.synthetic = (int)fs["synthetic"] != 0;
+    fs["synthetic_background"] >> config.syntheticBackground;
+    vector<float> color;
+    fs["synthetic_color"] >> color;
+    config.syntheticColor = color.size() == 3 ? Point3f(color[0], color[1], color[2]) : Point3f(1.0f, 0.5f, 0.0f);
+    config.syntheticNoise = (float)fs["synthetic_noise"];
+    
+    config.warmupFrames = (int)fs["warmup_frames"];
+    config.resetOnFailure = fs["reset_on_failure"].empty() || (int)fs["reset_on_failure"] != 0;
+    
+    fs["output_csv"] >> config.outputCSV;
+    fs["output_trace"] >> config.outputTrace;
+    
+    if(config.model.empty() || config.gtPoses.empty() || config.frames.empty())
+    {
+        cerr << "The config must specify model, gt_poses and frames" << endl;
+        return false;
+    }
+    
+    return true;
+}
+
+
+static vector<Matx44f> loadPoses(const string &filename)
+{
+    vector<Matx44f> poses;
+    
+    ifstream file(filename.c_str());
+    string line;
+    while(getline(file, line))
+    {
+        istringstream iss(line);
+        float vals[12];
+        int n = 0;
+        while(n < 12 && iss >> vals[n])
+            n++;
+        if(n < 12)
+            continue;
+        
+        poses.push_back(Matx44f(vals[0], vals[1], vals[2], vals[9],
+                                vals[3], vals[4], vals[5], vals[10],
+                                vals[6], vals[7], vals[8], vals[11],
+                                0, 0, 0, 1));
+    }
+    
+    return poses;
+}
+
+
+static string framePath(const string &pattern, int index)
+{
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), pattern.c_str(), index);
+    return string(buffer);
+}
+
+
+/**
+ *  Renders all missing frames of the sequence by drawing the model with Phong shading
+ *  along the ground truth poses on top of the background image and adding Gaussian
+ *  noise with a fixed seed, so that repeated runs see identical input.
+ */
+static bool generateSyntheticSequence(const BenchConfig &config, const vector<Matx44f> &gtPoses, int numFrames)
+{
+    Mat background = config.syntheticBackground.empty() ? Mat() : imread(config.syntheticBackground);
+    if(background.empty())
+    {
+        background = Mat(config.height, config.width, CV_8UC3, Scalar(96, 96, 96));
+    }
+    else if(background.cols != config.width || background.rows != config.height)
+    {
+        resize(background, background, Size(config.width, config.height));
+    }
+    
+    RenderingEngine *renderingEngine = RenderingEngine::Instance();
+    renderingEngine->makeCurrent();
+    
+    Model *model = new Model(config.model, 0, 0, 0, 0, 0, 0, config.scale);
+    model->initBuffers();
+    
+    vector<Model*> models(1, model);
+    vector<Point3f> colors(1, config.syntheticColor);
+    
+    int generated = 0;
+    for(int i = 0; i < numFrames; i++)
+    {
+        string path = framePath(config.frames, config.firstFrame + i);
+        
+        ifstream exists(path.c_str());
+        if(exists.good())
+            continue;
+        
+        QDir().mkpath(QFileInfo(QString::fromStdString(path)).absolutePath());
+        
+        model->setPose(gtPoses[i]);
+        
+        renderingEngine->setLevel(0);
+        renderingEngine->renderShaded(models, GL_FILL, colors, true);
+        
+        Mat rendering = renderingEngine->downloadFrame(RenderingEngine::RGB);
+        Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
+        
+        Mat frame = background.clone();
+        for(int y = 0; y < frame.rows; y++)
+        {
+            for(int x = 0; x < frame.cols; x++)
+            {
+                if(depth.at<float>(y, x) != 0.0f)
+                {
+                    Vec3b c = rendering.at<Vec3b>(y, x);
+                    frame.at<Vec3b>(y, x) = Vec3b(c[2], c[1], c[0]);
+                }
+            }
+        }
+        
+        if(config.syntheticNoise > 0)
+        {
+            RNG rng(0x5eed + i);
+            Mat noise(frame.size(), CV_16SC3);
+            rng.fill(noise, RNG::NORMAL, 0, config.syntheticNoise);
+            
+            Mat noisy;
+            frame.convertTo(noisy, CV_16SC3);
+            noisy += noise;
+            noisy.convertTo(frame, CV_8UC3);
+        }
+        
+        if(!imwrite(path, frame))
+        {
+            cerr << "Failed to write synthetic frame: " << path << endl;
+            delete model;
+            renderingEngine->doneCurrent();
+            return false;
+        }
+        generated++;
+    }
+    
+    delete model;
+    
+    renderingEngine->doneCurrent();
+    
+    if(generated > 0)
+        cout << "Generated " << generated << " synthetic frames" << endl;
+    
+    return true;
+}
+
+
+// the value at a given percentile using the nearest rank method
+static double percentile(vector<double> values, double p)
+{
+    if(values.empty())
+        return 0;
+    
+    sort(values.begin(), values.end());
+    
+    int rank = (int)ceil(p/100.0*values.size()) - 1;
+    rank = max(0, min(rank, (int)values.size() - 1));
+    
+    return values[rank];
+}
+
+
+static void printLatency(const string &name, const vector<double> &values)
+{
+    double sum = 0;
+    for(int i = 0; i < values.size(); i++)
+    {
+        sum += values[i];
+    }
+    double mean = values.empty() ? 0 : sum/values.size();
+    
+    cout << left << setw(28) << name << right << fixed << setprecision(3)
+         << setw(10) << mean
+         << setw(10) << percentile(values, 50)
+         << setw(10) << percentile(values, 95)
+         << setw(10) << percentile(values, 99) << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+#ifdef Q_OS_LINUX
+    // run without a display unless a platform was chosen explicitly
+    if(qgetenv("QT_QPA_PLATFORM").isEmpty() && qgetenv("DISPLAY").isEmpty() && qgetenv("WAYLAND_DISPLAY").isEmpty())
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+#endif
+    
+    QApplication app(argc, argv);
+    
+    string configFile = argc > 1 ? argv[1] : "data/bench.yml";
+    
+    BenchConfig config;
+    if(!loadConfig(configFile, config))
+        return -1;
+    
+    vector<Matx44f> gtPoses = loadPoses(config.gtPoses);
+    if(gtPoses.empty())
+    {
+        cerr << "Failed to load ground truth poses: " << config.gtPoses << endl;
+        return -1;
+    }
+    
+    int numFrames = (int)gtPoses.size();
+    if(config.numFrames > 0 && config.numFrames < numFrames)
+    {
+        numFrames = config.numFrames;
+    }
+    
+    vector<Object3D*> objects;
+    objects.push_back(new Object3D(config.model, 0, 0, 0, 0, 0, 0, config.scale, config.qualityThreshold, config.templateDistances));
+    objects[0]->setInitialPose(gtPoses[0]);
+    
+    PoseEstimator6D *poseEstimator = new PoseEstimator6D(config.width, config.height, config.zNear, config.zFar, config.K, config.distCoeffs, objects);
+    
+    if(config.synthetic && !generateSyntheticSequence(config, gtPoses, numFrames))
+        return -1;
+    
+    RenderingEngine::Instance()->makeCurrent();
+    
+    Profiler::Instance()->setTraceEnabled(!config.outputTrace.empty());
+    
+    vector<BenchFrame> results;
+    
+    TickMeter timer;
+    TickMeter total;
+    
+    for(int i = 0; i < numFrames; i++)
+    {
+        Mat frame = imread(framePath(config.frames, config.firstFrame + i));
+        if(frame.empty())
+        {
+            cerr << "Failed to load frame: " << framePath(config.frames, config.firstFrame + i) << endl;
+            break;
+        }
+        
+        if(i == 0)
+        {
+            objects[0]->reset();
+            poseEstimator->toggleTracking(frame, 0, false);
+            
+            // the initialization is not part of the per frame measurements
+            Profiler::Instance()->clear();
+        }
+        
+        total.start();
+        timer.start();
+        
+        poseEstimator->estimatePoses(frame, false, false);
+        
+        timer.stop();
+        total.stop();
+        
+        Matx44f pose = objects[0]->getPose();
+        
+        BenchFrame result;
+        result.frame = config.firstFrame + i;
+        result.latency = timer.getTimeMilli();
+        result.translationError = (float)norm(Vec3f(pose(0, 3) - gtPoses[i](0, 3), pose(1, 3) - gtPoses[i](1, 3), pose(2, 3) - gtPoses[i](2, 3)));
+        result.rotationError = Transformations::rotationError(pose, gtPoses[i])*180.0f/(float)CV_PI;
+        result.success = result.translationError < 50.0f && result.rotationError < 5.0f;
+        results.push_back(result);
+        
+        timer.reset();
+        
+        // the RBOT evaluation protocol resets the tracker to the ground truth after a failure
+        if(!result.success && config.resetOnFailure)
+        {
+            objects[0]->setPose(gtPoses[i]);
+        }
+    }
+    
+    RenderingEngine::Instance()->doneCurrent();
+    
+    if(results.empty())
+    {
+        cerr << "No frames were processed" << endl;
+        return -1;
+    }
+    
+    // LATENCY
+    
+    int warmup = min(max(config.warmupFrames, 0), (int)results.size() - 1);
+    
+    vector<double> latencies;
+    for(int i = warmup; i < results.size(); i++)
+    {
+        latencies.push_back(results[i].latency);
+    }
+    
+    cout << "---------------------------------------------------------------------" << endl;
+    cout << "Frames: " << results.size() << " (warm-up " << warmup << ")" << endl;
+    cout << "Throughput: " << fixed << setprecision(2) << results.size()/(total.getTimeSec() > 0 ? total.getTimeSec() : 1.0) << " frames/s" << endl;
+    cout << "---------------------------------------------------------------------" << endl;
+    cout << left << setw(28) << "latency [ms]" << right << setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p95" << setw(10) << "p99" << endl;
+    printLatency("frame", latencies);
+    
+    vector<ProfileFrame> profileFrames = Profiler::Instance()->getFrames();
+    
+#ifdef RBOT_ENABLE_PROFILING
+    set<string> stages;
+    for(int f = 0; f < profileFrames.size(); f++)
+    {
+        for(map<string, double>::const_iterator it = profileFrames[f].times.begin(); it != profileFrames[f].times.end(); it++)
+        {
+            stages.insert(it->first);
+        }
+    }
+    
+    for(set<string>::const_iterator s = stages.begin(); s != stages.end(); s++)
+    {
+        vector<double> times;
+        for(int f = warmup; f < profileFrames.size(); f++)
+        {
+            map<string, double>::const_iterator it = profileFrames[f].times.find(*s);
+            times.push_back(it != profileFrames[f].times.end() ? it->second : 0.0);
+        }
+        printLatency("  " + *s, times);
+    }
+#endif
+    
+    // ACCURACY
+    
+    vector<double> translationErrors, rotationErrors;
+    int numSuccess = 0;
+    for(int i = 0; i < results.size(); i++)
+    {
+        translationErrors.push_back(results[i].translationError);
+        rotationErrors.push_back(results[i].rotationError);
+        numSuccess += results[i].success;
+    }
+    
+    cout << "---------------------------------------------------------------------" << endl;
+    cout << "Success rate (5cm, 5deg): " << fixed << setprecision(2) << 100.0*numSuccess/results.size() << " %" << endl;
+    cout << "Translation error [mm]: median " << percentile(translationErrors, 50) << ", p95 " << percentile(translationErrors, 95) << endl;
+    cout << "Rotation error [deg]: median " << percentile(rotationErrors, 50) << ", p95 " << percentile(rotationErrors, 95) << endl;
+    cout << "---------------------------------------------------------------------" << endl;
+    
+    if(!config.outputCSV.empty())
+    {
+        ofstream file(config.outputCSV.c_str());
+        file << "frame,latency_ms,translation_error_mm,rotation_error_deg,success";
+        
+        // the stage times of each frame follow if profiling is compiled in
+        vector<string> stageNames;
+        for(int f = 0; f < profileFrames.size(); f++)
+        {
+            for(map<string, double>::const_iterator it = profileFrames[f].times.begin(); it != profileFrames[f].times.end(); it++)
+            {
+                if(find(stageNames.begin(), stageNames.end(), it->first) == stageNames.end())
+                    stageNames.push_back(it->first);
+            }
+        }
+        for(int s = 0; s < stageNames.size(); s++)
+        {
+            file << "," << stageNames[s] << "_ms";
+        }
+        file << "\n";
+        
+        file << fixed << setprecision(4);
+        for(int i = 0; i < results.size(); i++)
+        {
+            file << results[i].frame << "," << results[i].latency << "," << results[i].translationError << "," << results[i].rotationError << "," << results[i].success;
+            for(int s = 0; s < stageNames.size(); s++)
+            {
+                double t = 0;
+                if(i < profileFrames.size())
+                {
+                    map<string, double>::const_iterator it = profileFrames[i].times.find(stageNames[s]);
+                    if(it != profileFrames[i].times.end())
+                        t = it->second;
+                }
+                file << "," << t;
+            }
+            file << "\n";
+        }
+    }
+    
+    if(!config.outputTrace.empty())
+    {
+        Profiler::Instance()->exportChromeTrace(config.outputTrace);
+    }
+    
+    RenderingEngine::Instance()->destroy();
+    
+    for(int i = 0; i < objects.size(); i++)
+    {
+        delete objects[i];
+    }
+    objects.clear();
+    
+    delete poseEstimator;
+    
+    return 0;
+}
@@ -0,0 +1,651 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <QApplication>
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "object3d.h"
+#include "pose_estimator6d.h"
+#include "optimization_engine.h"
+#include "signed_distance_transform2d.h"
+#include "tclc_histograms.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ *  A registered micro-benchmark, i.e. a kernel invocation on prepared
+ *  input data with a fixed number of worker threads.
+ */
+struct MicroBenchmark
+{
+    string name;
+    
+    int threads;
+    
+    function<void()> run;
+};
+
+
+/**
+ *  The aggregated timing of a micro-benchmark over all repetitions.
+ */
+struct MicroBenchmarkResult
+{
+    string name;
+    
+    long iterations;
+    
+    // time per iteration in microseconds
+    double mean;
+    double median;
+    double stddev;
+    double min;
+};
+
+
+/**
+ *  The synthetic input data of all kernels, rendered once from the model at a fixed pose.
+ */
+struct KernelInput
+{
+    vector<Mat> imagePyramid;
+    
+    // per pyramid level: the cropped depth buffers, the silhouette mask, the SDT and the ROI as in OptimizationEngine::runIteration
+    vector<Mat> croppedDepth;
+    vector<Mat> croppedDepthInv;
+    vector<Mat> croppedMask;
+    vector<Mat> sdt;
+    vector<Mat> xyPos;
+    vector<Rect> roi;
+    
+    // the 8 bit silhouette mask at full resolution used for updating the histograms
+    Mat mask;
+    
+    vector<Mat> binnedPyramid;
+};
+
+
+static vector<Matx44f> loadPoses(const string &filename)
+{
+    vector<Matx44f> poses;
+    
+    ifstream file(filename.c_str());
+    string line;
+    while(getline(file, line))
+    {
+        istringstream iss(line);
+        float vals[12];
+        int n = 0;
+        while(n < 12 && iss >> vals[n])
+            n++;
+        if(n < 12)
+            continue;
+        
+        poses.push_back(Matx44f(vals[0], vals[1], vals[2], vals[9],
+                                vals[3], vals[4], vals[5], vals[10],
+                                vals[6], vals[7], vals[8], vals[11],
+                                0, 0, 0, 1));
+    }
+    
+    return poses;
+}
+
+
+// draws the object with Phong shading on top of the background
+static Mat renderFrame(Object3D *object, const Mat &background)
+{
+    RenderingEngine *renderingEngine = RenderingEngine::Instance();
+    
+    renderingEngine->setLevel(0);
+    renderingEngine->renderShaded(vector<Model*>(1, object), GL_FILL, vector<Point3f>(1, Point3f(1.0f, 0.5f, 0.0f)), true);
+    
+    Mat rendering = renderingEngine->downloadFrame(RenderingEngine::RGB);
+    Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
+    
+    Mat frame = background.clone();
+    for(int y = 0; y < frame.rows; y++)
+    {
+        for(int x = 0; x < frame.cols; x++)
+        {
+            if(depth.at<float>(y, x) != 0.0f)
+            {
+                Vec3b c = rendering.at<Vec3b>(y, x);
+                frame.at<Vec3b>(y, x) = Vec3b(c[2], c[1], c[0]);
+            }
+        }
+    }
+    
+    return frame;
+}
+
+
+// renders the depth buffers of the object at every pyramid level and crops them like a Gauss-Newton iteration does
+static void prepareInput(Object3D *object, const Mat &frame, int numLevels, KernelInput &input)
+{
+    RenderingEngine *renderingEngine = RenderingEngine::Instance();
+    
+    SignedDistanceTransform2D sdt2D(8.0f);
+    
+    input.imagePyramid.push_back(frame.clone());
+    for(int l = 1; l < 4; l++)
+    {
+        Mat frameCpy;
+        resize(frame, frameCpy, Size(frame.cols/pow(2, l), frame.rows/pow(2, l)));
+        input.imagePyramid.push_back(frameCpy);
+    }
+    
+    for(int l = 0; l < numLevels; l++)
+    {
+        renderingEngine->setLevel(l);
+        
+        renderingEngine->renderSilhouette(object, GL_FILL);
+        Mat depth = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
+        
+        if(l == 0)
+            input.mask = renderingEngine->downloadFrame(RenderingEngine::MASK);
+        
+        renderingEngine->renderSilhouette(object, GL_FILL, true);
+        Mat depthInv = renderingEngine->downloadFrame(RenderingEngine::DEPTH);
+        
+        // the bounding box of the silhouette with a border of 8 pixels
+        Mat nonZero;
+        findNonZero(depth > 0, nonZero);
+        Rect roi = boundingRect(nonZero);
+        roi = Rect(roi.x - 8, roi.y - 8, roi.width + 16, roi.height + 16) & Rect(0, 0, depth.cols, depth.rows);
+        
+        // for a single object the depth buffer serves as the silhouette mask
+        input.croppedDepth.push_back(depth(roi).clone());
+        input.croppedDepthInv.push_back(depthInv(roi).clone());
+        input.croppedMask.push_back(depth(roi).clone());
+        input.roi.push_back(roi);
+        
+        Mat sdt, xyPos;
+        sdt2D.computeTransform(input.croppedMask.back(), sdt, xyPos, 8, -1);
+        input.sdt.push_back(sdt);
+        input.xyPos.push_back(xyPos);
+    }
+    
+    int numBins = object->getTCLCHistograms()->getNumBins();
+    for(int l = 0; l < input.imagePyramid.size(); l++)
+    {
+        Mat binned;
+        parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(input.imagePyramid[l], binned, numBins, 8));
+        input.binnedPyramid.push_back(binned);
+    }
+}
+
+
+static MicroBenchmarkResult measure(const MicroBenchmark &benchmark, double minTime, int repetitions)
+{
+    setNumThreads(benchmark.threads);
+    
+    // warm up caches and the thread pool
+    benchmark.run();
+    
+    // increase the number of iterations until a repetition lasts at least minTime seconds
+    long iterations = 1;
+    while(true)
+    {
+        int64 start = getTickCount();
+        for(long i = 0; i < iterations; i++)
+        {
+            benchmark.run();
+        }
+        double seconds = (getTickCount() - start)/getTickFrequency();
+        
+        if(seconds >= minTime || iterations >= (1L << 30))
+            break;
+        
+        // aim for 1.4 times the minimum time, but grow by at most a factor of 10
+        double factor = seconds > 0 ? 1.4*minTime/seconds : 10.0;
+        iterations = max(iterations + 1, (long)(iterations*min(factor, 10.0)));
+    }
+    
+    vector<double> times;
+    for(int r = 0; r < repetitions; r++)
+    {
+        int64 start = getTickCount();
+        for(long i = 0; i < iterations; i++)
+        {
+            benchmark.run();
+        }
+        times.push_back((getTickCount() - start)/getTickFrequency()*1e6/iterations);
+    }
+    
+    sort(times.begin(), times.end());
+    
+    MicroBenchmarkResult result;
+    result.name = benchmark.name;
+    result.iterations = iterations;
+    result.min = times[0];
+    result.median = times[times.size()/2];
+    
+    double sum = 0;
+    for(int r = 0; r < times.size(); r++)
+    {
+        sum += times[r];
+    }
+    result.mean = sum/times.size();
+    
+    double var = 0;
+    for(int r = 0; r < times.size(); r++)
+    {
+        var += (times[r] - result.mean)*(times[r] - result.mean);
+    }
+    result.stddev = times.size() > 1 ? sqrt(var/(times.size() - 1)) : 0;
+    
+    return result;
+}
+
+
+static string benchmarkName(const string &kernel, const string &args, int threads)
+{
+    stringstream ss;
+    ss << kernel << "/" << args << "/threads:" << threads;
+    return ss.str();
+}
+
+
+static string sizeName(const Size &size)
+{
+    stringstream ss;
+    ss << size.width << "x" << size.height;
+    return ss.str();
+}
+
+
+static void printUsage()
+{
+    cout << "Usage: rbot_microbench [options]" << endl
+         << "  --filter=<text>      only run benchmarks whose name contains the text" << endl
+         << "  --threads=<n,...>    the worker thread counts (default 1,2,4,8)" << endl
+         << "  --min_time=<s>       the minimum duration of a repetition (default 0.5)" << endl
+         << "  --repetitions=<n>    the number of repetitions (default 3)" << endl
+         << "  --csv=<file>         write the results into a CSV file" << endl
+         << "  --model=<file>       the model (default data/cat_simple.obj)" << endl
+         << "  --poses=<file>       the poses, the first one is used (default poses_first.txt)" << endl
+         << "  --background=<file>  the background image (default data/frame.png)" << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+#ifdef Q_OS_LINUX
+    // run without a display unless a platform was chosen explicitly
+    if(qgetenv("QT_QPA_PLATFORM").isEmpty() && qgetenv("DISPLAY").isEmpty() && qgetenv("WAYLAND_DISPLAY").isEmpty())
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+#endif
+    
+    QApplication app(argc, argv);
+    
+    string filter;
+    vector<int> threadCounts;
+    double minTime = 0.5;
+    int repetitions = 3;
+    string csvFile;
+    string modelFile = "data/cat_simple.obj";
+    string posesFile = "poses_first.txt";
+    string backgroundFile = "data/frame.png";
+    
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        
+        if(key == "--filter")
+            filter = value;
+        else if(key == "--threads")
+        {
+            stringstream ss(value);
+            string t;
+            while(getline(ss, t, ','))
+            {
+                if(atoi(t.c_str()) > 0)
+                    threadCounts.push_back(atoi(t.c_str()));
+            }
+        }
+        else if(key == "--min_time")
+            minTime = atof(value.c_str());
+        else if(key == "--repetitions")
+            repetitions = max(1, atoi(value.c_str()));
+        else if(key == "--csv")
+            csvFile = value;
+        else if(key == "--model")
+            modelFile = value;
+        else if(key == "--poses")
+            posesFile = value;
+        else if(key == "--background")
+            backgroundFile = value;
+        else
+        {
+            printUsage();
+            return arg == "--help" ? 0 : -1;
+        }
+    }
+    
+    if(threadCounts.empty())
+    {
+        threadCounts.push_back(1);
+        threadCounts.push_back(2);
+        threadCounts.push_back(4);
+        threadCounts.push_back(8);
+    }
+    
+    // SET UP THE TRACKER AND THE INPUT DATA
+    
+    int width = 640;
+    int height = 512;
+    Matx33f K(650.048f, 0, 324.328f, 0, 647.183f, 257.323f, 0, 0, 1);
+    Matx14f distCoeffs(0, 0, 0, 0);
+    
+    vector<Matx44f> poses = loadPoses(posesFile);
+    if(poses.empty())
+    {
+        cerr << "Failed to load poses: " << posesFile << endl;
+        return -1;
+    }
+    
+    Mat background = imread(backgroundFile);
+    if(background.empty())
+        background = Mat(height, width, CV_8UC3, Scalar(96, 96, 96));
+    resize(background, background, Size(width, height));
+    
+    vector<float> distances;
+    distances.push_back(200.0f);
+    distances.push_back(400.0f);
+    distances.push_back(600.0f);
+    
+    vector<Object3D*> objects;
+    objects.push_back(new Object3D(modelFile, 0, 0, 0, 0, 0, 0, 1.0f, 0.55f, distances));
+    objects[0]->setInitialPose(poses[0]);
+    
+    PoseEstimator6D *poseEstimator = new PoseEstimator6D(width, height, 10.0f, 10000.0f, K, distCoeffs, objects);
+    
+    RenderingEngine::Instance()->makeCurrent();
+    
+    objects[0]->setPose(poses[0]);
+    Mat frame = renderFrame(objects[0], background);
+    
+    objects[0]->reset();
+    poseEstimator->toggleTracking(frame, 0, false);
+    
+    int numLevels = 3;
+    
+    KernelInput input;
+    prepareInput(objects[0], frame, numLevels, input);
+    
+    RenderingEngine::Instance()->doneCurrent();
+    
+    Object3D *object = objects[0];
+    TCLCHistograms *tclcHistograms = object->getTCLCHistograms();
+    int numBins = tclcHistograms->getNumBins();
+    int m_id = object->getModelID();
+    
+    // CHECK THE SILHOUETTE CONTOURS
+    
+    // a closed object must yield long polylines, which fall apart into single edges if the seams of the mesh are not welded
+    vector<vector<Point2f> > contours;
+    vector<vector<int> > contourIDs;
+    if(object->projectSilhouette(K, 0, contours, contourIDs))
+    {
+        int numPoints = 0;
+        int longest = 0;
+        for(int c = 0; c < contours.size(); c++)
+        {
+            numPoints += (int)contours[c].size();
+            longest = max(longest, (int)contours[c].size());
+        }
+        
+        if(2*longest < numPoints)
+        {
+            cerr << "Silhouette check failed: the longest of " << contours.size() << " contours has " << longest << " of " << numPoints << " points" << endl;
+            return -1;
+        }
+    }
+    
+    // REGISTER THE BENCHMARKS
+    
+    vector<MicroBenchmark> benchmarks;
+    
+    // synthetic masks of different sizes obtained by scaling the rendered silhouette
+    vector<Size> sizes;
+    sizes.push_back(Size(320, 256));
+    sizes.push_back(Size(640, 512));
+    sizes.push_back(Size(1280, 1024));
+    
+    vector<Mat> masks, frames;
+    for(int s = 0; s < sizes.size(); s++)
+    {
+        Mat mask, scaledFrame;
+        resize(input.mask, mask, sizes[s], 0, 0, INTER_NEAREST);
+        resize(frame, scaledFrame, sizes[s]);
+        masks.push_back(mask);
+        frames.push_back(scaledFrame);
+    }
+    
+    SignedDistanceTransform2D sdt2D(8.0f);
+    
+    Mat sdt, xyPos, binned, prMap;
+    vector<Matx66f> wJTJCollection;
+    vector<Matx61f> JTCollection;
+    
+    vector<TemplateView*> templateViews = object->getTemplateViews();
+    vector<Point3f> offsets;
+    int numBaseTemplates = min(4*object->getNumDistances(), (int)templateViews.size());
+    
+    vector<Point3i> centersIDs = tclcHistograms->getCentersAndIDs();
+    int numCenters = (int)centersIDs.size();
+    int histogramSize = numBins*numBins*numBins;
+    
+    Mat notNormalizedFG = Mat::zeros(max(numCenters, 1), histogramSize, CV_32SC1);
+    Mat notNormalizedBG = Mat::zeros(max(numCenters, 1), histogramSize, CV_32SC1);
+    Mat sumsFB = Mat::zeros(max(numCenters, 1), 1, CV_32SC2);
+    
+    // the merge works on copies, so that the histograms used by the other kernels remain unchanged
+    Mat normalizedFG = tclcHistograms->getLocalForegroundHistograms().clone();
+    Mat normalizedBG = tclcHistograms->getLocalBackgroundHistograms().clone();
+    Mat initialized = tclcHistograms->getInitialized().clone();
+    
+    int radius = tclcHistograms->getRadius();
+    
+    for(int t = 0; t < threadCounts.size(); t++)
+    {
+        int threads = threadCounts[t];
+        
+        for(int s = 0; s < sizes.size(); s++)
+        {
+            const Mat &mask = masks[s];
+            
+            MicroBenchmark benchmark;
+            benchmark.name = benchmarkName("signedDistanceTransform", sizeName(sizes[s]), threads);
+            benchmark.threads = threads;
+            benchmark.run = [&sdt2D, &mask, &sdt, &xyPos, m_id]() { sdt2D.computeTransform(mask, sdt, xyPos, 8, m_id); };
+            benchmarks.push_back(benchmark);
+        }
+        
+        for(int s = 0; s < sizes.size(); s++)
+        {
+            const Mat &scaledFrame = frames[s];
+            
+            MicroBenchmark benchmark;
+            benchmark.name = benchmarkName("convertToBins", sizeName(sizes[s]), threads);
+            benchmark.threads = threads;
+            benchmark.run = [&scaledFrame, &binned, numBins]() { parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(scaledFrame, binned, numBins, 8)); };
+            benchmarks.push_back(benchmark);
+        }
+        
+        for(int l = 0; l < numLevels; l++)
+        {
+            KernelInput *in = &input;
+            
+            stringstream args;
+            args << "level:" << l << "/roi:" << sizeName(input.roi[l].size());
+            
+            // one row of the ROI per parallel task as in OptimizationEngine::parallel_computeJacobians
+            MicroBenchmark benchmark;
+            benchmark.name = benchmarkName("computeJacobiansGN", args.str(), threads);
+            benchmark.threads = threads;
+            benchmark.run = [in, l, tclcHistograms, K, &wJTJCollection, &JTCollection]()
+            {
+                int rows = in->roi[l].height;
+                wJTJCollection.assign(rows, Matx66f::zeros());
+                JTCollection.assign(rows, Matx61f::zeros());
+                
+                float s = pow(2, l);
+                Matx33f K_l(K(0, 0)/s, 0, K(0, 2)/s, 0, K(1, 1)/s, K(1, 2)/s, 0, 0, 1);
+                
+                parallel_for_(cv::Range(0, rows), Parallel_For_computeJacobiansGN(tclcHistograms, in->imagePyramid[l], in->sdt[l], in->xyPos[l], in->croppedDepth[l], in->croppedDepthInv[l], K_l, 10.0f, 10000.0f, in->roi[l], in->croppedMask[l], -1, l, wJTJCollection, JTCollection, rows));
+            };
+            benchmarks.push_back(benchmark);
+        }
+        
+        {
+            stringstream args;
+            args << "centers:" << numCenters << "/radius:" << radius;
+            
+            MicroBenchmark benchmark;
+            benchmark.name = benchmarkName("buildLocalHistograms", args.str(), threads);
+            benchmark.threads = threads;
+            benchmark.run = [&frame, &input, &centersIDs, radius, numBins, &notNormalizedFG, &notNormalizedBG, &sumsFB, m_id, numCenters]()
+            {
+                notNormalizedFG.setTo(0);
+                notNormalizedBG.setTo(0);
+                sumsFB.setTo(0);
+                
+                parallel_for_(cv::Range(0, numCenters), Parallel_For_buildLocalHistograms(frame, input.mask, centersIDs, radius, numBins, notNormalizedFG, notNormalizedBG, sumsFB, m_id, numCenters));
+            };
+            benchmarks.push_back(benchmark);
+            
+            benchmark.name = benchmarkName("mergeLocalHistograms", args.str(), threads);
+            benchmark.run = [&notNormalizedFG, &notNormalizedBG, &normalizedFG, &normalizedBG, &initialized, &centersIDs, &sumsFB, numCenters]()
+            {
+                parallel_for_(cv::Range(0, numCenters), Parallel_For_mergeLocalHistograms(notNormalizedFG, notNormalizedBG, normalizedFG, normalizedBG, initialized, centersIDs, sumsFB, 0.1f, 0.2f, numCenters));
+            };
+            benchmarks.push_back(benchmark);
+        }
+        
+        {
+            int level = 3;
+            const Mat &binnedLevel = input.binnedPyramid[level];
+            
+            stringstream args;
+            args << "level:" << level << "/" << sizeName(binnedLevel.size());
+            
+            MicroBenchmark benchmark;
+            benchmark.name = benchmarkName("posteriorResponseMap", args.str(), threads);
+            benchmark.threads = threads;
+            benchmark.run = [tclcHistograms, &binnedLevel, &prMap]() { parallel_for_(cv::Range(0, 8), Parallel_For_createPosteriorResponseMap(tclcHistograms, binnedLevel, prMap, 8)); };
+            benchmarks.push_back(benchmark);
+            
+            args << "/templates:" << numBaseTemplates;
+            
+            // the coarse and fine search over the templates of four base views as in a relocalization step
+            benchmark.name = benchmarkName("exhaustiveSearch", args.str(), threads);
+            benchmark.run = [tclcHistograms, &templateViews, &offsets, &binnedLevel, &prMap, level, numBaseTemplates]()
+            {
+                if(prMap.empty())
+                    parallel_for_(cv::Range(0, 8), Parallel_For_createPosteriorResponseMap(tclcHistograms, binnedLevel, prMap, 8));
+                
+                parallel_for_(cv::Range(0, numBaseTemplates), Parallel_For_exhaustiveSearch(tclcHistograms, templateViews, offsets, binnedLevel, prMap, level, 4, -1));
+                parallel_for_(cv::Range(0, numBaseTemplates), Parallel_For_exhaustiveSearch(tclcHistograms, templateViews, offsets, binnedLevel, prMap, level, 1, 2));
+            };
+            benchmarks.push_back(benchmark);
+        }
+    }
+    
+    // RUN THE BENCHMARKS
+    
+    int defaultThreads = getNumThreads();
+    
+    vector<MicroBenchmarkResult> results;
+    
+    cout << left << setw(64) << "Benchmark" << right << setw(14) << "Time [us]" << setw(14) << "Median [us]" << setw(12) << "Stddev" << setw(14) << "Iterations" << endl;
+    cout << string(118, '-') << endl;
+    
+    for(int b = 0; b < benchmarks.size(); b++)
+    {
+        if(!filter.empty() && benchmarks[b].name.find(filter) == string::npos)
+            continue;
+        
+        MicroBenchmarkResult result = measure(benchmarks[b], minTime, repetitions);
+        results.push_back(result);
+        
+        cout << left << setw(64) << result.name << right << fixed << setprecision(2)
+             << setw(14) << result.mean << setw(14) << result.median << setw(12) << result.stddev << setw(14) << result.iterations << endl;
+    }
+    
+    setNumThreads(defaultThreads);
+    
+    if(!csvFile.empty())
+    {
+        ofstream file(csvFile.c_str());
+        file << "name,iterations,mean_us,median_us,stddev_us,min_us\n";
+        file << fixed << setprecision(4);
+        for(int r = 0; r < results.size(); r++)
+        {
+            file << results[r].name << "," << results[r].iterations << "," << results[r].mean << "," << results[r].median << "," << results[r].stddev << "," << results[r].min << "\n";
+        }
+    }
+    
+    RenderingEngine::Instance()->destroy();
+    
+    for(int i = 0; i < objects.size(); i++)
+    {
+        delete objects[i];
+    }
+    objects.clear();
+    
+    delete poseEstimator;
+    
+    return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <QApplication>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "tracking_server.h"
+
+using namespace std;
+using namespace cv;
+
+static void printUsage()
+{
+    cout << "Usage: rbot_server [options] <model> [<model> ...]" << endl
+         << "  Tracks the given models in several camera streams, whose frames are exchanged through" << endl
+         << "  shared memory segments named <prefix>0, <prefix>1, ... (see TrackingClient)." << endl
+         << "  --streams=<n>            the number of camera streams (default = 1)" << endl
+         << "  --prefix=<name>          the prefix of the shared memory keys (default = rbot_stream_)" << endl
+         << "  --width=<w>              the width of the camera frames (default = 640)" << endl
+         << "  --height=<h>             the height of the camera frames (default = 512)" << endl
+         << "  --K=<fx,fy,cx,cy>        the camera intrinsics of all streams" << endl
+         << "  --distances=<d0,d1,...>  the template distances of all models (default = 200,400,600)" << endl
+         << "  --scale=<s>              the scale of all models (default = 1)" << endl
+         << "  --quality=<q>            the tracking quality threshold of all models (default = 0.55)" << endl;
+}
+
+
+static vector<float> parseList(const string &value)
+{
+    vector<float> list;
+    
+    stringstream ss(value);
+    string t;
+    while(getline(ss, t, ','))
+    {
+        list.push_back(atof(t.c_str()));
+    }
+    
+    return list;
+}
+
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    
+    int numStreams = 1;
+    string prefix = "rbot_stream_";
+    int width = 640;
+    int height = 512;
+    float zNear = 10.0f;
+    float zFar = 10000.0f;
+    Matx33f K(650.048, 0, 324.328, 0, 647.183, 257.323, 0, 0, 1);
+    Matx14f distCoeffs(0, 0, 0, 0);
+    vector<float> distances = {200.0f, 400.0f, 600.0f};
+    float scale = 1.0f;
+    float quality = 0.55f;
+    vector<string> models;
+    
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        
+        if(key == "--streams")
+            numStreams = max(1, atoi(value.c_str()));
+        else if(key == "--prefix")
+            prefix = value;
+        else if(key == "--width")
+            width = atoi(value.c_str());
+        else if(key == "--height")
+            height = atoi(value.c_str());
+        else if(key == "--K")
+        {
+            vector<float> k = parseList(value);
+            if(k.size() != 4)
+            {
+                printUsage();
+                return -1;
+            }
+            K = Matx33f(k[0], 0, k[2], 0, k[1], k[3], 0, 0, 1);
+        }
+        else if(key == "--distances")
+            distances = parseList(value);
+        else if(key == "--scale")
+            scale = atof(value.c_str());
+        else if(key == "--quality")
+            quality = atof(value.c_str());
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            printUsage();
+            return arg == "--help" ? 0 : -1;
+        }
+        else
+            models.push_back(arg);
+    }
+    
+    if(models.empty())
+    {
+        printUsage();
+        return -1;
+    }
+    
+    vector<ObjectDescription> catalog;
+    for(int i = 0; i < models.size(); i++)
+    {
+        ObjectDescription description;
+        description.filename = models[i];
+        description.tx = 0;
+        description.ty = 0;
+        description.tz = 500;
+        description.alpha = 0;
+        description.beta = 0;
+        description.gamma = 0;
+        description.scale = scale;
+        description.qualityThreshold = quality;
+        description.templateDistances = distances;
+        
+        catalog.push_back(description);
+    }
+    
+    TrackingServer server(catalog, zNear, zFar);
+    
+    for(int s = 0; s < numStreams; s++)
+    {
+        stringstream key;
+        key << prefix << s;
+        
+        if(!server.addStream(key.str(), width, height, K, distCoeffs))
+        {
+            cerr << "Failed to start stream " << key.str() << endl;
+            return -1;
+        }
+        
+        cout << "Serving " << key.str() << endl;
+    }
+    
+    cout << server.getNumStreams() << " streams, " << server.getTemplateCache()->getNumEntries() << " template sets" << endl
+         << "Press Enter to stop" << endl;
+    
+    cin.get();
+    
+    server.stop();
+    
+    return 0;
+}
@@ -0,0 +1,360 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "relocalization_worker.h"
+#include "pose_estimator6d.h"
+#include "profiler.h"
+
+using namespace std;
+using namespace cv;
+
+bool sortTemplateMatch(const TemplateMatch &a, const TemplateMatch &b)
+{
+    return a.offset.z < b.offset.z;
+}
+
+
+RelocalizationWorker::RelocalizationWorker()
+{
+    activeIndex = -1;
+    activeCancelled = false;
+    
+    stopped = false;
+}
+
+
+RelocalizationWorker::~RelocalizationWorker()
+{
+    stop();
+}
+
+
+void RelocalizationWorker::submit(Object3D *object, int objectIndex, const vector<Mat> &imagePyramid)
+{
+    Job job;
+    job.object = object;
+    job.objectIndex = objectIndex;
+    
+    // template matching only uses the two lowest pyramid levels
+    job.imagePyramid.resize(imagePyramid.size());
+    for(int l = 2; l < imagePyramid.size(); l++)
+    {
+        job.imagePyramid[l] = imagePyramid[l].clone();
+    }
+    
+    QMutexLocker locker(&mutex);
+    
+    results.erase(objectIndex);
+    jobs.push_back(job);
+    
+    jobAvailable.wakeOne();
+}
+
+
+bool RelocalizationWorker::fetchResult(int objectIndex, RelocalizationState &state)
+{
+    QMutexLocker locker(&mutex);
+    
+    map<int, RelocalizationState>::iterator it = results.find(objectIndex);
+    if(it == results.end())
+        return false;
+    
+    state.baseCandidates = it->second.baseCandidates;
+    state.neighborCandidates = it->second.neighborCandidates;
+    state.stage = it->second.stage;
+    state.next = 0;
+    
+    results.erase(it);
+    
+    return true;
+}
+
+
+void RelocalizationWorker::cancel(int objectIndex)
+{
+    QMutexLocker locker(&mutex);
+    
+    for(deque<Job>::iterator it = jobs.begin(); it != jobs.end();)
+    {
+        if(it->objectIndex == objectIndex)
+            it = jobs.erase(it);
+        else
+            ++it;
+    }
+    
+    if(activeIndex == objectIndex)
+    {
+        activeCancelled = true;
+        
+        while(activeIndex == objectIndex)
+        {
+            jobFinished.wait(&mutex);
+        }
+    }
+    
+    results.erase(objectIndex);
+}
+
+
+void RelocalizationWorker::stop()
+{
+    mutex.lock();
+    
+    stopped = true;
+    jobs.clear();
+    activeCancelled = true;
+    
+    jobAvailable.wakeAll();
+    
+    mutex.unlock();
+    
+    wait();
+}
+
+
+void RelocalizationWorker::run()
+{
+    while(true)
+    {
+        mutex.lock();
+        
+        while(jobs.empty() && !stopped)
+        {
+            jobAvailable.wait(&mutex);
+        }
+        
+        if(stopped)
+        {
+            mutex.unlock();
+            return;
+        }
+        
+        Job job = jobs.front();
+        jobs.pop_front();
+        
+        activeIndex = job.objectIndex;
+        activeCancelled = false;
+        
+        mutex.unlock();
+        
+        RelocalizationState state;
+        vector<Mat> binnedPyramid(job.imagePyramid.size());
+        
+        bool finished = false;
+        bool cancelled = false;
+        
+        while(!finished && !cancelled)
+        {
+            finished = searchStep(job.object, state, job.imagePyramid, binnedPyramid);
+            
+            mutex.lock();
+            cancelled = activeCancelled;
+            mutex.unlock();
+        }
+        
+        mutex.lock();
+        
+        if(!cancelled)
+        {
+            results[job.objectIndex] = state;
+        }
+        
+        activeIndex = -1;
+        jobFinished.wakeAll();
+        
+        mutex.unlock();
+    }
+}
+
+
+bool RelocalizationWorker::searchStep(Object3D *object, RelocalizationState &state, const vector<Mat> &imagePyramid, vector<Mat> &binnedPyramid)
+{
+    RBOT_PROFILE_SCOPE("relocalizationSearch");
+    
+    TCLCHistograms *tclcHistograms = object->getTCLCHistograms();
+    
+    vector<TemplateView*> templateViews = object->getTemplateViews();
+    
+    int numDistances = object->getNumDistances();
+    
+    switch(state.stage)
+    {
+        case RelocalizationState::EXHAUSTIVE_SEARCH:
+        {
+            int level = 3;
+            
+            // PREPARE FRAME FOR LOWEST LEVEL
+            const Mat &binned = getBinned(tclcHistograms, imagePyramid, binnedPyramid, level);
+            
+            Mat prMap;
+            parallel_for_(cv::Range(0, 8), Parallel_For_createPosteriorResponseMap(tclcHistograms, binned, prMap, 8));
+            
+            // process the templates of 4 base views (all distances) at once
+            int start = state.next;
+            int end = std::min(start + 4*numDistances, (int)templateViews.size());
+            
+            parallel_for_(cv::Range(start, end), Parallel_For_exhaustiveSearch(tclcHistograms, templateViews, state.baseOffsets, binned, prMap, level, 4, -1));
+            
+            parallel_for_(cv::Range(start, end), Parallel_For_exhaustiveSearch(tclcHistograms, templateViews, state.baseOffsets, binned, prMap, level, 1, 2));
+            
+            state.next = end;
+            
+            if(state.next < templateViews.size())
+                return false;
+            
+            // KEEP ONLY THE BEST MATCHING DISTANCE PER TEMPLATE
+            for(int i = 0; i < templateViews.size(); i+=numDistances)
+            {
+                float minE = FLT_MAX;
+                int minIdx = -1;
+                for(int j = 0; j < numDistances; j++)
+                {
+                    Point3f offset = state.baseOffsets[i+j];
+                    
+                    if(offset.z < minE)
+                    {
+                        minE = offset.z;
+                        minIdx = j;
+                    }
+                }
+                if(minE > 0.0f && minIdx >= 0)
+                {
+                    TemplateMatch match;
+                    match.templateView = templateViews[i + minIdx];
+                    match.offset = state.baseOffsets[i + minIdx];
+                    
+                    state.baseCandidates.push_back(match);
+                }
+            }
+            
+            sort(state.baseCandidates.begin(), state.baseCandidates.end(), sortTemplateMatch);
+            
+            // descend into the viewpoint hierarchy from the better half of all base templates
+            state.beam.assign(state.baseCandidates.begin(), state.baseCandidates.begin() + state.baseCandidates.size()/2);
+            
+            state.stage = RelocalizationState::NEIGHBOR_SEARCH;
+            state.treeLevel = 0;
+            state.next = 0;
+            
+            return false;
+        }
+        case RelocalizationState::NEIGHBOR_SEARCH:
+        {
+            int level = 2;
+            
+            if(state.next < state.beam.size())
+            {
+                TemplateMatch match = state.beam[state.next];
+                
+                state.next++;
+                
+                float kve = match.offset.z;
+                
+                if(kve > 0.0f && kve < 1.0f)
+                {
+                    // PREPARE FRAME FOR 2ND LOWEST LEVEL
+                    const Mat &binned = getBinned(tclcHistograms, imagePyramid, binnedPyramid, level);
+                    
+                    vector<TemplateView*> neighbors = match.templateView->getNeighborTemplates();
+                    vector<Point3f> neighborOffsets;
+                    
+                    // the base templates were matched one pyramid level below all others
+                    int levelDiff = (state.treeLevel == 0) ? 1 : 0;
+                    
+                    parallel_for_(cv::Range(0, (int)neighbors.size()), Parallel_For_neighborSearch(tclcHistograms, match, neighborOffsets, binned, level, levelDiff));
+                    
+                    for(int n = 0; n < neighbors.size(); n++)
+                    {
+                        float e = neighborOffsets[n].z;
+                        
+                        if(e > 0.0f && e < 1.0f)
+                        {
+                            TemplateMatch neighborMatch;
+                            neighborMatch.templateView = neighbors[n];
+                            neighborMatch.offset = neighborOffsets[n];
+                            
+                            state.neighborCandidates.push_back(neighborMatch);
+                        }
+                    }
+                }
+                
+                return false;
+            }
+            
+            sort(state.neighborCandidates.begin(), state.neighborCandidates.end(), sortTemplateMatch);
+            
+            state.treeLevel++;
+            
+            bool leafLevel = state.treeLevel >= object->getNumTemplateLevels() - 1;
+            
+            // stop descending as soon as a finer level does not improve the best match (both matched at the same pyramid level)
+            if(state.treeLevel > 1 && !state.beam.empty()
+               && (state.neighborCandidates.empty() || state.neighborCandidates[0].offset.z >= state.beam[0].offset.z))
+            {
+                state.neighborCandidates = state.beam;
+                leafLevel = true;
+            }
+            
+            if(!leafLevel && !state.neighborCandidates.empty())
+            {
+                int beamWidth = std::max(1, (int)state.baseCandidates.size()/2);
+                
+                state.beam.assign(state.neighborCandidates.begin(), state.neighborCandidates.begin() + std::min(beamWidth, (int)state.neighborCandidates.size()));
+                state.neighborCandidates.clear();
+                state.next = 0;
+                
+                return false;
+            }
+            
+            state.stage = RelocalizationState::REFINEMENT;
+            state.next = 0;
+            
+            return true;
+        }
+        default:
+            return true;
+    }
+}
+
+
+const Mat &RelocalizationWorker::getBinned(TCLCHistograms *tclcHistograms, const vector<Mat> &imagePyramid, vector<Mat> &binnedPyramid, int level)
+{
+    if(binnedPyramid[level].empty())
+    {
+        parallel_for_(cv::Range(0, 8), Parallel_For_convertToBins(imagePyramid[level], binnedPyramid[level], tclcHistograms->getNumBins(), 8));
+    }
+    return binnedPyramid[level];
+}
@@ -0,0 +1,225 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RELOCALIZATION_WORKER_H
+#define RELOCALIZATION_WORKER_H
+
+#include <vector>
+#include <deque>
+#include <map>
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <opencv2/core.hpp>
+
+#include "object3d.h"
+#include "template_view.h"
+#include "tclc_histograms.h"
+
+/**
+ *  The progress of an incremental pose detection for a single object whose
+ *  tracking has been lost. Relocalization is split into a sequence of small
+ *  steps (a batch of base templates, the neighbors of one base template or
+ *  one candidate refinement) so that it can be suspended whenever the time
+ *  budget of the current frame is exhausted and resumed with the next frame.
+ */
+struct RelocalizationState
+{
+    enum Stage
+    {
+        EXHAUSTIVE_SEARCH,
+        NEIGHBOR_SEARCH,
+        REFINEMENT,
+        FINISHED
+    };
+    
+    Stage stage;
+    
+    // index of the next base template, base candidate or refinement candidate
+    int next;
+    
+    // true while the template search is performed by a relocalization worker
+    bool pending;
+    
+    // the best matching offsets of all base templates at the lowest pyramid level
+    std::vector<cv::Point3f> baseOffsets;
+    
+    std::vector<TemplateMatch> baseCandidates;
+    
+    // the level of the viewpoint hierarchy currently expanded and its best matching templates
+    int treeLevel;
+    std::vector<TemplateMatch> beam;
+    
+    std::vector<TemplateMatch> neighborCandidates;
+    
+    // the poses of all candidates refined so far, which are evaluated together
+    std::vector<cv::Matx44f> refinedPoses;
+    
+    float minE;
+    cv::Matx44f finalPose;
+    bool found;
+    
+    RelocalizationState()
+    {
+        reset();
+    }
+    
+    void reset()
+    {
+        stage = EXHAUSTIVE_SEARCH;
+        next = 0;
+        pending = false;
+        baseOffsets.clear();
+        baseCandidates.clear();
+        treeLevel = 0;
+        beam.clear();
+        neighborCandidates.clear();
+        refinedPoses.clear();
+        minE = FLT_MAX;
+        finalPose = cv::Matx44f();
+        found = false;
+    }
+};
+
+/**
+ *  This class implements a background thread that performs the template
+ *  matching stages of pose detection (exhaustive search of all base templates
+ *  and neighbor search of the best matching ones) for objects whose tracking has
+ *  been lost. These stages only require the CPU, so that they can run concurrently
+ *  to frame-to-frame tracking of all other objects. Each search operates on its
+ *  own copy of the lower image pyramid levels of the frame it was submitted with.
+ *  The resulting ranked template matches are then refined by the tracker using
+ *  the rendering engine.
+ *  The tclc-histograms of an object are only read during a search. They must not
+ *  be modified until the search has finished or has been cancelled.
+ */
+class RelocalizationWorker : public QThread
+{
+public:
+    RelocalizationWorker();
+    
+    ~RelocalizationWorker();
+    
+    /**
+     *  Queues a template search for an object based on the given camera
+     *  frame. Only a copy of the image pyramid levels used for template
+     *  matching is retained.
+     *
+     *  @param  object The 3D object to be searched for.
+     *  @param  objectIndex The index of the object within the tracker.
+     *  @param  imagePyramid The image pyramid of the current camera frame (RGB, uchar).
+     */
+    void submit(Object3D *object, int objectIndex, const std::vector<cv::Mat> &imagePyramid);
+    
+    /**
+     *  Fetches the result of a finished template search for an object. If
+     *  available, the ranked template matches are stored in the given state
+     *  which is then advanced to the refinement stage.
+     *
+     *  @param  objectIndex The index of the object within the tracker.
+     *  @param  state The relocalization state of the object to be updated.
+     *  @return True if the search had finished and false otherwise.
+     */
+    bool fetchResult(int objectIndex, RelocalizationState &state);
+    
+    /**
+     *  Discards a queued or finished template search for an object. If the
+     *  search is currently running, this blocks until it has been aborted.
+     *
+     *  @param  objectIndex The index of the object within the tracker.
+     */
+    void cancel(int objectIndex);
+    
+    /**
+     *  Discards all pending searches and terminates the thread.
+     */
+    void stop();
+    
+    /**
+     *  Performs a single step of the template search stages of pose detection,
+     *  i.e. the exhaustive search of a batch of base templates or the neighbor
+     *  search of a single template candidate. Starting with the better half of
+     *  all base templates, the viewpoint hierarchy is descended in a beam search
+     *  until its finest level is reached or the matches do not improve anymore.
+     *
+     *  @param  object The 3D object to be searched for.
+     *  @param  state The relocalization state of the object.
+     *  @param  imagePyramid The image pyramid of the camera frame (RGB, uchar).
+     *  @param  binnedPyramid The corresponding lazily computed histogram bin index images.
+     *  @return True if the state has reached the refinement stage and false otherwise.
+     */
+    static bool searchStep(Object3D *object, RelocalizationState &state, const std::vector<cv::Mat> &imagePyramid, std::vector<cv::Mat> &binnedPyramid);
+    
+    /**
+     *  Returns the image of histogram bin indices for a given pyramid level,
+     *  computing it only on first access.
+     *
+     *  @param  tclcHistograms The tclc-histograms defining the number of bins.
+     *  @param  imagePyramid The image pyramid of the camera frame (RGB, uchar).
+     *  @param  binnedPyramid The corresponding lazily computed histogram bin index images.
+     *  @param  level The pyramid level to be used.
+     *  @return The image of histogram bin indices.
+     */
+    static const cv::Mat &getBinned(TCLCHistograms *tclcHistograms, const std::vector<cv::Mat> &imagePyramid, std::vector<cv::Mat> &binnedPyramid, int level);
+    
+protected:
+    void run();
+    
+private:
+    struct Job
+    {
+        Object3D *object;
+        int objectIndex;
+        std::vector<cv::Mat> imagePyramid;
+    };
+    
+    QMutex mutex;
+    QWaitCondition jobAvailable;
+    QWaitCondition jobFinished;
+    
+    std::deque<Job> jobs;
+    
+    std::map<int, RelocalizationState> results;
+    
+    int activeIndex;
+    bool activeCancelled;
+    
+    bool stopped;
+};
+
+#endif /* RELOCALIZATION_WORKER_H */
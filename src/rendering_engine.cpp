@@ -34,15 +34,56 @@
  */
 
 #include "rendering_engine.h"
+#include "profiler.h"
 
 #include <iostream>
+#include <mutex>
+
+#include <QByteArray>
 
 using namespace std;
 using namespace cv;
 
+// the shaders are embedded via shaders.qrc, whose resources have to be registered explicitly when linked from a static library
+static void registerShaderResources()
+{
+    Q_INIT_RESOURCE(shaders);
+}
+
+// every engine initializes its shaders, but the resources must only be registered once per process
+static void initShaderResources()
+{
+    static std::once_flag registered;
+    std::call_once(registered, registerShaderResources);
+}
+
+// must match MAX_INSTANCES of the instanced silhouette shader
+static const int MAX_INSTANCES = 128;
+
 
 RenderingEngine* RenderingEngine::instance;
 
+// the intrinsics of all pyramid levels as 4x4 matrices
+static vector<Matx44f> computeCalibrationMatrices(const Matx33f &K, int numLevels)
+{
+    vector<Matx44f> calibrationMatrices;
+    
+    for(int i = 0; i < numLevels; i++)
+    {
+        float s = pow(2, i);
+        
+        Matx44f K_l = Matx44f::eye();
+        K_l(0, 0) = K(0, 0)/s;
+        K_l(1, 1) = K(1, 1)/s;
+        K_l(0, 2) = K(0, 2)/s;
+        K_l(1, 2) = K(1, 2)/s;
+        
+        calibrationMatrices.push_back(K_l);
+    }
+    
+    return calibrationMatrices;
+}
+
 RenderingEngine::RenderingEngine(void)
 {
     QSurfaceFormat glFormat;
@@ -61,6 +102,16 @@ RenderingEngine::RenderingEngine(void)
     silhouetteShaderProgram = new QOpenGLShaderProgram();
     phongblinnShaderProgram = new QOpenGLShaderProgram();
     normalsShaderProgram = new QOpenGLShaderProgram();
+    silhouetteInstancedShaderProgram = new QOpenGLShaderProgram();
+    
+    instanceBufferID = 0;
+    instancingEnabled = false;
+    
+    atlasTarget = RenderTarget();
+    atlasTileWidth = 0;
+    atlasTileHeight = 0;
+    atlasTilesX = 1;
+    atlasNumTiles = 0;
     
     calibrationMatrices.push_back(Matx44f::eye());
     
@@ -69,22 +120,40 @@ RenderingEngine::RenderingEngine(void)
     lookAtMatrix = Transformations::lookAtMatrix(0, 0, 0, 0, 0, 1, 0, -1, 0);
     
     currentLevel = 0;
+    
+    cameras.resize(1);
+    currentCamera = 0;
 }
 
 RenderingEngine::~RenderingEngine(void)
 {
-    glDeleteTextures(1, &colorTextureID);
-    glDeleteTextures(1, &depthTextureID);
-    glDeleteFramebuffers(1, &frameBufferID);
+    // the resources belong to the context of this engine, which may not be the active one
+    makeCurrent();
     
+    deleteRenderingBuffers();
+    
+    if(instanceBufferID)
+        glDeleteBuffers(1, &instanceBufferID);
+    
+    delete silhouetteInstancedShaderProgram;
     delete phongblinnShaderProgram;
     delete normalsShaderProgram;
     delete silhouetteShaderProgram;
+    
+    doneCurrent();
+    
+    delete glContext;
     delete surface;
 }
 
 void RenderingEngine::destroy()
 {
+    // the process-wide instance may already have been destroyed by the application
+    if(this != instance)
+        return;
+    
+    makeCurrent();
+    
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -94,6 +163,12 @@ void RenderingEngine::destroy()
 }
 
 
+void RenderingEngine::moveToThread(QThread *thread)
+{
+    glContext->moveToThread(thread);
+}
+
+
 void RenderingEngine::makeCurrent()
 {
     glContext->makeCurrent(surface);
@@ -113,19 +188,19 @@ QOpenGLContext* RenderingEngine::getContext()
 
 GLuint RenderingEngine::getFrameBufferID()
 {
-    return frameBufferID;
+    return renderTargets[currentLevel].frameBufferID;
 }
 
 
 GLuint RenderingEngine::getColorTextureID()
 {
-    return colorTextureID;
+    return renderTargets[currentLevel].colorTextureID;
 }
 
 
 GLuint RenderingEngine::getDepthTextureID()
 {
-    return depthTextureID;
+    return renderTargets[currentLevel].depthTextureID;
 }
 
 float RenderingEngine::getZNear()
@@ -143,6 +218,15 @@ Matx44f RenderingEngine::getCalibrationMatrix()
     return calibrationMatrices[currentLevel];
 }
 
+Matx33f RenderingEngine::getCalibrationMatrix3x3()
+{
+    const Matx44f &K_l = calibrationMatrices[currentLevel];
+    
+    return Matx33f(K_l(0, 0), K_l(0, 1), K_l(0, 2),
+                   K_l(1, 0), K_l(1, 1), K_l(1, 2),
+                   K_l(2, 0), K_l(2, 1), K_l(2, 2));
+}
+
 void RenderingEngine::init(const Matx33f& K, int width, int height, float zNear, float zFar, int numLevels)
 {
     this->width = width;
@@ -167,20 +251,7 @@ void RenderingEngine::init(const Matx33f& K, int width, int height, float zNear,
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
     
-    calibrationMatrices.clear();
-    
-    for(int i = 0; i < numLevels; i++)
-    {
-        float s = pow(2, i);
-        
-        Matx44f K_l = Matx44f::eye();
-        K_l(0, 0) = K(0, 0)/s;
-        K_l(1, 1) = K(1, 1)/s;
-        K_l(0, 2) = K(0, 2)/s;
-        K_l(1, 2) = K(1, 2)/s;
-        
-        calibrationMatrices.push_back(K_l);
-    }
+    calibrationMatrices = computeCalibrationMatrices(K, numLevels);
     
     cout << "GL Version " << glGetString(GL_VERSION) << endl << "GLSL Version " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
     
@@ -196,14 +267,27 @@ void RenderingEngine::init(const Matx33f& K, int width, int height, float zNear,
     
     glClearColor(0.0, 0.0, 0.0, 1.0);
     
+    // the render targets are tightly packed, so rows of downloaded frames are not padded
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    
     initRenderingBuffers();
     
-    shaderFolder = "src/";
+    setLevel(0);
+    
+    // the embedded shaders are used unless RBOT_SHADER_DIR points to a folder with modified ones
+    initShaderResources();
+    QByteArray shaderDir = qgetenv("RBOT_SHADER_DIR");
+    shaderFolder = shaderDir.isEmpty() ? QString(":/shaders/") : QString::fromLocal8Bit(shaderDir) + "/";
     
     initShaderProgram(silhouetteShaderProgram, "silhouette");
     initShaderProgram(phongblinnShaderProgram, "phongblinn");
     initShaderProgram(normalsShaderProgram, "normals");
     
+    // without the instanced program, instances are rendered one by one and atlases are not supported
+    instancingEnabled = initShaderProgram(silhouetteInstancedShaderProgram, "silhouette_instanced") && initInstanceBuffer();
+    if(!instancingEnabled)
+        cout << "instanced rendering is disabled" << endl;
+    
     angle = 0;
     
     lightPosition = cv::Vec3f(0, 0, 0);
@@ -211,6 +295,73 @@ void RenderingEngine::init(const Matx33f& K, int width, int height, float zNear,
     doneCurrent();
 }
 
+int RenderingEngine::addCamera(const Matx33f &K, int width, int height)
+{
+    CameraSetup camera;
+    camera.fullWidth = width;
+    camera.fullHeight = height;
+    camera.projectionMatrix = Transformations::perspectiveMatrix(K, width, height, zNear, zFar, true);
+    camera.calibrationMatrices = computeCalibrationMatrices(K, numLevels);
+    
+    for(int l = 0; l < numLevels; l++)
+    {
+        int s = pow(2, l);
+        
+        RenderTarget target;
+        if(!createRenderTarget(target, width/s, height/s))
+        {
+            cout << "error creating rendering buffers for level " << l << " of camera " << cameras.size() << endl;
+        }
+        
+        camera.renderTargets.push_back(target);
+    }
+    
+    cameras.push_back(camera);
+    
+    // creating the targets changed the binding
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTargets[currentLevel].frameBufferID);
+    
+    return (int)cameras.size() - 1;
+}
+
+
+void RenderingEngine::setCamera(int camera)
+{
+    if(camera == currentCamera || camera < 0 || camera >= cameras.size())
+        return;
+    
+    CameraSetup &current = cameras[currentCamera];
+    current.fullWidth = fullWidth;
+    current.fullHeight = fullHeight;
+    current.projectionMatrix = projectionMatrix;
+    current.calibrationMatrices = calibrationMatrices;
+    current.renderTargets = renderTargets;
+    
+    const CameraSetup &next = cameras[camera];
+    fullWidth = next.fullWidth;
+    fullHeight = next.fullHeight;
+    projectionMatrix = next.projectionMatrix;
+    calibrationMatrices = next.calibrationMatrices;
+    renderTargets = next.renderTargets;
+    
+    currentCamera = camera;
+    
+    setLevel(currentLevel);
+}
+
+
+int RenderingEngine::getCamera()
+{
+    return currentCamera;
+}
+
+
+int RenderingEngine::getNumCameras()
+{
+    return (int)cameras.size();
+}
+
+
 int RenderingEngine::getNumLevels()
 {
     return numLevels;
@@ -219,12 +370,12 @@ int RenderingEngine::getNumLevels()
 void RenderingEngine::setLevel(int level)
 {
     currentLevel = level;
-    int s = pow(2, currentLevel);
-    width = fullWidth/s;
-    height = fullHeight/s;
     
-    width += width%4;
-    height += height%4;
+    RenderTarget &target = renderTargets[currentLevel];
+    width = target.width;
+    height = target.height;
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, target.frameBufferID);
 }
 
 
@@ -236,45 +387,138 @@ int RenderingEngine::getLevel()
 
 bool RenderingEngine::initRenderingBuffers()
 {
-    glGenTextures(1, &colorTextureID);
-    glBindTexture(GL_TEXTURE_2D, colorTextureID);
+    deleteRenderingBuffers();
+    
+    bool complete = true;
+    
+    for(int l = 0; l < numLevels; l++)
+    {
+        int s = pow(2, l);
+        
+        RenderTarget target;
+        if(!createRenderTarget(target, fullWidth/s, fullHeight/s))
+        {
+            cout << "error creating rendering buffers for level " << l << endl;
+            complete = false;
+        }
+        
+        renderTargets.push_back(target);
+    }
     
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    return complete;
+}
+
+
+void RenderingEngine::deleteRenderingBuffers()
+{
+    for(int l = 0; l < renderTargets.size(); l++)
+    {
+        deleteRenderTarget(renderTargets[l]);
+    }
+    renderTargets.clear();
+    
+    // the targets of the current camera are held in renderTargets
+    for(int c = 0; c < cameras.size(); c++)
+    {
+        if(c == currentCamera)
+            continue;
+        
+        for(int l = 0; l < cameras[c].renderTargets.size(); l++)
+        {
+            deleteRenderTarget(cameras[c].renderTargets[l]);
+        }
+    }
+    cameras.resize(1);
+    currentCamera = 0;
+    
+    deleteRenderTarget(atlasTarget);
+}
+
+
+bool RenderingEngine::createRenderTarget(RenderTarget &target, int width, int height, bool pixelBuffers)
+{
+    target.width = width;
+    target.height = height;
+    target.fence = 0;
+    target.pixelBuffersValid = false;
+    target.maskBufferID = 0;
+    target.depthBufferID = 0;
+    
+    if(pixelBuffers)
+    {
+        glGenBuffers(1, &target.maskBufferID);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, target.maskBufferID);
+        glBufferData(GL_PIXEL_PACK_BUFFER, target.width*target.height, NULL, GL_STREAM_READ);
+        
+        glGenBuffers(1, &target.depthBufferID);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, target.depthBufferID);
+        glBufferData(GL_PIXEL_PACK_BUFFER, target.width*target.height*sizeof(float), NULL, GL_STREAM_READ);
+        
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    
+    glGenTextures(1, &target.colorTextureID);
+    glBindTexture(GL_TEXTURE_2D, target.colorTextureID);
+    
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, target.width, target.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
     
-    glGenTextures(1, &depthTextureID);
-    glBindTexture(GL_TEXTURE_2D, depthTextureID);
+    glGenTextures(1, &target.depthTextureID);
+    glBindTexture(GL_TEXTURE_2D, target.depthTextureID);
     
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, target.width, target.height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
-    glGenFramebuffers(1, &frameBufferID);
-    glBindFramebuffer(GL_FRAMEBUFFER, frameBufferID);
+    glGenFramebuffers(1, &target.frameBufferID);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.frameBufferID);
+    
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTextureID, 0);
+    
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depthTextureID, 0);
     
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTextureID, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
     
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
     
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    return complete;
+}
+
+
+void RenderingEngine::deleteRenderTarget(RenderTarget &target)
+{
+    if(!target.frameBufferID)
+        return;
+    
+    if(target.fence)
+        glDeleteSync(target.fence);
+    
+    if(target.maskBufferID)
     {
-        cout << "error creating rendering buffers" << endl;
-        return false;
+        glDeleteBuffers(1, &target.maskBufferID);
+        glDeleteBuffers(1, &target.depthBufferID);
     }
-    return true;
+    
+    glDeleteTextures(1, &target.colorTextureID);
+    glDeleteTextures(1, &target.depthTextureID);
+    glDeleteFramebuffers(1, &target.frameBufferID);
+    
+    target = RenderTarget();
 }
 
 
 
 bool RenderingEngine::initShaderProgram(QOpenGLShaderProgram *program, QString shaderName)
 {
-    if (!program->addShaderFromSourceFile(QOpenGLShader::Vertex, shaderFolder + shaderName + "_vertex_shader.glsl")) {
+    // cacheable shaders are linked from a program binary stored in Qt's shader disk cache if their sources did not change,
+    // which skips the GLSL compilation after the first run
+    if (!program->addCacheableShaderFromSourceFile(QOpenGLShader::Vertex, shaderFolder + shaderName + "_vertex_shader.glsl")) {
         cout << "error adding vertex shader from source file" << endl;
         return false;
     }
-    if (!program->addShaderFromSourceFile(QOpenGLShader::Fragment, shaderFolder + shaderName + "_fragment_shader.glsl")) {
+    if (!program->addCacheableShaderFromSourceFile(QOpenGLShader::Fragment, shaderFolder + shaderName + "_fragment_shader.glsl")) {
         cout << "error adding fragment shader from source file" << endl;
         return false;
     }
@@ -286,6 +530,34 @@ bool RenderingEngine::initShaderProgram(QOpenGLShaderProgram *program, QString s
     return true;
 }
 
+bool RenderingEngine::initInstanceBuffer()
+{
+    // std140 layout: MAX_INSTANCES row-major mat4 followed by MAX_INSTANCES vec4
+    instanceData.assign(MAX_INSTANCES*16 + MAX_INSTANCES*4, 0.0f);
+    
+    glGenBuffers(1, &instanceBufferID);
+    glBindBuffer(GL_UNIFORM_BUFFER, instanceBufferID);
+    glBufferData(GL_UNIFORM_BUFFER, instanceData.size()*sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    
+    GLuint blockIndex = glGetUniformBlockIndex(silhouetteInstancedShaderProgram->programId(), "Instances");
+    if(blockIndex == GL_INVALID_INDEX)
+    {
+        cout << "error finding the uniform block of instances" << endl;
+        return false;
+    }
+    glUniformBlockBinding(silhouetteInstancedShaderProgram->programId(), blockIndex, 0);
+    
+    return true;
+}
+
+
+int RenderingEngine::getMaxInstancesPerBatch()
+{
+    return MAX_INSTANCES;
+}
+
+
 void RenderingEngine::renderSilhouette(Model* model, GLenum polyonMode, bool invertDepth, float r, float g, float b, bool drawAll)
 {
     vector<Model*> models;
@@ -321,6 +593,8 @@ void RenderingEngine::renderNormals(Model* model, GLenum polyonMode, bool drawAl
 
 void RenderingEngine::renderSilhouette(vector<Model*> models, GLenum polyonMode, bool invertDepth, const std::vector<cv::Point3f>& colors, bool drawAll)
 {
+    RBOT_PROFILE_SCOPE("renderSilhouette");
+    
     glViewport(0, 0, width, height);
     
     if(invertDepth)
@@ -331,6 +605,11 @@ void RenderingEngine::renderSilhouette(vector<Model*> models, GLenum polyonMode,
     
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
     
+    silhouetteShaderProgram->bind();
+    silhouetteShaderProgram->setUniformValue("uAlpha", 1.0f);
+    
+    glPolygonMode(GL_FRONT_AND_BACK, polyonMode);
+    
     for(int i = 0; i < models.size(); i++)
     {
         Model* model = models[i];
@@ -340,13 +619,11 @@ void RenderingEngine::renderSilhouette(vector<Model*> models, GLenum polyonMode,
             Matx44f pose = model->getPose();
             Matx44f normalization = model->getNormalization();
             
-            Matx44f modelViewMatrix = lookAtMatrix*(pose*normalization);
+            Matx44f modelViewMatrix = lookAtMatrix*(pose*normalization*model->getDequantization());
             
             Matx44f modelViewProjectionMatrix = projectionMatrix*modelViewMatrix;
             
-            silhouetteShaderProgram->bind();
             silhouetteShaderProgram->setUniformValue("uMVPMatrix", QMatrix4x4(modelViewProjectionMatrix.val));
-            silhouetteShaderProgram->setUniformValue("uAlpha", 1.0f);
             
             Point3f color;
             if(i < colors.size())
@@ -359,16 +636,241 @@ void RenderingEngine::renderSilhouette(vector<Model*> models, GLenum polyonMode,
             }
             silhouetteShaderProgram->setUniformValue("uColor", QVector3D(color.x, color.y, color.z));
             
-            glPolygonMode(GL_FRONT_AND_BACK, polyonMode);
-            
-            model->draw(silhouetteShaderProgram);
+            // coarse pyramid levels do not resolve the details of the full mesh
+            model->draw(silhouetteShaderProgram, GL_TRIANGLES, model->selectLOD(calibrationMatrices[currentLevel](0, 0)));
         }
     }
     
     glClearDepth(0.0f);
     glDepthFunc(GL_GREATER);
     
-    glFinish();
+    readBackSilhouette();
+}
+
+
+void RenderingEngine::renderSilhouetteInstanced(Model *model, const vector<Matx44f> &poses, GLenum polyonMode, bool invertDepth, const vector<Point3f> &colors)
+{
+    RBOT_PROFILE_SCOPE("renderSilhouetteInstanced");
+    
+    glViewport(0, 0, width, height);
+    
+    if(invertDepth)
+    {
+        glClearDepth(1.0f);
+        glDepthFunc(GL_LESS);
+    }
+    
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    
+    glPolygonMode(GL_FRONT_AND_BACK, polyonMode);
+    
+    if(instancingEnabled)
+        drawInstances(model, poses, colors, 1, 1);
+    else
+        drawPosesSeparately(model, poses, colors);
+    
+    glClearDepth(0.0f);
+    glDepthFunc(GL_GREATER);
+    
+    readBackSilhouette();
+}
+
+
+bool RenderingEngine::renderSilhouetteAtlas(Model *model, const vector<Matx44f> &poses, GLenum polyonMode, const vector<Point3f> &colors)
+{
+    RBOT_PROFILE_SCOPE("renderSilhouetteAtlas");
+    
+    // the tiles are placed by the instanced program, callers render each pose on its own without it
+    if(poses.empty() || !instancingEnabled || !silhouetteInstancedShaderProgram->isLinked())
+        return false;
+    
+    GLint maxSize[2];
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxSize);
+    
+    // arrange the tiles in a roughly square grid that fits into a single viewport
+    int numTiles = (int)poses.size();
+    int tilesX = std::min((int)ceil(sqrt((float)numTiles)), maxSize[0]/width);
+    int tilesY = (numTiles + tilesX - 1)/tilesX;
+    
+    if(tilesX*width > maxSize[0] || tilesY*height > maxSize[1])
+    {
+        cout << "error rendering " << numTiles << " tiles of size " << width << "x" << height << " into a single atlas" << endl;
+        return false;
+    }
+    
+    // only grow the atlas, smaller grids use its lower left part
+    if(atlasTarget.width < tilesX*width || atlasTarget.height < tilesY*height)
+    {
+        int atlasWidth = std::max(atlasTarget.width, tilesX*width);
+        int atlasHeight = std::max(atlasTarget.height, tilesY*height);
+        
+        deleteRenderTarget(atlasTarget);
+        
+        if(!createRenderTarget(atlasTarget, atlasWidth, atlasHeight, false))
+        {
+            cout << "error creating rendering buffers for the atlas" << endl;
+            deleteRenderTarget(atlasTarget);
+            glBindFramebuffer(GL_FRAMEBUFFER, renderTargets[currentLevel].frameBufferID);
+            return false;
+        }
+    }
+    
+    atlasTileWidth = width;
+    atlasTileHeight = height;
+    atlasTilesX = tilesX;
+    atlasNumTiles = numTiles;
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, atlasTarget.frameBufferID);
+    
+    glViewport(0, 0, tilesX*width, tilesY*height);
+    
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    
+    glPolygonMode(GL_FRONT_AND_BACK, polyonMode);
+    
+    // restrict every instance to its own tile
+    for(int i = 0; i < 4; i++)
+        glEnable(GL_CLIP_DISTANCE0 + i);
+    
+    drawInstances(model, poses, colors, tilesX, tilesY);
+    
+    for(int i = 0; i < 4; i++)
+        glDisable(GL_CLIP_DISTANCE0 + i);
+    
+    insertFence(atlasTarget);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTargets[currentLevel].frameBufferID);
+    
+    return true;
+}
+
+
+void RenderingEngine::drawInstances(Model *model, const vector<Matx44f> &poses, const vector<Point3f> &colors, int tilesX, int tilesY)
+{
+    silhouetteInstancedShaderProgram->bind();
+    silhouetteInstancedShaderProgram->setUniformValue("uAlpha", 1.0f);
+    silhouetteInstancedShaderProgram->setUniformValue("uTilesX", tilesX);
+    silhouetteInstancedShaderProgram->setUniformValue("uTilesY", tilesY);
+    
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, instanceBufferID);
+    
+    Matx44f normalization = model->getNormalization()*model->getDequantization();
+    
+    Point3f defaultColor = Point3f((float)(model->getModelID())/255.0f, 0.0f, 0.0f);
+    
+    // the closest instance determines the level of detail
+    int lod = model->getNumLODs();
+    for(int i = 0; i < poses.size(); i++)
+    {
+        lod = std::min(lod, model->selectLOD(calibrationMatrices[currentLevel](0, 0), poses[i]));
+    }
+    
+    for(int start = 0; start < poses.size(); start += MAX_INSTANCES)
+    {
+        int numInstances = std::min(MAX_INSTANCES, (int)poses.size() - start);
+        
+        float *mvpData = instanceData.data();
+        float *colorData = instanceData.data() + MAX_INSTANCES*16;
+        
+        for(int i = 0; i < numInstances; i++)
+        {
+            Matx44f modelViewProjectionMatrix = projectionMatrix*(lookAtMatrix*(poses[start + i]*normalization));
+            
+            memcpy(mvpData + 16*i, modelViewProjectionMatrix.val, 16*sizeof(float));
+            
+            Point3f color = (start + i < colors.size()) ? colors[start + i] : defaultColor;
+            colorData[4*i] = color.x;
+            colorData[4*i + 1] = color.y;
+            colorData[4*i + 2] = color.z;
+            colorData[4*i + 3] = 1.0f;
+        }
+        
+        // only upload the part of both arrays that is actually used
+        glBindBuffer(GL_UNIFORM_BUFFER, instanceBufferID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, numInstances*16*sizeof(float), mvpData);
+        glBufferSubData(GL_UNIFORM_BUFFER, MAX_INSTANCES*16*sizeof(float), numInstances*4*sizeof(float), colorData);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        
+        silhouetteInstancedShaderProgram->setUniformValue("uFirstInstance", start);
+        
+        model->drawInstanced(silhouetteInstancedShaderProgram, numInstances, this, GL_TRIANGLES, lod);
+    }
+}
+
+
+void RenderingEngine::drawPosesSeparately(Model *model, const vector<Matx44f> &poses, const vector<Point3f> &colors)
+{
+    silhouetteShaderProgram->bind();
+    silhouetteShaderProgram->setUniformValue("uAlpha", 1.0f);
+    
+    Matx44f normalization = model->getNormalization()*model->getDequantization();
+    
+    Point3f defaultColor = Point3f((float)(model->getModelID())/255.0f, 0.0f, 0.0f);
+    
+    for(int i = 0; i < poses.size(); i++)
+    {
+        Matx44f modelViewProjectionMatrix = projectionMatrix*(lookAtMatrix*(poses[i]*normalization));
+        
+        silhouetteShaderProgram->setUniformValue("uMVPMatrix", QMatrix4x4(modelViewProjectionMatrix.val));
+        
+        Point3f color = (i < colors.size()) ? colors[i] : defaultColor;
+        silhouetteShaderProgram->setUniformValue("uColor", QVector3D(color.x, color.y, color.z));
+        
+        model->draw(silhouetteShaderProgram, GL_TRIANGLES, model->selectLOD(calibrationMatrices[currentLevel](0, 0), poses[i]));
+    }
+}
+
+
+Mat RenderingEngine::downloadAtlas(RenderingEngine::FrameType type, vector<Mat> &tiles)
+{
+    RBOT_PROFILE_SCOPE("downloadAtlas");
+    
+    tiles.clear();
+    
+    if(atlasNumTiles == 0)
+        return Mat();
+    
+    waitForFence(atlasTarget);
+    
+    int tilesY = (atlasNumTiles + atlasTilesX - 1)/atlasTilesX;
+    
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, atlasTarget.frameBufferID);
+    
+    Mat res;
+    switch (type)
+    {
+        case MASK:
+            res = Mat(tilesY*atlasTileHeight, atlasTilesX*atlasTileWidth, CV_8UC1);
+            glReadPixels(0, 0, res.cols, res.rows, GL_RED, GL_UNSIGNED_BYTE, res.data);
+            break;
+        case RGB:
+            res = Mat(tilesY*atlasTileHeight, atlasTilesX*atlasTileWidth, CV_8UC3);
+            glReadPixels(0, 0, res.cols, res.rows, GL_RGB, GL_UNSIGNED_BYTE, res.data);
+            break;
+        case RGB_32F:
+            res = Mat(tilesY*atlasTileHeight, atlasTilesX*atlasTileWidth, CV_32FC3);
+            glReadPixels(0, 0, res.cols, res.rows, GL_RGB, GL_FLOAT, res.data);
+            break;
+        case DEPTH:
+            res = Mat(tilesY*atlasTileHeight, atlasTilesX*atlasTileWidth, CV_32FC1);
+            glReadPixels(0, 0, res.cols, res.rows, GL_DEPTH_COMPONENT, GL_FLOAT, res.data);
+            break;
+        default:
+            res = Mat::zeros(tilesY*atlasTileHeight, atlasTilesX*atlasTileWidth, CV_8UC1);
+            break;
+    }
+    
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, renderTargets[currentLevel].frameBufferID);
+    
+    for(int i = 0; i < atlasNumTiles; i++)
+    {
+        int x = i%atlasTilesX;
+        int y = i/atlasTilesX;
+        
+        tiles.push_back(res(Rect(x*atlasTileWidth, y*atlasTileHeight, atlasTileWidth, atlasTileHeight)));
+    }
+    
+    return res;
 }
 
 
@@ -391,6 +893,9 @@ void RenderingEngine::renderShaded(vector<Model*> models, GLenum polyonMode, con
             
             Matx33f normalMatrix = modelViewMatrix.get_minor<3, 3>(0, 0).inv().t();
             
+            // the normals are not quantized, only the positions
+            modelViewMatrix = modelViewMatrix*model->getDequantization();
+            
             Matx44f modelViewProjectionMatrix = projectionMatrix*modelViewMatrix;
             
             phongblinnShaderProgram->bind();
@@ -420,7 +925,7 @@ void RenderingEngine::renderShaded(vector<Model*> models, GLenum polyonMode, con
         }
     }
     
-    glFinish();
+    insertFence();
 }
 
 void RenderingEngine::renderNormals(vector<Model*> models, GLenum polyonMode, bool drawAll)
@@ -442,6 +947,9 @@ void RenderingEngine::renderNormals(vector<Model*> models, GLenum polyonMode, bo
             
             Matx33f normalMatrix = modelViewMatrix.get_minor<3, 3>(0, 0).inv().t();
             
+            // the normals are not quantized, only the positions
+            modelViewMatrix = modelViewMatrix*model->getDequantization();
+            
             Matx44f modelViewProjectionMatrix = projectionMatrix*modelViewMatrix;
             
             normalsShaderProgram->bind();
@@ -456,48 +964,41 @@ void RenderingEngine::renderNormals(vector<Model*> models, GLenum polyonMode, bo
         }
     }
     
-    glFinish();
+    insertFence();
 }
 
 
 void RenderingEngine::projectBoundingBox(Model* model, std::vector<cv::Point2f>& projections, cv::Rect& boundingRect)
 {
-    Vec3f lbn = model->getLBN();
-    Vec3f rtf = model->getRTF();
-    
-    Vec4f Plbn = Vec4f(lbn[0], lbn[1], lbn[2], 1.0);
-    Vec4f Prbn = Vec4f(rtf[0], lbn[1], lbn[2], 1.0);
-    Vec4f Pltn = Vec4f(lbn[0], rtf[1], lbn[2], 1.0);
-    Vec4f Plbf = Vec4f(lbn[0], lbn[1], rtf[2], 1.0);
-    Vec4f Pltf = Vec4f(lbn[0], rtf[1], rtf[2], 1.0);
-    Vec4f Prtn = Vec4f(rtf[0], rtf[1], lbn[2], 1.0);
-    Vec4f Prbf = Vec4f(rtf[0], lbn[1], rtf[2], 1.0);
-    Vec4f Prtf = Vec4f(rtf[0], rtf[1], rtf[2], 1.0);
-    
-    vector<Vec4f> points3D;
-    points3D.push_back(Plbn);
-    points3D.push_back(Prbn);
-    points3D.push_back(Pltn);
-    points3D.push_back(Plbf);
-    points3D.push_back(Pltf);
-    points3D.push_back(Prtn);
-    points3D.push_back(Prbf);
-    points3D.push_back(Prtf);
-    
-    Matx44f pose = model->getPose();
-    Matx44f normalization = model->getNormalization();
+    const Vec3f &lbn = model->getLBN();
+    const Vec3f &rtf = model->getRTF();
+    
+    vector<Vec3f> points3D;
+    points3D.push_back(Vec3f(lbn[0], lbn[1], lbn[2]));
+    points3D.push_back(Vec3f(rtf[0], lbn[1], lbn[2]));
+    points3D.push_back(Vec3f(lbn[0], rtf[1], lbn[2]));
+    points3D.push_back(Vec3f(lbn[0], lbn[1], rtf[2]));
+    points3D.push_back(Vec3f(lbn[0], rtf[1], rtf[2]));
+    points3D.push_back(Vec3f(rtf[0], rtf[1], lbn[2]));
+    points3D.push_back(Vec3f(rtf[0], lbn[1], rtf[2]));
+    points3D.push_back(Vec3f(rtf[0], rtf[1], rtf[2]));
+    
+    VertexProjection corners(points3D);
+    
+    Matx44f T_cm = model->getPose()*model->getNormalization();
+    
+    float x[8], y[8], z[8];
+    corners.project(T_cm, getCalibrationMatrix3x3(), 0, 8, x, y, z);
     
     Point2f lt(FLT_MAX, FLT_MAX);
     Point2f rb(-FLT_MAX, -FLT_MAX);
     
-    for(int i = 0; i < points3D.size(); i++)
+    for(int i = 0; i < 8; i++)
     {
-        Vec4f p = calibrationMatrices[currentLevel]*pose*normalization*points3D[i];
-        
-        if(p[2] == 0)
+        if(z[i] == 0)
             continue;
         
-        Point2f p2d = Point2f(p[0]/p[2], p[1]/p[2]);
+        Point2f p2d = Point2f(x[i], y[i]);
         projections.push_back(p2d);
         
         if(p2d.x < lt.x) lt.x = p2d.x;
@@ -512,9 +1013,140 @@ void RenderingEngine::projectBoundingBox(Model* model, std::vector<cv::Point2f>&
     boundingRect.height = rb.y - lt.y;
 }
 
+
+bool RenderingEngine::projectConvexHull(Model* model, std::vector<cv::Point2f>& projections, cv::Rect& boundingRect)
+{
+    const VertexProjection &hull = model->getConvexHullProjection();
+    
+    int numPoints = hull.getNumPoints();
+    
+    vector<float> x(numPoints), y(numPoints), z(numPoints);
+    if(numPoints > 0)
+    {
+        hull.project(model->getPose()*model->getNormalization(), getCalibrationMatrix3x3(), 0, numPoints, x.data(), y.data(), z.data());
+    }
+    
+    Point2f lt(FLT_MAX, FLT_MAX);
+    Point2f rb(-FLT_MAX, -FLT_MAX);
+    
+    for(int i = 0; i < numPoints; i++)
+    {
+        if(z[i] <= 0)
+            return false;
+        
+        Point2f p2d = Point2f(x[i], y[i]);
+        projections.push_back(p2d);
+        
+        if(p2d.x < lt.x) lt.x = p2d.x;
+        if(p2d.x > rb.x) rb.x = p2d.x;
+        if(p2d.y < lt.y) lt.y = p2d.y;
+        if(p2d.y > rb.y) rb.y = p2d.y;
+    }
+    
+    boundingRect.x = floor(lt.x);
+    boundingRect.y = floor(lt.y);
+    boundingRect.width = ceil(rb.x) - boundingRect.x;
+    boundingRect.height = ceil(rb.y) - boundingRect.y;
+    
+    return !projections.empty();
+}
+
+void RenderingEngine::insertFence()
+{
+    insertFence(renderTargets[currentLevel]);
+}
+
+
+void RenderingEngine::insertFence(RenderTarget &target)
+{
+    // any rendering replaces the frame the pixel buffers were read from
+    target.pixelBuffersValid = false;
+    
+    if(target.fence)
+        glDeleteSync(target.fence);
+    
+    target.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    
+    // submit the commands without waiting for them, so the GPU can work while the CPU continues
+    glFlush();
+}
+
+
+void RenderingEngine::readBackSilhouette()
+{
+    RenderTarget &target = renderTargets[currentLevel];
+    
+    // the transfers into the pixel buffers are queued behind the rendering and do not block
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, target.maskBufferID);
+    glReadPixels(0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, 0);
+    
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, target.depthBufferID);
+    glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+    
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    insertFence(target);
+    
+    target.pixelBuffersValid = true;
+}
+
+
+void RenderingEngine::waitForFence(RenderTarget &target)
+{
+    if(!target.fence)
+        return;
+    
+    GLenum result = glClientWaitSync(target.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    
+    if(result == GL_WAIT_FAILED)
+    {
+        cout << "error waiting for rendering to complete" << endl;
+    }
+    
+    glDeleteSync(target.fence);
+    target.fence = 0;
+}
+
+
+void RenderingEngine::sync()
+{
+    for(int l = 0; l < renderTargets.size(); l++)
+    {
+        waitForFence(renderTargets[l]);
+    }
+    waitForFence(atlasTarget);
+}
+
+
 Mat RenderingEngine::downloadFrame(RenderingEngine::FrameType type)
 {
+    RBOT_PROFILE_SCOPE("downloadFrame");
+    
+    RenderTarget &target = renderTargets[currentLevel];
+    
+    waitForFence(target);
+    
     Mat res;
+    
+    if(target.pixelBuffersValid && (type == MASK || type == DEPTH))
+    {
+        res = (type == MASK) ? Mat(height, width, CV_8UC1) : Mat(height, width, CV_32FC1);
+        
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, (type == MASK) ? target.maskBufferID : target.depthBufferID);
+        
+        void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, res.total()*res.elemSize(), GL_MAP_READ_BIT);
+        if(data)
+        {
+            memcpy(res.data, data, res.total()*res.elemSize());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            
+            return res;
+        }
+        
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    
     switch (type)
     {
         case MASK:
@@ -40,6 +40,7 @@
 
 #include <QOpenGLContext>
 #include <QOffscreenSurface>
+#include <QThread>
 
 #include <QGLFramebufferObject>
 #include <QOpenGLShaderProgram>
@@ -51,13 +52,62 @@
 #include "transformations.h"
 #include "model.h"
 
+/**
+ *  The offscreen render target of a single pyramid level, i.e. a frame buffer
+ *  object with color and depth textures of exactly the size of that level and
+ *  a fence signaled once the most recent rendering into it has completed.
+ *  Silhouette renderings are additionally copied into pixel buffers for the
+ *  mask and the depth map right away, so that downloadFrame() only has to map
+ *  them once the fence has been signaled.
+ */
+struct RenderTarget
+{
+    int width;
+    int height;
+    
+    GLuint frameBufferID;
+    GLuint colorTextureID;
+    GLuint depthTextureID;
+    
+    // pixel pack buffers of the mask (uchar) and the depth map (float)
+    GLuint maskBufferID;
+    GLuint depthBufferID;
+    
+    // whether the pixel buffers hold the most recent rendering
+    bool pixelBuffersValid;
+    
+    GLsync fence;
+};
+
+/**
+ *  The state of a single camera of the rendering engine, i.e. its image
+ *  resolution, projection and per level intrinsics as well as its own set
+ *  of render targets for all pyramid levels.
+ */
+struct CameraSetup
+{
+    int fullWidth;
+    int fullHeight;
+    
+    cv::Matx44f projectionMatrix;
+    
+    std::vector<cv::Matx44f> calibrationMatrices;
+    
+    std::vector<RenderTarget> renderTargets;
+};
+
 /**
  *  This class implements an OpenGL-based offscreen rendering engine for generating
  *  images of projected 3D meshes based on given object poses and camera instrinsics.
  *  It supports one or mutiple objects to be rendered as binary masks, depth maps,
  *  normal maps or phong-shaded. It also allows to perform all renderings according
- *  to a specified image pyramid level at lower resolutions. The class is  implemented
- *  as a singleton.
+ *  to a specified image pyramid level at lower resolutions. A process-wide instance
+ *  is provided by Instance(), but further engines can be created, each with its own
+ *  offscreen surface and OpenGL context, e.g. to run independent trackers in parallel
+ *  threads. The shaders are embedded as Qt resources (shaders.qrc), unless
+ *  the environment variable RBOT_SHADER_DIR names a folder to load them from, and
+ *  their linked programs are kept in Qt's shader disk cache across runs (which can
+ *  be turned off by setting QT_DISABLE_SHADER_DISK_CACHE).
  */
 class RenderingEngine : public QOpenGLFunctions_3_3_Core
 {
@@ -69,10 +119,25 @@ public:
         DEPTH
     };
     
+    /**
+     *  Creates a rendering engine with its own offscreen surface and OpenGL
+     *  context. Must be called from the GUI thread, since the offscreen surface
+     *  is a platform window on some systems (see moveToThread()).
+     */
     RenderingEngine(void);
     
+    /**
+     *  Releases all OpenGL resources and the context of the engine. Must be
+     *  called from the thread the context belongs to.
+     */
     ~RenderingEngine(void);
     
+    /**
+     *  Returns the process-wide rendering engine, which is created on the first
+     *  call. This instance is released with destroy().
+     *
+     *  @return  The process-wide rendering engine.
+     */
     static RenderingEngine *Instance(void)
     {
         if (instance == NULL) instance = new RenderingEngine();
@@ -97,6 +162,43 @@ public:
      */
     void init(const cv::Matx33f &K, int width, int height, float zNear, float zFar, int numLevels);
     
+    /**
+     *  Adds another camera with its own intrinsics, image resolution and render
+     *  targets for all pyramid levels, e.g. for rendering the same objects into
+     *  the images of several calibrated cameras. The camera created by init()
+     *  has the index 0 and all cameras share the near and far plane. Must be
+     *  called after init() while the OpenGL context of the engine is active.
+     *
+     *  @param  K The intrinsic camera matrix.
+     *  @param  width The width in pixels of the rendered images at level 0.
+     *  @param  height The height in pixels of the rendered images at level 0.
+     *  @return The index of the new camera.
+     */
+    int addCamera(const cv::Matx33f &K, int width, int height);
+    
+    /**
+     *  Selects the camera used for all subsequent renderings, projections and
+     *  frame downloads and binds its frame buffer object at the current pyramid
+     *  level. Must be called while the OpenGL context of the engine is active.
+     *
+     *  @param  camera The index of the camera.
+     */
+    void setCamera(int camera);
+    
+    /**
+     *  Returns the index of the camera currently used for rendering.
+     *
+     *  @return  The index of the current camera.
+     */
+    int getCamera();
+    
+    /**
+     *  Returns the number of cameras of the engine.
+     *
+     *  @return  The number of cameras.
+     */
+    int getNumCameras();
+    
     /**
      *  Returns the number of supported pyramid levels for rendering.
      *
@@ -106,7 +208,9 @@ public:
     
     /**
      *  Sets a pyramid level to be used for rendering between 0 (full resolution)
-     *  and getNumLevels() (the smallest resolution).
+     *  and getNumLevels() (the smallest resolution) and binds the corresponding
+     *  frame buffer object. Must be called while the OpenGL context of the engine
+     *  is active.
      *
      *  @param level The pyramid level to be used for rendering.
      */
@@ -119,6 +223,15 @@ public:
      */
     int getLevel();
     
+    /**
+     *  Hands the OpenGL context of the engine over to another thread, which is
+     *  required before it can be made current there. Must be called from the
+     *  thread the context currently belongs to while it is not active.
+     *
+     *  @param  thread The thread that will use the engine from now on.
+     */
+    void moveToThread(QThread *thread);
+    
     /**
      *  Activates the OpenGL context of the rendering engine.
      */
@@ -137,21 +250,24 @@ public:
     QOpenGLContext *getContext();
     
     /**
-     *  Returns the OpenGL ID of the frame buffer object used for offscreen rendering.
+     *  Returns the OpenGL ID of the frame buffer object used for offscreen rendering
+     *  at the current pyramid level.
      *
      *  @return  The OpenGL ID of the frame buffer object used for offscreen rendering.
      */
     GLuint getFrameBufferID();
     
     /**
-     *  Returns the OpenGL texture ID of the rendered color image.
+     *  Returns the OpenGL texture ID of the rendered color image at the current
+     *  pyramid level.
      *
      *  @return  The OpenGL texture ID of the rendered color image.
      */
     GLuint getColorTextureID();
     
     /**
-     *  Returns the OpenGL texture ID of the rendered depth buffer.
+     *  Returns the OpenGL texture ID of the rendered depth buffer at the current
+     *  pyramid level.
      *
      *  @return  The OpenGL texture ID of the rendered depth buffer.
      */
@@ -185,6 +301,14 @@ public:
      */
     cv::Matx44f getCalibrationMatrix();
     
+    /**
+     *  Returns the 3x3 intrinsic camera matrix wrt the current pyramid level,
+     *  i.e. the upper left part of getCalibrationMatrix().
+     *
+     *  @return  The intrinsic camera matrix wrt the current pyramid level.
+     */
+    cv::Matx33f getCalibrationMatrix3x3();
+    
     /**
      *  Renders a single model with a constant color and no shading in order to
      *  obtain a binary silhouette mask of it wrt its current pose.
@@ -235,6 +359,60 @@ public:
      */
     void renderSilhouette(std::vector<Model*> models, GLenum polyonMode, bool invertDepth = false, const std::vector<cv::Point3f> &colors = std::vector<cv::Point3f>(), bool drawAll = false);
     
+    /**
+     *  Renders multiple instances of the same model in a common scene with a constant color
+     *  per instance and no shading, e.g. for rendering several pose hypotheses at once. The
+     *  poses and colors of the instances are uploaded into a uniform buffer, so that all
+     *  instances are drawn with a single draw call per batch of at most
+     *  getMaxInstancesPerBatch() instances. If no colors are specified, each instance will
+     *  be rendered with a constant color corresponding to the model index in the red channel.
+     *  If the instanced shader program is not available, the instances are drawn one by one.
+     *
+     *  @param model The model to be rendered.
+     *  @param poses The 6DOF poses of all instances of the model.
+     *  @param polyonMode The OpenGL polygon mode to be used (e.g. GL_FILL).
+     *  @param invertDepth Whether to invert the depth test during rendering (default = false).
+     *  @param colors A vector of colors to be used for each instance (default = empty).
+     */
+    void renderSilhouetteInstanced(Model *model, const std::vector<cv::Matx44f> &poses, GLenum polyonMode, bool invertDepth = false, const std::vector<cv::Point3f> &colors = std::vector<cv::Point3f>());
+    
+    /**
+     *  Renders multiple pose hypotheses of the same model into the tiles of a single
+     *  offscreen atlas in one pass, where each tile has the size of the current pyramid
+     *  level and shows one hypothesis as if it had been rendered on its own with
+     *  renderSilhouetteInstanced(). The tiles are arranged in a roughly square grid in
+     *  row-major order starting at the first row of the downloaded image. The frame buffer
+     *  object of the current pyramid level remains bound for all other render methods.
+     *
+     *  @param model The model to be rendered.
+     *  @param poses The 6DOF pose hypotheses, one per tile.
+     *  @param polyonMode The OpenGL polygon mode to be used (e.g. GL_FILL).
+     *  @param colors A vector of colors to be used for each hypothesis (default = empty).
+     *
+     *  @return  False if instanced rendering is unavailable or the atlas could not be created or does not fit into a single viewport.
+     */
+    bool renderSilhouetteAtlas(Model *model, const std::vector<cv::Matx44f> &poses, GLenum polyonMode, const std::vector<cv::Point3f> &colors = std::vector<cv::Point3f>());
+    
+    /**
+     *  Downloads the most recently rendered atlas of pose hypotheses from the GPU with a
+     *  single read back and converts it to an OpenCV image depending on a given frame type
+     *  (see downloadFrame()).
+     *
+     *  @param type The frame type to be downloaded and returned (e.g. MASK or DEPTH).
+     *  @param tiles The resulting per hypothesis views into the returned atlas image.
+     *
+     *  @return  The whole atlas image according to the desired frame type.
+     */
+    cv::Mat downloadAtlas(RenderingEngine::FrameType type, std::vector<cv::Mat> &tiles);
+    
+    /**
+     *  Returns the maximum number of instances drawn with a single draw call, as limited
+     *  by the size of the uniform buffer of poses.
+     *
+     *  @return  The maximum number of instances per draw call.
+     */
+    int getMaxInstancesPerBatch();
+    
     /**
      *  Renders a multiple models in a common scene wrt their current poses using Phong shading.
      *
@@ -266,9 +444,33 @@ public:
      */
     void projectBoundingBox(Model *model, std::vector<cv::Point2f> &projections, cv::Rect &boundingRect);
     
+    /**
+     *  Projects the vertices of a model's convex hull into the image and computes the
+     *  enclosing 2D bounding rect of these projections wrt the model's pose, which is the
+     *  tight bounding rect of the model's silhouette.
+     *
+     *  @param model The model of which the convex hull is to be projected.
+     *  @param projections The resulting 2D coordinates of the projected hull vertices.
+     *  @param boundingRect The resulting 2D bounding rect of the 2D projections.
+     *
+     *  @return  False if a hull vertex lies behind the camera and true otherwise.
+     */
+    bool projectConvexHull(Model *model, std::vector<cv::Point2f> &projections, cv::Rect &boundingRect);
+    
+    /**
+     *  Blocks until all previously issued rendering commands of all pyramid levels
+     *  have been completed by the GPU. All render methods return as soon as their
+     *  commands have been submitted, so this is only required when the rendered
+     *  textures are accessed by other means than downloadFrame().
+     */
+    void sync();
+    
     /**
      *  Downloads the most recently rendered image from the GPU to the host memory and converts
-     *  it to an OpenCV image depending on a given frametype. Use MASK to obtain a silhouette
+     *  it to an OpenCV image depending on a given frametype. This only waits for the rendering
+     *  into the current pyramid level to be completed. After a silhouette rendering, MASK and
+     *  DEPTH have already been transferred into pixel buffers in the background and are only
+     *  mapped and copied here. Use MASK to obtain a silhouette
      *  mask image (single channel, uchar), RGB to obtain a color image (RGB, uchar), RGB_32F
      *  to obtain color image with normalized intensities in [0, 1] (RGB, float) or DEPTH to
      *  obtain the depth buffer.
@@ -280,7 +482,9 @@ public:
     cv::Mat downloadFrame(RenderingEngine::FrameType type);
     
     /**
-     *  Destroys and deletes the current rendering engine singleton instance.
+     *  Destroys and deletes the process-wide rendering engine instance, so that
+     *  the next call of Instance() creates a new one. Engines that have been
+     *  created directly are not affected and must be deleted instead.
      */
     void destroy();
 
@@ -308,9 +512,11 @@ private:
     QOffscreenSurface *surface;
     QOpenGLContext *glContext;
     
-    GLuint frameBufferID;
-    GLuint colorTextureID;
-    GLuint depthTextureID;
+    std::vector<RenderTarget> renderTargets;
+    
+    // the setups of all cameras, of which the current one is held in the members above while it is selected
+    std::vector<CameraSetup> cameras;
+    int currentCamera;
     
     int angle;
     
@@ -320,11 +526,46 @@ private:
     QOpenGLShaderProgram *silhouetteShaderProgram;
     QOpenGLShaderProgram *phongblinnShaderProgram;
     QOpenGLShaderProgram *normalsShaderProgram;
+    QOpenGLShaderProgram *silhouetteInstancedShaderProgram;
+    
+    // uniform buffer of instance MVP matrices and colors (layout of the block 'Instances')
+    GLuint instanceBufferID;
+    
+    // false if the instanced shader program or its uniform block is unavailable
+    bool instancingEnabled;
+    std::vector<float> instanceData;
+    
+    // offscreen target of renderSilhouetteAtlas() and the layout of its most recent rendering
+    RenderTarget atlasTarget;
+    int atlasTileWidth;
+    int atlasTileHeight;
+    int atlasTilesX;
+    int atlasNumTiles;
     
     bool initRenderingBuffers();
     
+    void deleteRenderingBuffers();
+    
+    bool createRenderTarget(RenderTarget &target, int width, int height, bool pixelBuffers = true);
+    
+    void deleteRenderTarget(RenderTarget &target);
+    
+    void insertFence();
+    
+    void insertFence(RenderTarget &target);
+    
+    void readBackSilhouette();
+    
+    void waitForFence(RenderTarget &target);
+    
     bool initShaderProgram(QOpenGLShaderProgram *program, QString shaderName);
     
+    bool initInstanceBuffer();
+    
+    void drawInstances(Model *model, const std::vector<cv::Matx44f> &poses, const std::vector<cv::Point3f> &colors, int tilesX, int tilesY);
+    
+    void drawPosesSeparately(Model *model, const std::vector<cv::Matx44f> &poses, const std::vector<cv::Point3f> &colors);
+    
 };
 
 
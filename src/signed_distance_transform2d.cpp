@@ -34,6 +34,7 @@
  */
 
 #include "signed_distance_transform2d.h"
+#include "profiler.h"
 
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -54,6 +55,8 @@ SignedDistanceTransform2D::~SignedDistanceTransform2D()
 
 void SignedDistanceTransform2D::computeTransform(const Mat &src, Mat &sdt, Mat &xyPos, int threads, uchar key)
 {
+    RBOT_PROFILE_SCOPE("signedDistanceTransform");
+    
     sdt.create(src.size(), CV_32FC1);
     Mat dd(src.size(), CV_32SC1);
     Mat xPos(src.size(), CV_32SC1);
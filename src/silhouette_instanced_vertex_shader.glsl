@@ -0,0 +1,79 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#version 330
+
+#define MAX_INSTANCES 128
+
+layout(std140, row_major) uniform Instances
+{
+	mat4 uMVPMatrices[MAX_INSTANCES];
+	vec4 uColors[MAX_INSTANCES];
+};
+
+// index of the first instance of the current batch within the whole draw
+uniform int uFirstInstance;
+
+// grid of tiles of an atlas with one instance per tile (1x1 for a common scene)
+uniform int uTilesX;
+uniform int uTilesY;
+
+in vec3 aPosition;
+
+flat out vec3 vColor;
+
+out float gl_ClipDistance[4];
+
+
+void main()
+{
+	// vertex position according to the pose of the instance
+	vec4 position = uMVPMatrices[gl_InstanceID] * vec4(aPosition, 1.0);
+	
+	// clip against the boundaries of the tile
+	gl_ClipDistance[0] = position.w + position.x;
+	gl_ClipDistance[1] = position.w - position.x;
+	gl_ClipDistance[2] = position.w + position.y;
+	gl_ClipDistance[3] = position.w - position.y;
+	
+	// move the normalized device coordinates into the tile of the instance
+	int tile = uFirstInstance + gl_InstanceID;
+	vec2 scale = vec2(1.0/float(uTilesX), 1.0/float(uTilesY));
+	vec2 offset = (2.0*vec2(tile % uTilesX, (tile / uTilesX) % uTilesY) + 1.0)*scale - 1.0;
+	
+	gl_Position = vec4(position.xy*scale + offset*position.w, position.zw);
+	
+	vColor = uColors[gl_InstanceID].rgb;
+}
@@ -35,6 +35,7 @@
 
 #include "tclc_histograms.h"
 #include "model.h"
+#include "profiler.h"
 
 using namespace std;
 using namespace cv;
@@ -67,6 +68,8 @@ TCLCHistograms::~TCLCHistograms()
 
 void TCLCHistograms::update(const Mat &frame, const Mat &mask, const Mat &depth, Matx33f &K, float zNear, float zFar)
 {
+    RBOT_PROFILE_SCOPE("histogramUpdate");
+    
     _centersIDs = parallelComputeLocalHistogramCenters(mask, depth, K, zNear, zFar, 0);
     
     filterHistogramCenters(100, 10.0f);
@@ -94,6 +97,33 @@ void TCLCHistograms::updateCentersAndIds(const cv::Mat &mask, const cv::Mat &dep
 }
 
 
+void TCLCHistograms::updateCentersAndIds(const cv::Matx33f &K, const cv::Size &imageSize)
+{
+    _centersIDs.clear();
+    
+    vector<vector<Point2f> > contours;
+    vector<vector<int> > contourIDs;
+    
+    if(_model->projectSilhouette(K, _model->selectLOD(K(0, 0)), contours, contourIDs))
+    {
+        for(int c = 0; c < contours.size(); c++)
+        {
+            for(int i = 0; i < contours[c].size(); i++)
+            {
+                Point2f p = contours[c][i];
+                
+                if(p.x >= 0 && p.x < imageSize.width && p.y >= 0 && p.y < imageSize.height)
+                {
+                    _centersIDs.push_back(Point3i(p.x, p.y, contourIDs[c][i]));
+                }
+            }
+        }
+    }
+    
+    filterHistogramCenters(100, 10.0f);
+}
+
+
 vector<Point3i> TCLCHistograms::computeLocalHistogramCenters(const Mat &mask)
 {
     uchar *maskData = mask.data;
@@ -126,28 +156,29 @@ vector<Point3i> TCLCHistograms::computeLocalHistogramCenters(const Mat &mask)
 
 vector<Point3i> TCLCHistograms::parallelComputeLocalHistogramCenters(const Mat &mask, const Mat &depth, const Matx33f &K, float zNear, float zFar, int level)
 {
-    vector<Point3i> res;
+    RBOT_PROFILE_SCOPE("histogramCenters");
     
-    vector<Vec3f> verticies = _model->getVertices();
-    Matx44f T_cm = _model->getPose();
-    Matx44f T_n = _model->getNormalization();
+    vector<Point3i> res;
     
     vector<vector<Point3i> > centersIdsCollection;
     centersIdsCollection.resize(8);
     
-    Matx44f T_cm_n = T_cm * T_n;
-    
     int m_id = _model->getModelID();
     
-    parallel_for_(cv::Range(0, 8), Parallel_For_computeHistogramCenters(mask, depth, verticies, T_cm_n, K, zNear, zFar, m_id, level, centersIdsCollection.data(), 8));
+    Matx44f T_cm_n = _model->getPose()*_model->getNormalization();
+    
+    // only the vertices of the level of detail that was rendered can lie on the contour
+    const VertexProjection &projection = _model->getVertexProjection(_model->selectLOD(K(0, 0)));
+    
+    // vertices whose normal encloses less than 60 degrees with the viewing ray face away from the camera and are no contour points
+    float cullCosine = 0.5f;
+    
+    parallel_for_(cv::Range(0, 8), Parallel_For_computeHistogramCenters(mask, depth, projection, T_cm_n, K, zNear, zFar, cullCosine, m_id, level, centersIdsCollection.data(), 8));
     
     for(int i = 0; i < centersIdsCollection.size(); i++)
     {
-        vector<Point3i> tmp = centersIdsCollection[i];
-        for(int j = 0; j < tmp.size(); j++)
-        {
-            res.push_back(tmp[j]);
-        }
+        const vector<Point3i> &tmp = centersIdsCollection[i];
+        res.insert(res.end(), tmp.begin(), tmp.end());
     }
     
     return res;
@@ -212,6 +243,11 @@ vector<Point3i> TCLCHistograms::getCentersAndIDs()
     return _centersIDs;
 }
 
+void TCLCHistograms::setCentersAndIDs(const vector<Point3i> &centersIDs)
+{
+    _centersIDs = centersIDs;
+}
+
 
 Mat TCLCHistograms::getInitialized()
 {
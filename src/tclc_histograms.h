@@ -39,6 +39,8 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include "vertex_projection.h"
+
 class Model;
 
 /**
@@ -88,6 +90,17 @@ public:
      */
     void updateCentersAndIds(const cv::Mat &mask, const cv::Mat &depth, const cv::Matx33f &K, float zNear, float zFar, int level);
     
+    /**
+     *  Computes updated center locations and IDs of all histograms based on the current object
+     *  pose without rendering, by projecting the vertices of the silhouette edges of the model
+     *  (see Model::projectSilhouette()). Occlusions by other objects and self-occluded
+     *  silhouette edges of non-convex models are not taken into account.
+     *
+     *  @param  K The camera's instrinsic matrix.
+     *  @param  imageSize The size of the camera image.
+     */
+    void updateCentersAndIds(const cv::Matx33f &K, const cv::Size &imageSize);
+    
     /**
      *  Returns all normalized forground histograms in their current state.
      *
@@ -110,6 +123,14 @@ public:
      */
     std::vector<cv::Point3i> getCentersAndIDs();
     
+    /**
+     *  Replaces the current histogram centers, e.g. by those previously obtained with
+     *  getCentersAndIDs() for another camera observing the same object.
+     *
+     *  @param centersIDs The center locations and their corresponding IDs [(x_0, y_0, id_0), (x_1, y_1, id_1), ...].
+     */
+    void setCentersAndIDs(const std::vector<cv::Point3i> &centersIDs);
+    
     /**
      *  Returns a 1D binary mask of all histograms where a '1' means that the histograms
      *  corresponding to the index has been intialized before.
@@ -547,12 +568,14 @@ public:
  *  computations. Within the corresponding for loop, every 3D histogram center is projected
  *  into the image plane. Those that do not project on or close to the object's contour are
  *  being filtered based on a given binary silhouette mask and depth map at a specified image
- *  pyramid level.
+ *  pyramid level. Only the vertices of the level of detail of the model used for rendering the
+ *  mask are projected, in batches of four, culling those behind the camera, outside the image
+ *  or clearly facing away from the camera before the per pixel tests.
  */
 class Parallel_For_computeHistogramCenters: public cv::ParallelLoopBody
 {
 private:
-    std::vector<cv::Vec3f> _verticies;
+    const VertexProjection* _projection;
     
     std::vector<cv::Point3i>* _centersIds;
     
@@ -560,13 +583,18 @@ private:
     cv::Mat _mask;
     
     uchar* maskData;
+    int maskStep;
     
     cv::Matx44f _T_cm;
     cv::Matx33f _K;
     
+    cv::Rect2f _bounds;
+    
     float _zNear;
     float _zFar;
     
+    float _cullCosine;
+    
     int _m_id;
     
     int _level;
@@ -577,9 +605,9 @@ private:
     int _threads;
     
 public:
-    Parallel_For_computeHistogramCenters(const cv::Mat &mask, const cv::Mat &depth, const std::vector<cv::Vec3f> &verticies, const cv::Matx44f &T_cm, const cv::Matx33f &K, float zNear, float zFar, int m_id, int level, std::vector<cv::Point3i>* centersIds, int threads)
+    Parallel_For_computeHistogramCenters(const cv::Mat &mask, const cv::Mat &depth, const VertexProjection &projection, const cv::Matx44f &T_cm, const cv::Matx33f &K, float zNear, float zFar, float cullCosine, int m_id, int level, std::vector<cv::Point3i>* centersIds, int threads)
     {
-        _verticies = verticies;
+        _projection = &projection;
         
         _depth = depth;
         
@@ -598,7 +626,13 @@ public:
             _mask = mask;
         }
         
-        maskData = mask.data;
+        maskData = _mask.data;
+        maskStep = (int)_mask.step;
+        
+        // the mask is sampled up to downScale pixels around every projected vertex
+        int width = std::min(_mask.cols - 2*downScale, _depth.cols - downScale);
+        int height = std::min(_mask.rows - 2*downScale, _depth.rows - downScale);
+        _bounds = cv::Rect2f(downScale, downScale, std::max(width, 0), std::max(height, 0));
         
         _T_cm = T_cm;
         _K = K;
@@ -606,6 +640,8 @@ public:
         _zNear = zNear;
         _zFar = zFar;
         
+        _cullCosine = cullCosine;
+        
         _m_id = m_id;
         
         _centersIds = centersIds;
@@ -615,55 +651,51 @@ public:
     
     virtual void operator()( const cv::Range &r ) const
     {
-        int range = (int)_verticies.size()/_threads;
+        int numPoints = _projection->getNumPoints();
         
-        int vEnd = r.end*range;
+        int range = numPoints/_threads;
+        
+        int iStart = r.start*range;
+        int iEnd = r.end*range;
         if(r.end == _threads)
         {
-            vEnd = (int)_verticies.size();
+            iEnd = numPoints;
         }
         
         std::vector<cv::Point3i>* tmp = &_centersIds[r.start];
         
-        for(int v = r.start*range; v < vEnd; v++)
+        int n = std::max(iEnd - iStart, 0);
+        std::vector<float> xs(n), ys(n), zs(n);
+        std::vector<int> ids(n);
+        
+        int numVisible = n > 0 ? _projection->projectVisible(_T_cm, _K, _bounds, _zNear, _cullCosine, iStart, iEnd, xs.data(), ys.data(), zs.data(), ids.data()) : 0;
+        
+        for(int i = 0; i < numVisible; i++)
         {
-            cv::Vec3f V_m = _verticies[v];
+            int v = ids[i];
             
-            float X_m = V_m[0];
-            float Y_m = V_m[1];
-            float Z_m = V_m[2];
+            float x = xs[i];
+            float y = ys[i];
+            float Z_c = zs[i];
             
-            float X_c = X_m*_T_cm(0, 0) + Y_m*_T_cm(0, 1) + Z_m*_T_cm(0, 2) + _T_cm(0, 3);
-            float Y_c = X_m*_T_cm(1, 0) + Y_m*_T_cm(1, 1) + Z_m*_T_cm(1, 2) + _T_cm(1, 3);
-            float Z_c = X_m*_T_cm(2, 0) + Y_m*_T_cm(2, 1) + Z_m*_T_cm(2, 2) + _T_cm(2, 3);
+            float d = 1.0f - _depth.at<float>(y, x);
             
-            float x = X_c/Z_c*_K(0, 0) + _K(0, 2);
-            float y = Y_c/Z_c*_K(1, 1) + _K(1, 2);
+            float Z_d = 2.0f * _zNear * _zFar / (_zFar + _zNear - (2.0f*(d) - 1.0) * (_zFar - _zNear));
             
-            if(x >= 0 && x < _depth.cols && y >= 0 && y < _depth.rows)
+            if(fabs(Z_c - Z_d) < 1.0f || d == 1.0)
             {
-                float d = 1.0f - _depth.at<float>(y, x);
+                int xi = (int)x;
+                int yi = (int)y;
                 
-                float Z_d = 2.0f * _zNear * _zFar / (_zFar + _zNear - (2.0f*(d) - 1.0) * (_zFar - _zNear));
+                uchar v0 = maskData[yi*maskStep + xi] == _m_id;
+                uchar v1 = maskData[yi*maskStep + xi + downScale] == _m_id;
+                uchar v2 = maskData[yi*maskStep + xi - downScale] == _m_id;
+                uchar v3 = maskData[(yi + downScale)*maskStep + xi] == _m_id;
+                uchar v4 = maskData[(yi - downScale)*maskStep + xi] == _m_id;
                 
-                if(fabs(Z_c - Z_d) < 1.0f || d == 1.0)
+                if(v0*v1*v2*v3*v4 == 0)
                 {
-                    int xi = (int)x;
-                    int yi = (int)y;
-                    
-                    if(xi >= downScale && xi < _mask.cols - downScale && yi >= downScale && yi < _mask.rows - downScale)
-                    {
-                        uchar v0 = maskData[yi*_mask.cols + xi] == _m_id;
-                        uchar v1 = maskData[yi*_mask.cols + xi + downScale] == _m_id;
-                        uchar v2 = maskData[yi*_mask.cols + xi - downScale] == _m_id;
-                        uchar v3 = maskData[(yi + downScale)*_mask.cols + xi] == _m_id;
-                        uchar v4 = maskData[(yi - downScale)*_mask.cols + xi] == _m_id;
-                        
-                        if(v0*v1*v2*v3*v4 == 0)
-                        {
-                            tmp->push_back(cv::Point3i(x*upScale, y*upScale, v));
-                        }
-                    }
+                    tmp->push_back(cv::Point3i(x*upScale, y*upScale, v));
                 }
             }
         }
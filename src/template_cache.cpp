@@ -0,0 +1,138 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <sstream>
+
+#include "template_cache.h"
+#include "rendering_engine.h"
+
+using namespace std;
+using namespace cv;
+
+Object3D *ObjectDescription::createObject() const
+{
+    vector<float> distances = templateDistances;
+    
+    return new Object3D(filename, tx, ty, tz, alpha, beta, gamma, scale, qualityThreshold, distances);
+}
+
+
+TemplateCache::TemplateCache(float zNear, float zFar)
+{
+    this->zNear = zNear;
+    this->zFar = zFar;
+}
+
+
+TemplateCache::~TemplateCache()
+{
+    map<string, vector<vector<TemplateView*> > >::iterator it;
+    for(it = entries.begin(); it != entries.end(); ++it)
+    {
+        for(int l = 0; l < it->second.size(); l++)
+        {
+            for(int i = 0; i < it->second[l].size(); i++)
+            {
+                delete it->second[l][i];
+            }
+        }
+    }
+    entries.clear();
+}
+
+
+void TemplateCache::attachTemplates(Object3D *object, const ObjectDescription &description, const Matx33f &K, int width, int height)
+{
+    QMutexLocker locker(&mutex);
+    
+    string key = makeKey(description, K, width, height);
+    
+    map<string, vector<vector<TemplateView*> > >::iterator it = entries.find(key);
+    if(it == entries.end())
+    {
+        it = entries.insert(make_pair(key, generateTemplates(description, K, width, height))).first;
+    }
+    
+    object->useSharedTemplates(it->second);
+}
+
+
+int TemplateCache::getNumEntries()
+{
+    QMutexLocker locker(&mutex);
+    
+    return (int)entries.size();
+}
+
+
+string TemplateCache::makeKey(const ObjectDescription &description, const Matx33f &K, int width, int height)
+{
+    // the initial pose and quality threshold do not influence the templates
+    stringstream key;
+    key << description.filename << "|" << description.scale << "|";
+    
+    for(int d = 0; d < description.templateDistances.size(); d++)
+    {
+        key << description.templateDistances[d] << ",";
+    }
+    
+    key << "|" << K(0, 0) << "," << K(1, 1) << "," << K(0, 2) << "," << K(1, 2) << "|" << width << "x" << height;
+    
+    return key.str();
+}
+
+
+vector<vector<TemplateView*> > TemplateCache::generateTemplates(const ObjectDescription &description, const Matx33f &K, int width, int height)
+{
+    RenderingEngine *renderingEngine = new RenderingEngine();
+    renderingEngine->init(K, width, height, zNear, zFar, 4);
+    
+    renderingEngine->makeCurrent();
+    
+    // a temporary instance of the object is only needed for rendering the templates
+    Object3D *object = description.createObject();
+    object->setModelID(1);
+    object->initBuffers();
+    object->generateTemplates(renderingEngine);
+    
+    vector<vector<TemplateView*> > templateHierarchy = object->releaseTemplates();
+    
+    delete object;
+    delete renderingEngine;
+    
+    return templateHierarchy;
+}
@@ -0,0 +1,140 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef TEMPLATE_CACHE_H
+#define TEMPLATE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <QMutex>
+
+#include <opencv2/core.hpp>
+
+#include "object3d.h"
+#include "template_view.h"
+
+/**
+ *  The parameters an Object3D is constructed from, so that several instances
+ *  of the same 3D object can be created, e.g. one per tracking session.
+ */
+struct ObjectDescription
+{
+    // the relative path to an OBJ/PLY file describing the model
+    std::string filename;
+    
+    // the initial pose (see Object3D)
+    float tx;
+    float ty;
+    float tz;
+    float alpha;
+    float beta;
+    float gamma;
+    
+    float scale;
+    float qualityThreshold;
+    
+    std::vector<float> templateDistances;
+    
+    /**
+     *  Creates a new instance of the described 3D object.
+     *
+     *  @return  The new 3D object, which is owned by the caller.
+     */
+    Object3D *createObject() const;
+};
+
+
+/**
+ *  This class implements a cache of the template views used for pose detection
+ *  that are shared read-only by all instances of the same 3D object, e.g. when
+ *  many tracking sessions detect objects from the same catalog. The templates
+ *  are generated once per combination of model, scale, template distances and
+ *  camera intrinsics within an offscreen rendering engine of their own. Each
+ *  instance keeps its own tclc-histograms and pose. The cache must outlive all
+ *  objects it has provided templates to.
+ */
+class TemplateCache
+{
+public:
+    /**
+     *  Constructor of the template cache.
+     *
+     *  @param  zNear The distance of the OpenGL near plane used by the trackers.
+     *  @param  zFar The distance of the OpenGL far plane used by the trackers.
+     */
+    TemplateCache(float zNear, float zFar);
+    
+    ~TemplateCache();
+    
+    /**
+     *  Lets an instance of a described 3D object use the cached templates for
+     *  the given camera, generating them on first request. Generation creates
+     *  a rendering engine, so that it must happen on the GUI thread and leaves
+     *  no OpenGL context active. Must be called before the object is passed to
+     *  a PoseEstimator6D, which then does not generate templates for it.
+     *
+     *  @param  object The instance of the described 3D object.
+     *  @param  description The description the object has been created from.
+     *  @param  K The intrinsic camera matrix of the tracker.
+     *  @param  width The width in pixels of the camera frames at full resolution.
+     *  @param  height The height in pixels of the camera frames at full resolution.
+     */
+    void attachTemplates(Object3D *object, const ObjectDescription &description, const cv::Matx33f &K, int width, int height);
+    
+    /**
+     *  Returns the number of distinct template sets held by the cache.
+     *
+     *  @return  The number of cached template sets.
+     */
+    int getNumEntries();
+    
+private:
+    float zNear;
+    float zFar;
+    
+    QMutex mutex;
+    
+    std::map<std::string, std::vector<std::vector<TemplateView*> > > entries;
+    
+    std::string makeKey(const ObjectDescription &description, const cv::Matx33f &K, int width, int height);
+    
+    std::vector<std::vector<TemplateView*> > generateTemplates(const ObjectDescription &description, const cv::Matx33f &K, int width, int height);
+};
+
+#endif /* TEMPLATE_CACHE_H */
@@ -38,13 +38,15 @@
 using namespace std;
 using namespace cv;
 
-TemplateView::TemplateView(Object3D *object, float alpha, float beta, float gamma, float distance, int numLevels, bool generateNeighbors)
+TemplateView::TemplateView(Object3D *object, float alpha, float beta, float gamma, float distance, int numLevels, bool generateNeighbors, RenderingEngine *renderingEngine)
 {
     T_cm = Transformations::translationMatrix(0, 0, distance)*Transformations::rotationMatrix(gamma, Vec3f(0, 0, 1))*Transformations::rotationMatrix(alpha, Vec3f(1, 0, 0))*Transformations::rotationMatrix(beta, Vec3f(0, 1, 0));
     
     object->setPose(T_cm);
     
-    renderingEngine = RenderingEngine::Instance();
+    // the engine is only needed for rendering the template here, since templates may outlive it (see TemplateCache)
+    if(!renderingEngine)
+        renderingEngine = RenderingEngine::Instance();
     
     renderingEngine->setLevel(0);
     renderingEngine->renderSilhouette(object, GL_FILL, false, 1.0f, 1.0f, 1.0f, true);
@@ -185,16 +187,6 @@ Rect TemplateView::getROI(int level)
     return roiPyramid[level];
 }
 
-Point3f TemplateView::getCurrentOffset(int level)
-{
-    return currentOffset;
-}
-
-void TemplateView::setCurrentOffset(Point3f &offset, int level)
-{
-    currentOffset = offset;
-}
-
 vector<Point3i> TemplateView::getCentersAndIDs(int level)
 {
     return centersIDsPyramid[level];
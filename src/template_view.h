@@ -65,6 +65,20 @@ struct PixelData
     int* ids;
 };
 
+class TemplateView;
+
+/**
+ *  A template view matched against a camera image.
+ */
+struct TemplateMatch
+{
+    // The matched template view.
+    TemplateView *templateView;
+    
+    // The 2D offset at which the template matches best and the matching score (x, y, score).
+    cv::Point3f offset;
+};
+
 /**
  *  A class representing a single template view at multiple image scales
  *  for region-based object pose detection using tclc-histograms.
@@ -83,8 +97,9 @@ public:
      *  @param  distance The object's distance to the camera to be used.
      *  @param  numLevels Number of template pyramid levels to be created with a downscale factor of 2.
      *  @param  generateNeighbors A flag telling whether neighboring templates should also be created or not.
+     *  @param  renderingEngine The rendering engine used to render the template (default = NULL, i.e. RenderingEngine::Instance()).
      */
-    TemplateView(Object3D *object, float alpha, float beta, float gamma, float distance, int numLevels, bool generateNeighbors);
+    TemplateView(Object3D *object, float alpha, float beta, float gamma, float distance, int numLevels, bool generateNeighbors, RenderingEngine *renderingEngine = NULL);
     
     ~TemplateView();
     
@@ -179,24 +194,6 @@ public:
      */
     cv::Rect getROI(int level);
     
-    /**
-     *  Returns the 2D (x, y) offset at which the template currently matches
-     *  best with the corresponding matching score at a given pyramid level.
-     *
-     *  @param level The pyramid level to be used.
-     *  @return  The 2D offset with the matching score (x, y, score).
-     */
-    cv::Point3f getCurrentOffset(int level);
-    
-    /**
-     *  Sets the 2D (x, y) offset at which the template currently matches
-     *  best with the corresponding matching score at a given pyramid level.
-     *
-     *  @param offset The 2D offset with the matching score (x, y, score).
-     *  @param level The pyramid level to be used.
-     */
-    void setCurrentOffset(cv::Point3f &offset, int level);
-    
     /**
      *  Returns the 2D centers and IDs of all tclc-histograms in the
      *  template at a given pyramid level.
@@ -230,8 +227,6 @@ public:
     std::vector<TemplateView*> getNeighborTemplates();
     
 private:
-    RenderingEngine *renderingEngine;
-    
     cv::Matx44f T_cm;
     
     std::vector<int> etaFPyramid;
@@ -245,8 +240,6 @@ private:
     
     std::vector<std::vector<PixelData> > pixelDataPyramid;
     
-    cv::Point3f currentOffset;
-    
     float _alpha;
     float _beta;
     float _gamma;
@@ -9,6 +9,7 @@
 #include <iomanip>
 #include "object3d.h"
 #include "pose_estimator6d.h"
+#include "pose_log.h"
 
 using namespace std;
 using namespace cv;
@@ -36,17 +37,6 @@ vector<Matx44f> loadPoses(const string& filename) {
     return poses;
 }
 
-void savePoseToFile(const Matx44f& pose, const string& filename) {
-    ofstream file(filename, ios::app);
-    file << fixed << setprecision(6);
-    for (int i = 0; i < 3; ++i)
-        for (int j = 0; j < 3; ++j)
-            file << pose(i, j) << "\t";
-    for (int i = 0; i < 3; ++i)
-        file << pose(i, 3) << "\t";
-    file << "\n";
-}
-
 // ---------- 主程序 ----------
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
@@ -86,6 +76,8 @@ int main(int argc, char *argv[]) {
     int validFrames = 0;
     int successFrames = 0;
 
+    PoseLogWriter poseLog("predicted_poses_ape_occ1.rpl", "ape_simple.obj", "d_occlusion");
+
     for (int i = 0; i <= 1000; ++i) {
         stringstream ss;
         ss << "/media/jyj/JYJ/RBOT-dataset/ape/frames/d_occlusion"
@@ -97,6 +89,8 @@ int main(int argc, char *argv[]) {
 
         timer.start();
 
+        int status = PoseLogRecord::TRACKING;
+
         if (i == 0) {
             estimator->toggleTracking(frame, 0, true);
             estimator->estimatePoses(frame, true, false);
@@ -110,16 +104,13 @@ int main(int argc, char *argv[]) {
             Vec3f t_gt(gt(0,3), gt(1,3), gt(2,3));
             float t_err = norm((t_pred - t_gt) * 0.001f);
 
-            Matx33f R_pred(pred.val);
-            Matx33f R_gt(gt.val);
-            Matx33f R_err = R_pred.t() * R_gt;
-            float trace = R_err(0,0) + R_err(1,1) + R_err(2,2);
-            float angle_rad = acosf(std::max(-1.0f, std::min(1.0f, (trace - 1.0f) / 2.0f)));
+            float angle_rad = Transformations::rotationError(pred, gt);
 
             if (t_err < 0.05f && angle_rad < 0.0873f)
                 successFrames++;
             else {
                 // fallback 初始化
+                status = PoseLogRecord::REINITIALIZED;
                 duck->setPose(gt);
                 duck->setInitialPose(gt);
                 estimator->toggleTracking(frame, 0, true);
@@ -132,7 +123,7 @@ int main(int argc, char *argv[]) {
         validFrames++;
         timer.reset();
 
-        savePoseToFile(duck->getPose(), "predicted_poses_ape_occ1.txt");
+        poseLog.write(i, duck->getPose(), status);
 
         // ✅ 可视化（建议注释以防崩溃）
 //Mat rendering = drawResultOverlay(renderObjects, frame);
@@ -145,6 +136,9 @@ int main(int argc, char *argv[]) {
 
     }
 
+    poseLog.close();
+    convertPoseLogToText("predicted_poses_ape_occ1.rpl", "predicted_poses_ape_occ1.txt");
+
     if (validFrames > 0) {
         cout << "---------------------------------------------" << endl;
         cout << "Avg. Runtime per frame: " << fixed << setprecision(2)
@@ -0,0 +1,448 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <cstring>
+#include <iostream>
+
+#include "tracking_server.h"
+
+using namespace std;
+using namespace cv;
+
+static const char SHARED_FRAME_MAGIC[8] = {'R', 'B', 'O', 'T', 'S', 'H', 'M', '1'};
+
+
+TrackingSession::TrackingSession(const string &key, int width, int height, const Matx33f &K, const Matx14f &distCoeffs, float zNear, float zFar, const vector<ObjectDescription> &catalog, TemplateCache *templateCache) :
+    memory(QString::fromStdString(key)),
+    frameReady(QString::fromStdString(key + "_frame"), 0, QSystemSemaphore::Create),
+    resultReady(QString::fromStdString(key + "_result"), 0, QSystemSemaphore::Create)
+{
+    this->key = key;
+    this->width = width;
+    this->height = height;
+    
+    stopped = false;
+    
+    renderingEngine = NULL;
+    poseEstimator = NULL;
+    
+    int size = SharedFrameHeader::segmentSize(width, height);
+    
+    if(!memory.create(size))
+    {
+        // a segment left behind by a crashed server is released by attaching to and detaching from it
+        if(memory.error() == QSharedMemory::AlreadyExists && memory.attach())
+            memory.detach();
+        
+        if(!memory.create(size))
+        {
+            cerr << "error creating the shared memory of stream " << key << ": " << memory.errorString().toStdString() << endl;
+            return;
+        }
+    }
+    
+    memory.lock();
+    
+    SharedFrameHeader *header = (SharedFrameHeader*)memory.data();
+    memset(header, 0, SharedFrameHeader::frameOffset());
+    memcpy(header->magic, SHARED_FRAME_MAGIC, sizeof(header->magic));
+    header->width = width;
+    header->height = height;
+    header->numObjects = (int)catalog.size();
+    
+    memory.unlock();
+    
+    for(int i = 0; i < catalog.size(); i++)
+    {
+        Object3D *object = catalog[i].createObject();
+        templateCache->attachTemplates(object, catalog[i], K, width, height);
+        
+        objects.push_back(object);
+    }
+    
+    renderingEngine = new RenderingEngine();
+    poseEstimator = new PoseEstimator6D(width, height, zNear, zFar, K, distCoeffs, objects, renderingEngine);
+    
+    // the engine is used by the session thread until it has finished
+    ownerThread = QThread::currentThread();
+    renderingEngine->moveToThread(this);
+}
+
+
+TrackingSession::~TrackingSession()
+{
+    stop();
+    
+    if(renderingEngine)
+    {
+        renderingEngine->makeCurrent();
+        
+        delete poseEstimator;
+        
+        for(int i = 0; i < objects.size(); i++)
+        {
+            delete objects[i];
+        }
+        
+        delete renderingEngine;
+    }
+}
+
+
+bool TrackingSession::isValid()
+{
+    return renderingEngine != NULL;
+}
+
+
+void TrackingSession::stop()
+{
+    mutex.lock();
+    stopped = true;
+    mutex.unlock();
+    
+    // wake up the thread waiting for the next frame
+    frameReady.release();
+    
+    wait();
+}
+
+
+bool TrackingSession::isStopped()
+{
+    QMutexLocker locker(&mutex);
+    
+    return stopped;
+}
+
+
+void TrackingSession::run()
+{
+    renderingEngine->makeCurrent();
+    
+    int numObjects = (int)objects.size();
+    
+    Mat frame(height, width, CV_8UC3);
+    vector<int> commands(numObjects);
+    vector<Matx44f> initialPoses(numObjects);
+    
+    while(true)
+    {
+        frameReady.acquire();
+        
+        if(isStopped())
+            break;
+        
+        memory.lock();
+        
+        SharedFrameHeader *header = (SharedFrameHeader*)memory.data();
+        
+        memcpy(frame.data, (uchar*)memory.data() + SharedFrameHeader::frameOffset(), width*height*3);
+        
+        for(int o = 0; o < numObjects; o++)
+        {
+            commands[o] = header->commands[o];
+            header->commands[o] = SharedFrameHeader::NONE;
+            
+            if(commands[o] == SharedFrameHeader::INITIALIZE)
+                initialPoses[o] = Matx44f(header->poses[o]);
+        }
+        
+        uint64_t frameIndex = header->frameIndex;
+        
+        memory.unlock();
+        
+        processFrame(frame, commands, initialPoses);
+        
+        memory.lock();
+        
+        header = (SharedFrameHeader*)memory.data();
+        
+        for(int o = 0; o < numObjects; o++)
+        {
+            Matx44f pose = objects[o]->getPose();
+            memcpy(header->poses[o], pose.val, sizeof(header->poses[o]));
+            
+            if(!objects[o]->isInitialized())
+                header->status[o] = SharedFrameHeader::IDLE;
+            else if(objects[o]->isTrackingLost())
+                header->status[o] = SharedFrameHeader::LOST;
+            else
+                header->status[o] = SharedFrameHeader::TRACKING;
+        }
+        
+        header->resultIndex = frameIndex;
+        
+        memory.unlock();
+        
+        resultReady.release();
+    }
+    
+    renderingEngine->doneCurrent();
+    renderingEngine->moveToThread(ownerThread);
+}
+
+
+void TrackingSession::processFrame(Mat &frame, const vector<int> &commands, const vector<Matx44f> &initialPoses)
+{
+    // the frame is undistorted in place by the first call of the estimator
+    bool undistorted = false;
+    
+    for(int o = 0; o < objects.size(); o++)
+    {
+        if(commands[o] == SharedFrameHeader::INITIALIZE)
+        {
+            if(objects[o]->isInitialized())
+                poseEstimator->toggleTracking(frame, o, false);
+            
+            objects[o]->setInitialPose(initialPoses[o]);
+            objects[o]->setPose(initialPoses[o]);
+            
+            poseEstimator->toggleTracking(frame, o, !undistorted);
+            undistorted = true;
+        }
+        else if(commands[o] == SharedFrameHeader::STOP && objects[o]->isInitialized())
+        {
+            poseEstimator->toggleTracking(frame, o, false);
+        }
+    }
+    
+    poseEstimator->estimatePoses(frame, !undistorted, true);
+}
+
+
+TrackingServer::TrackingServer(const vector<ObjectDescription> &catalog, float zNear, float zFar)
+{
+    this->catalog = catalog;
+    
+    if(this->catalog.size() > SharedFrameHeader::MAX_OBJECTS)
+    {
+        cerr << "only the first " << SharedFrameHeader::MAX_OBJECTS << " objects of the catalog are tracked" << endl;
+        this->catalog.resize(SharedFrameHeader::MAX_OBJECTS);
+    }
+    
+    this->zNear = zNear;
+    this->zFar = zFar;
+    
+    templateCache = new TemplateCache(zNear, zFar);
+}
+
+
+TrackingServer::~TrackingServer()
+{
+    stop();
+    
+    // all objects using the shared templates have been deleted along with their sessions
+    delete templateCache;
+}
+
+
+bool TrackingServer::addStream(const string &key, int width, int height, const Matx33f &K, const Matx14f &distCoeffs)
+{
+    TrackingSession *session = new TrackingSession(key, width, height, K, distCoeffs, zNear, zFar, catalog, templateCache);
+    
+    if(!session->isValid())
+    {
+        delete session;
+        return false;
+    }
+    
+    session->start();
+    sessions.push_back(session);
+    
+    return true;
+}
+
+
+int TrackingServer::getNumStreams()
+{
+    return (int)sessions.size();
+}
+
+
+TemplateCache *TrackingServer::getTemplateCache()
+{
+    return templateCache;
+}
+
+
+void TrackingServer::stop()
+{
+    for(int i = 0; i < sessions.size(); i++)
+    {
+        delete sessions[i];
+    }
+    sessions.clear();
+}
+
+
+TrackingClient::TrackingClient(const string &key) :
+    memory(QString::fromStdString(key)),
+    frameReady(QString::fromStdString(key + "_frame"), 0, QSystemSemaphore::Open),
+    resultReady(QString::fromStdString(key + "_result"), 0, QSystemSemaphore::Open)
+{
+    width = 0;
+    height = 0;
+    numObjects = 0;
+    
+    frameIndex = 0;
+}
+
+
+bool TrackingClient::connect()
+{
+    if(!memory.isAttached() && !memory.attach())
+        return false;
+    
+    memory.lock();
+    
+    const SharedFrameHeader *header = (const SharedFrameHeader*)memory.constData();
+    
+    bool valid = memcmp(header->magic, SHARED_FRAME_MAGIC, sizeof(header->magic)) == 0;
+    if(valid)
+    {
+        width = header->width;
+        height = header->height;
+        numObjects = header->numObjects;
+    }
+    
+    memory.unlock();
+    
+    if(!valid)
+    {
+        memory.detach();
+        return false;
+    }
+    
+    commands.assign(numObjects, SharedFrameHeader::NONE);
+    initialPoses.assign(numObjects, Matx44f::eye());
+    
+    return true;
+}
+
+
+int TrackingClient::getWidth()
+{
+    return width;
+}
+
+
+int TrackingClient::getHeight()
+{
+    return height;
+}
+
+
+int TrackingClient::getNumObjects()
+{
+    return numObjects;
+}
+
+
+void TrackingClient::initializeObject(int objectIndex, const Matx44f &pose)
+{
+    if(objectIndex >= numObjects)
+        return;
+    
+    commands[objectIndex] = SharedFrameHeader::INITIALIZE;
+    initialPoses[objectIndex] = pose;
+}
+
+
+void TrackingClient::stopObject(int objectIndex)
+{
+    if(objectIndex >= numObjects)
+        return;
+    
+    commands[objectIndex] = SharedFrameHeader::STOP;
+}
+
+
+bool TrackingClient::submitFrame(const Mat &frame)
+{
+    if(!memory.isAttached() || frame.cols != width || frame.rows != height || frame.type() != CV_8UC3)
+        return false;
+    
+    memory.lock();
+    
+    SharedFrameHeader *header = (SharedFrameHeader*)memory.data();
+    uchar *frameData = (uchar*)memory.data() + SharedFrameHeader::frameOffset();
+    
+    for(int y = 0; y < height; y++)
+    {
+        memcpy(frameData + y*width*3, frame.ptr<uchar>(y), width*3);
+    }
+    
+    for(int o = 0; o < numObjects; o++)
+    {
+        header->commands[o] = commands[o];
+        
+        if(commands[o] == SharedFrameHeader::INITIALIZE)
+            memcpy(header->poses[o], initialPoses[o].val, sizeof(header->poses[o]));
+        
+        commands[o] = SharedFrameHeader::NONE;
+    }
+    
+    header->frameIndex = ++frameIndex;
+    
+    memory.unlock();
+    
+    frameReady.release();
+    
+    return true;
+}
+
+
+void TrackingClient::waitForResult(vector<Matx44f> &poses, vector<int> &status)
+{
+    resultReady.acquire();
+    
+    memory.lock();
+    
+    const SharedFrameHeader *header = (const SharedFrameHeader*)memory.constData();
+    
+    poses.resize(numObjects);
+    status.resize(numObjects);
+    
+    for(int o = 0; o < numObjects; o++)
+    {
+        poses[o] = Matx44f(header->poses[o]);
+        status[o] = header->status[o];
+    }
+    
+    memory.unlock();
+}
@@ -0,0 +1,359 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef TRACKING_SERVER_H
+#define TRACKING_SERVER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <QThread>
+#include <QMutex>
+#include <QSharedMemory>
+#include <QSystemSemaphore>
+
+#include <opencv2/core.hpp>
+
+#include "object3d.h"
+#include "rendering_engine.h"
+#include "pose_estimator6d.h"
+#include "template_cache.h"
+
+/**
+ *  The header at the beginning of the shared memory segment of a tracking
+ *  stream. It is followed by the current camera frame (RGB, uchar, tightly
+ *  packed rows) at frameOffset(). All fields are only accessed while the
+ *  segment is locked. The objects are indexed in the order of the catalog
+ *  of the tracking server.
+ */
+struct SharedFrameHeader
+{
+    enum
+    {
+        MAX_OBJECTS = 16
+    };
+    
+    enum Command
+    {
+        NONE,
+        INITIALIZE,
+        STOP
+    };
+    
+    enum Status
+    {
+        IDLE,
+        TRACKING,
+        LOST
+    };
+    
+    // "RBOTSHM1"
+    char magic[8];
+    
+    int32_t width;
+    int32_t height;
+    int32_t numObjects;
+    int32_t reserved;
+    
+    // the index of the current frame, written by the client
+    uint64_t frameIndex;
+    
+    // the index of the frame the poses belong to, written by the server
+    uint64_t resultIndex;
+    
+    // the command of each object executed with the current frame, INITIALIZE starts from the pose given in poses
+    int32_t commands[MAX_OBJECTS];
+    
+    int32_t status[MAX_OBJECTS];
+    
+    // the poses of all objects in camera coordinates (row-major 4x4)
+    float poses[MAX_OBJECTS][16];
+    
+    /**
+     *  Returns the offset in bytes of the frame data within the segment.
+     *
+     *  @return  The offset of the frame data.
+     */
+    static int frameOffset()
+    {
+        return (sizeof(SharedFrameHeader) + 63)/64*64;
+    }
+    
+    /**
+     *  Returns the size in bytes of the segment of a stream.
+     *
+     *  @param  width The width in pixels of the camera frames.
+     *  @param  height The height in pixels of the camera frames.
+     *  @return The size of the shared memory segment.
+     */
+    static int segmentSize(int width, int height)
+    {
+        return frameOffset() + width*height*3;
+    }
+};
+
+
+/**
+ *  This class implements a background thread tracking all objects of a catalog
+ *  in the frames of a single camera stream, which are exchanged through a shared
+ *  memory segment named after the key of the stream. A client signals a new frame
+ *  with the system semaphore <key>_frame and is notified about the resulting poses
+ *  with the system semaphore <key>_result (see TrackingClient). Each session has
+ *  its own rendering engine, objects, histograms and poses, while the templates
+ *  for pose detection are shared through the template cache of the server.
+ */
+class TrackingSession : public QThread
+{
+public:
+    /**
+     *  Constructor of a tracking session creating its shared memory segment,
+     *  rendering engine and pose estimator. Must be called on the GUI thread.
+     *
+     *  @param  key The name of the shared memory segment of the stream.
+     *  @param  width The width in pixels of the camera frames.
+     *  @param  height The height in pixels of the camera frames.
+     *  @param  K The intrinsic camera matrix.
+     *  @param  distCoeffs The cameras lens distortion coefficients.
+     *  @param  zNear The distance of the OpenGL near plane.
+     *  @param  zFar The distance of the OpenGL far plane.
+     *  @param  catalog The descriptions of all 3D objects to be tracked.
+     *  @param  templateCache The cache providing the templates of all objects.
+     */
+    TrackingSession(const std::string &key, int width, int height, const cv::Matx33f &K, const cv::Matx14f &distCoeffs, float zNear, float zFar, const std::vector<ObjectDescription> &catalog, TemplateCache *templateCache);
+    
+    ~TrackingSession();
+    
+    /**
+     *  Tells whether the shared memory segment of the stream could be created.
+     *
+     *  @return  True if the session is ready to be started and false otherwise.
+     */
+    bool isValid();
+    
+    /**
+     *  Terminates the thread after the frame currently being processed.
+     */
+    void stop();
+    
+protected:
+    void run();
+    
+private:
+    std::string key;
+    
+    int width;
+    int height;
+    
+    QSharedMemory memory;
+    QSystemSemaphore frameReady;
+    QSystemSemaphore resultReady;
+    
+    QMutex mutex;
+    bool stopped;
+    
+    RenderingEngine *renderingEngine;
+    PoseEstimator6D *poseEstimator;
+    
+    std::vector<Object3D*> objects;
+    
+    // the thread the rendering engine is handed back to after the session
+    QThread *ownerThread;
+    
+    bool isStopped();
+    
+    void processFrame(cv::Mat &frame, const std::vector<int> &commands, const std::vector<cv::Matx44f> &initialPoses);
+};
+
+
+/**
+ *  This class implements a service tracking the objects of a common catalog in
+ *  many camera streams concurrently, one tracking session per stream. The
+ *  templates of all objects are generated once per camera configuration and
+ *  shared by all sessions, so that they are not duplicated per stream.
+ */
+class TrackingServer
+{
+public:
+    /**
+     *  Constructor of the tracking server.
+     *
+     *  @param  catalog The descriptions of all 3D objects to be tracked (at most SharedFrameHeader::MAX_OBJECTS).
+     *  @param  zNear The distance of the OpenGL near plane.
+     *  @param  zFar The distance of the OpenGL far plane.
+     */
+    TrackingServer(const std::vector<ObjectDescription> &catalog, float zNear, float zFar);
+    
+    ~TrackingServer();
+    
+    /**
+     *  Creates and starts a tracking session for a camera stream. Templates
+     *  for camera intrinsics not seen before are generated first. Must be
+     *  called on the GUI thread.
+     *
+     *  @param  key The name of the shared memory segment of the stream.
+     *  @param  width The width in pixels of the camera frames.
+     *  @param  height The height in pixels of the camera frames.
+     *  @param  K The intrinsic camera matrix.
+     *  @param  distCoeffs The cameras lens distortion coefficients.
+     *  @return True if the session has been started and false otherwise.
+     */
+    bool addStream(const std::string &key, int width, int height, const cv::Matx33f &K, const cv::Matx14f &distCoeffs);
+    
+    /**
+     *  Returns the number of running tracking sessions.
+     *
+     *  @return  The number of streams.
+     */
+    int getNumStreams();
+    
+    /**
+     *  Returns the cache holding the templates shared by all sessions.
+     *
+     *  @return  The template cache.
+     */
+    TemplateCache *getTemplateCache();
+    
+    /**
+     *  Stops and removes all tracking sessions.
+     */
+    void stop();
+    
+private:
+    std::vector<ObjectDescription> catalog;
+    
+    float zNear;
+    float zFar;
+    
+    TemplateCache *templateCache;
+    
+    std::vector<TrackingSession*> sessions;
+};
+
+
+/**
+ *  This class implements the client side of a tracking stream, submitting
+ *  camera frames to a tracking session through its shared memory segment and
+ *  receiving the resulting object poses.
+ */
+class TrackingClient
+{
+public:
+    /**
+     *  Constructor of the client for the stream with the given key.
+     *
+     *  @param  key The name of the shared memory segment of the stream.
+     */
+    TrackingClient(const std::string &key);
+    
+    /**
+     *  Attaches to the shared memory segment of a running tracking session.
+     *
+     *  @return  True if the stream has been found and false otherwise.
+     */
+    bool connect();
+    
+    /**
+     *  Returns the width in pixels of the frames of the stream.
+     *
+     *  @return  The frame width.
+     */
+    int getWidth();
+    
+    /**
+     *  Returns the height in pixels of the frames of the stream.
+     *
+     *  @return  The frame height.
+     */
+    int getHeight();
+    
+    /**
+     *  Returns the number of objects tracked in the stream.
+     *
+     *  @return  The number of objects.
+     */
+    int getNumObjects();
+    
+    /**
+     *  Starts tracking an object from the given pose with the next submitted frame.
+     *
+     *  @param  objectIndex The index of the object within the catalog.
+     *  @param  pose The initial pose of the object in camera coordinates.
+     */
+    void initializeObject(int objectIndex, const cv::Matx44f &pose);
+    
+    /**
+     *  Stops tracking an object with the next submitted frame.
+     *
+     *  @param  objectIndex The index of the object within the catalog.
+     */
+    void stopObject(int objectIndex);
+    
+    /**
+     *  Copies a camera frame into the shared memory segment and signals it to
+     *  the tracking session along with all pending commands.
+     *
+     *  @param  frame The camera frame (RGB, uchar) at the resolution of the stream.
+     *  @return True if the frame has been submitted and false otherwise.
+     */
+    bool submitFrame(const cv::Mat &frame);
+    
+    /**
+     *  Blocks until the tracking session has processed the last submitted frame
+     *  and returns the poses and tracking states of all objects.
+     *
+     *  @param  poses The resulting poses of all objects in camera coordinates.
+     *  @param  status The resulting SharedFrameHeader::Status of all objects.
+     */
+    void waitForResult(std::vector<cv::Matx44f> &poses, std::vector<int> &status);
+    
+private:
+    QSharedMemory memory;
+    QSystemSemaphore frameReady;
+    QSystemSemaphore resultReady;
+    
+    int width;
+    int height;
+    int numObjects;
+    
+    uint64_t frameIndex;
+    
+    std::vector<int> commands;
+    std::vector<cv::Matx44f> initialPoses;
+};
+
+#endif /* TRACKING_SERVER_H */
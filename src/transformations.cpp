@@ -180,9 +180,13 @@ Matx44f Transformations::exp(Matx61f xi)
     // angle of the twist/rotation
     float theta = norm(r);
     
-    // return the identity group element for theta == 0, as there is no motion
+    // return a pure translation for theta == 0, as there is no rotation
     if(abs(theta) < FLT_EPSILON)
     {
+        T(0, 3) = v[0];
+        T(1, 3) = v[1];
+        T(2, 3) = v[2];
+        
         return T;
     }
     else
@@ -212,3 +216,262 @@ Matx44f Transformations::exp(Matx61f xi)
     
     return T;
 }
+
+Matx61f Transformations::log(const Matx44f &T)
+{
+    Matx33f R = T.get_minor<3, 3>(0, 0);
+    Vec3f t = Vec3f(T(0, 3), T(1, 3), T(2, 3));
+    
+    // rotational part as the matrix logarithm of R
+    Vec3f r = logSO3(R);
+    
+    // translational part by inverting the left Jacobian that maps v to t within exp()
+    Vec3f v = leftJacobianInverseSO3(r)*t;
+    
+    return Matx61f(r[0], r[1], r[2], v[0], v[1], v[2]);
+}
+
+Vec3f Transformations::logSO3(const Matx33f &R)
+{
+    float cosTheta = 0.5f*(R(0, 0) + R(1, 1) + R(2, 2) - 1.0f);
+    cosTheta = std::max(-1.0f, std::min(1.0f, cosTheta));
+    
+    float theta = acos(cosTheta);
+    
+    // the skew-symmetric part of R is 2*sin(theta)*w_x
+    Vec3f s = Vec3f(R(2, 1) - R(1, 2), R(0, 2) - R(2, 0), R(1, 0) - R(0, 1));
+    
+    if(theta < 1e-3f)
+    {
+        // first order approximation for small angles
+        return 0.5f*s;
+    }
+    
+    if(theta > float(CV_PI) - 1e-3f)
+    {
+        // close to pi the skew-symmetric part vanishes, so the axis is recovered
+        // from the symmetric part R = 2*w*w^T - I using its largest diagonal entry
+        int i = 0;
+        if(R(1, 1) > R(i, i)) i = 1;
+        if(R(2, 2) > R(i, i)) i = 2;
+        
+        int j = (i+1)%3;
+        int k = (i+2)%3;
+        
+        Vec3f w;
+        w[i] = sqrt(std::max(0.0f, 0.5f*(R(i, i) + 1.0f)));
+        w[j] = 0.25f*(R(i, j) + R(j, i))/w[i];
+        w[k] = 0.25f*(R(i, k) + R(k, i))/w[i];
+        
+        w /= norm(w);
+        
+        // resolve the sign of the axis with the remaining skew-symmetric part
+        if(w.dot(s) < 0.0f)
+            w = -w;
+        
+        return theta*w;
+    }
+    
+    float scale = theta/(2.0f*sin(theta));
+    
+    return scale*s;
+}
+
+Matx33f Transformations::leftJacobianSO3(const Vec3f &r)
+{
+    float theta = norm(r);
+    
+    Matx33f I = Matx33f::eye();
+    Matx33f r_x = axiator(r);
+    
+    if(theta < 1e-4f)
+    {
+        return I + 0.5f*r_x;
+    }
+    
+    float theta2 = theta*theta;
+    
+    return I + (1.0f - cos(theta))/theta2*r_x + (theta - sin(theta))/(theta2*theta)*r_x*r_x;
+}
+
+Matx33f Transformations::leftJacobianInverseSO3(const Vec3f &r)
+{
+    float theta = norm(r);
+    
+    Matx33f I = Matx33f::eye();
+    Matx33f r_x = axiator(r);
+    
+    if(theta < 1e-4f)
+    {
+        return I - 0.5f*r_x;
+    }
+    
+    float c = (1.0f - theta*sin(theta)/(2.0f*(1.0f - cos(theta))))/(theta*theta);
+    
+    return I - 0.5f*r_x + c*r_x*r_x;
+}
+
+Matx66f Transformations::leftJacobian(const Matx61f &xi)
+{
+    Vec3f r = Vec3f(xi(0, 0), xi(1, 0), xi(2, 0));
+    Vec3f v = Vec3f(xi(3, 0), xi(4, 0), xi(5, 0));
+    
+    Matx33f J = leftJacobianSO3(r);
+    
+    Matx33f r_x = axiator(r);
+    Matx33f v_x = axiator(v);
+    
+    float theta = norm(r);
+    
+    // coupling between rotation and translation (Barfoot, State Estimation for Robotics, eq. 7.86)
+    Matx33f Q = 0.5f*v_x;
+    
+    if(theta >= 1e-4f)
+    {
+        float theta2 = theta*theta;
+        float theta3 = theta2*theta;
+        float theta4 = theta3*theta;
+        float theta5 = theta4*theta;
+        
+        float sinTheta = sin(theta);
+        float cosTheta = cos(theta);
+        
+        Matx33f rv = r_x*v_x;
+        Matx33f vr = v_x*r_x;
+        Matx33f rvr = rv*r_x;
+        
+        float a = (theta - sinTheta)/theta3;
+        float b = (theta2 + 2.0f*cosTheta - 2.0f)/(2.0f*theta4);
+        float c = (2.0f*theta - 3.0f*sinTheta + theta*cosTheta)/(2.0f*theta5);
+        
+        Q += a*(rv + vr + rvr) + b*(r_x*rv + vr*r_x - 3.0f*rvr) + c*(rvr*r_x + r_x*rvr);
+    }
+    
+    Matx66f Jl = Matx66f::zeros();
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            Jl(i, j) = J(i, j);
+            Jl(i+3, j+3) = J(i, j);
+            Jl(i+3, j) = Q(i, j);
+        }
+    }
+    
+    return Jl;
+}
+
+Matx66f Transformations::rightJacobian(const Matx61f &xi)
+{
+    return leftJacobian(-xi);
+}
+
+Matx66f Transformations::adjoint(const Matx44f &T)
+{
+    Matx33f R = T.get_minor<3, 3>(0, 0);
+    Matx33f tR = axiator(Vec3f(T(0, 3), T(1, 3), T(2, 3)))*R;
+    
+    Matx66f Ad = Matx66f::zeros();
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            Ad(i, j) = R(i, j);
+            Ad(i+3, j+3) = R(i, j);
+            Ad(i+3, j) = tR(i, j);
+        }
+    }
+    
+    return Ad;
+}
+
+float Transformations::rotationError(const Matx44f &A, const Matx44f &B)
+{
+    Matx33f R_A = A.get_minor<3, 3>(0, 0);
+    Matx33f R_B = B.get_minor<3, 3>(0, 0);
+    
+    return norm(logSO3(R_A.t()*R_B));
+}
+
+
+PoseSE3::PoseSE3()
+{
+    for(int i = 0; i < 12; i++)
+        val[i] = 0.0f;
+    
+    val[0] = val[5] = val[10] = 1.0f;
+}
+
+PoseSE3::PoseSE3(const Matx44f &T)
+{
+    for(int i = 0; i < 12; i++)
+        val[i] = T.val[i];
+}
+
+Matx44f PoseSE3::toMatx44f() const
+{
+    return Matx44f(val[0], val[1], val[2],  val[3],
+                   val[4], val[5], val[6],  val[7],
+                   val[8], val[9], val[10], val[11],
+                   0,      0,      0,       1);
+}
+
+Matx33f PoseSE3::rotation() const
+{
+    return Matx33f(val[0], val[1], val[2],
+                   val[4], val[5], val[6],
+                   val[8], val[9], val[10]);
+}
+
+Vec3f PoseSE3::translation() const
+{
+    return Vec3f(val[3], val[7], val[11]);
+}
+
+PoseSE3 PoseSE3::inverse() const
+{
+    PoseSE3 Ti;
+    
+    // transposed rotation
+    Ti.val[0] = val[0]; Ti.val[1] = val[4]; Ti.val[2]  = val[8];
+    Ti.val[4] = val[1]; Ti.val[5] = val[5]; Ti.val[6]  = val[9];
+    Ti.val[8] = val[2]; Ti.val[9] = val[6]; Ti.val[10] = val[10];
+    
+    // -R^T*t
+    Ti.val[3]  = -(Ti.val[0]*val[3] + Ti.val[1]*val[7] + Ti.val[2]*val[11]);
+    Ti.val[7]  = -(Ti.val[4]*val[3] + Ti.val[5]*val[7] + Ti.val[6]*val[11]);
+    Ti.val[11] = -(Ti.val[8]*val[3] + Ti.val[9]*val[7] + Ti.val[10]*val[11]);
+    
+    return Ti;
+}
+
+PoseSE3 PoseSE3::operator*(const PoseSE3 &B) const
+{
+    PoseSE3 C;
+    
+    __m128 b0 = _mm_load_ps(B.val);
+    __m128 b1 = _mm_load_ps(B.val + 4);
+    __m128 b2 = _mm_load_ps(B.val + 8);
+    
+    // the implicit last row (0, 0, 0, 1) of B contributes only to the translation
+    for(int i = 0; i < 3; i++)
+    {
+        const float *a = val + 4*i;
+        
+        __m128 c = _mm_mul_ps(_mm_set1_ps(a[0]), b0);
+        c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(a[1]), b1));
+        c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(a[2]), b2));
+        c = _mm_add_ps(c, _mm_set_ps(a[3], 0.0f, 0.0f, 0.0f));
+        
+        _mm_store_ps(C.val + 4*i, c);
+    }
+    
+    return C;
+}
+
+Vec3f PoseSE3::operator*(const Vec3f &X) const
+{
+    return Vec3f(val[0]*X[0] + val[1]*X[1] + val[2]*X[2] + val[3],
+                 val[4]*X[0] + val[5]*X[1] + val[6]*X[2] + val[7],
+                 val[8]*X[0] + val[9]*X[1] + val[10]*X[2] + val[11]);
+}
@@ -36,9 +36,83 @@
 #ifndef TRANSFORMATIONS_H
 #define TRANSFORMATIONS_H
 
+#include <xmmintrin.h>
+
 #include <opencv2/core.hpp>
 #include <opencv2/calib3d.hpp>
 
+/**
+ *  A compact representation of a 6DOF rigid body transform as the upper 3x4
+ *  part of the homogeneous matrix
+ *  T = [r11 r12 r13 tx]
+ *      [r21 r22 r23 ty]
+ *      [r31 r32 r33 tz]
+ *  stored row-major in 16 byte aligned rows, so that composition and point
+ *  transformation can be computed with SSE instructions.
+ */
+struct PoseSE3
+{
+    // row-major 3x4 matrix, each row being (r_i1, r_i2, r_i3, t_i)
+    CV_DECL_ALIGNED(16) float val[12];
+    
+    /**
+     *  Constructs the identity transform.
+     */
+    PoseSE3();
+    
+    /**
+     *  Constructs the transform from its 4x4 homogeneous matrix representation.
+     *
+     *  @param T A 4x4 homogenbeous rigid body transformation matrix.
+     */
+    PoseSE3(const cv::Matx44f &T);
+    
+    /**
+     *  Returns the transform in 4x4 homogeneous matrix representation.
+     *
+     *  @return A 4x4 homogenbeous rigid body transformation matrix.
+     */
+    cv::Matx44f toMatx44f() const;
+    
+    /**
+     *  Returns the rotational part of the transform.
+     *
+     *  @return A 3x3 rotation matrix.
+     */
+    cv::Matx33f rotation() const;
+    
+    /**
+     *  Returns the translational part of the transform.
+     *
+     *  @return The 3D translation vector.
+     */
+    cv::Vec3f translation() const;
+    
+    /**
+     *  Computes the inverse transform [R^T, -R^T*t] using the orthonormality
+     *  of the rotation.
+     *
+     *  @return The inverse rigid body transform.
+     */
+    PoseSE3 inverse() const;
+    
+    /**
+     *  Composes this transform with another one, i.e. computes this*B.
+     *
+     *  @param B The transform to be applied first.
+     *  @return The composed rigid body transform.
+     */
+    PoseSE3 operator*(const PoseSE3 &B) const;
+    
+    /**
+     *  Applies the transform to a 3D point.
+     *
+     *  @param X The 3D point to be transformed.
+     *  @return The transformed 3D point R*X + t.
+     */
+    cv::Vec3f operator*(const cv::Vec3f &X) const;
+};
+
 /**
  *  A collection of geometric transformations implemented using the OpenCV matrix types.
  */
@@ -157,6 +231,85 @@ public:
      *  @return A 4x4 homogenbeous rigid body transformation matrix corresponding to the twist coordinates.
      */
     static cv::Matx44f exp(cv::Matx61f xi);
+    
+    /**
+     *  Computes the logarithmic map from a given rigid body transform
+     *  in 4x4 homogeneous matrix representation to the corresponding
+     *  6D vector of twist coordinates, i.e. the inverse of exp().
+     *
+     *  @param T A 4x4 homogenbeous rigid body transformation matrix.
+     *  @return The 6D vector of twist coordinates corresponding to the transformation.
+     */
+    static cv::Matx61f log(const cv::Matx44f &T);
+    
+    /**
+     *  Computes the logarithmic map from a given 3x3 rotation matrix to
+     *  the corresponding axis-angle vector. The computation is analytic
+     *  and numerically stable for rotation angles close to 0 and pi.
+     *
+     *  @param R A 3x3 rotation matrix.
+     *  @return The 3D axis-angle vector corresponding to the rotation.
+     */
+    static cv::Vec3f logSO3(const cv::Matx33f &R);
+    
+    /**
+     *  Computes the left Jacobian of SO(3) at a given axis-angle vector,
+     *  which also maps the translational twist coordinates to the
+     *  translation within exp().
+     *
+     *  @param r A 3D axis-angle vector.
+     *  @return The 3x3 left Jacobian of SO(3).
+     */
+    static cv::Matx33f leftJacobianSO3(const cv::Vec3f &r);
+    
+    /**
+     *  Computes the inverse of the left Jacobian of SO(3) at a given axis-angle
+     *  vector.
+     *
+     *  @param r A 3D axis-angle vector.
+     *  @return The 3x3 inverse left Jacobian of SO(3).
+     */
+    static cv::Matx33f leftJacobianInverseSO3(const cv::Vec3f &r);
+    
+    /**
+     *  Computes the left Jacobian of SE(3) at a given 6D vector of twist
+     *  coordinates, i.e. the linear map that relates a small left perturbation
+     *  of the pose exp(d)*exp(xi) = exp(xi + J_l(xi)^-1*d) to the twist.
+     *
+     *  @param xi A 6D vector of tiwst coordinates (rotation first).
+     *  @return The 6x6 left Jacobian of SE(3).
+     */
+    static cv::Matx66f leftJacobian(const cv::Matx61f &xi);
+    
+    /**
+     *  Computes the right Jacobian of SE(3) at a given 6D vector of twist
+     *  coordinates, i.e. the linear map that relates a small right perturbation
+     *  of the pose exp(xi)*exp(d) = exp(xi + J_r(xi)^-1*d) to the twist.
+     *
+     *  @param xi A 6D vector of tiwst coordinates (rotation first).
+     *  @return The 6x6 right Jacobian of SE(3).
+     */
+    static cv::Matx66f rightJacobian(const cv::Matx61f &xi);
+    
+    /**
+     *  Computes the adjoint representation of a rigid body transform, mapping
+     *  twist coordinates from the local into the reference frame of the
+     *  transform, i.e. T*exp(xi)*T^-1 = exp(Ad(T)*xi).
+     *
+     *  @param T A 4x4 homogenbeous rigid body transformation matrix.
+     *  @return The 6x6 adjoint matrix of the transformation (rotation first).
+     */
+    static cv::Matx66f adjoint(const cv::Matx44f &T);
+    
+    /**
+     *  Computes the geodesic distance between the rotational parts of two rigid
+     *  body transforms, i.e. the angle of the relative rotation.
+     *
+     *  @param A A 4x4 homogenbeous rigid body transformation matrix.
+     *  @param B A 4x4 homogenbeous rigid body transformation matrix.
+     *  @return The angle of the relative rotation between A and B (in radians).
+     */
+    static float rotationError(const cv::Matx44f &A, const cv::Matx44f &B);
 };
 
 #endif //TRANSFORMATIONS_H
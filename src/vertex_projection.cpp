@@ -0,0 +1,314 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "vertex_projection.h"
+
+using namespace std;
+using namespace cv;
+
+
+// broadcasts the upper 3x4 part of a transform into 12 SSE registers
+static inline void broadcastTransform(const Matx44f &T, __m128 *t)
+{
+    for(int r = 0; r < 3; r++)
+    {
+        for(int c = 0; c < 4; c++)
+        {
+            t[4*r + c] = _mm_set1_ps(T(r, c));
+        }
+    }
+}
+
+
+// transforms four points at once by a broadcasted transform
+static inline void transformPoints(const __m128 *t, const __m128 &X, const __m128 &Y, const __m128 &Z, __m128 &X_c, __m128 &Y_c, __m128 &Z_c)
+{
+    X_c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t[0], X), _mm_mul_ps(t[1], Y)), _mm_add_ps(_mm_mul_ps(t[2], Z), t[3]));
+    Y_c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t[4], X), _mm_mul_ps(t[5], Y)), _mm_add_ps(_mm_mul_ps(t[6], Z), t[7]));
+    Z_c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t[8], X), _mm_mul_ps(t[9], Y)), _mm_add_ps(_mm_mul_ps(t[10], Z), t[11]));
+}
+
+
+VertexProjection::VertexProjection()
+{
+    allocate(0, false);
+}
+
+
+VertexProjection::VertexProjection(const vector<Vec3f> &points)
+{
+    allocate((int)points.size(), false);
+    
+    for(int i = 0; i < numPoints; i++)
+    {
+        X[i] = points[i][0];
+        Y[i] = points[i][1];
+        Z[i] = points[i][2];
+        
+        ids[i] = i;
+    }
+}
+
+
+VertexProjection::VertexProjection(const vector<Vec3f> &vertices, const vector<Vec3f> &normals, const vector<int> &ids)
+{
+    bool withNormals = !normals.empty() && normals.size() == vertices.size();
+    
+    allocate((int)ids.size(), withNormals);
+    
+    for(int i = 0; i < numPoints; i++)
+    {
+        int v = ids[i];
+        
+        X[i] = vertices[v][0];
+        Y[i] = vertices[v][1];
+        Z[i] = vertices[v][2];
+        
+        if(withNormals)
+        {
+            // the culling test relies on unit normals
+            Vec3f n = normals[v];
+            float length = (float)norm(n);
+            if(length > 0)
+                n /= length;
+            
+            NX[i] = n[0];
+            NY[i] = n[1];
+            NZ[i] = n[2];
+        }
+        
+        this->ids[i] = v;
+    }
+}
+
+
+VertexProjection::~VertexProjection()
+{
+    
+}
+
+
+void VertexProjection::allocate(int n, bool withNormals)
+{
+    numPoints = n;
+    
+    X.assign(n + 3, 0.0f);
+    Y.assign(n + 3, 0.0f);
+    Z.assign(n + 3, 0.0f);
+    
+    if(withNormals)
+    {
+        NX.assign(n + 3, 0.0f);
+        NY.assign(n + 3, 0.0f);
+        NZ.assign(n + 3, 0.0f);
+    }
+    else
+    {
+        NX.clear();
+        NY.clear();
+        NZ.clear();
+    }
+    
+    ids.assign(n, 0);
+}
+
+
+int VertexProjection::getNumPoints() const
+{
+    return numPoints;
+}
+
+
+bool VertexProjection::hasNormals() const
+{
+    return !NX.empty();
+}
+
+
+const vector<int>& VertexProjection::getIDs() const
+{
+    return ids;
+}
+
+
+void VertexProjection::project(const Matx44f &T_cm, const Matx33f &K, int begin, int end, float *x, float *y, float *z) const
+{
+    if(begin < 0)
+        begin = 0;
+    if(end > numPoints)
+        end = numPoints;
+    
+    __m128 t[12];
+    broadcastTransform(T_cm, t);
+    
+    __m128 fx = _mm_set1_ps(K(0, 0));
+    __m128 fy = _mm_set1_ps(K(1, 1));
+    __m128 s = _mm_set1_ps(K(0, 1));
+    __m128 cx = _mm_set1_ps(K(0, 2));
+    __m128 cy = _mm_set1_ps(K(1, 2));
+    __m128 one = _mm_set1_ps(1.0f);
+    
+    CV_DECL_ALIGNED(16) float u[4], v[4], w[4];
+    
+    for(int i = begin; i < end; i += 4)
+    {
+        __m128 X_c, Y_c, Z_c;
+        transformPoints(t, _mm_loadu_ps(&X[i]), _mm_loadu_ps(&Y[i]), _mm_loadu_ps(&Z[i]), X_c, Y_c, Z_c);
+        
+        __m128 invZ = _mm_div_ps(one, Z_c);
+        __m128 x_n = _mm_mul_ps(X_c, invZ);
+        __m128 y_n = _mm_mul_ps(Y_c, invZ);
+        
+        __m128 x_i = _mm_add_ps(_mm_add_ps(_mm_mul_ps(fx, x_n), _mm_mul_ps(s, y_n)), cx);
+        __m128 y_i = _mm_add_ps(_mm_mul_ps(fy, y_n), cy);
+        
+        if(i + 4 <= end)
+        {
+            _mm_storeu_ps(x + i - begin, x_i);
+            _mm_storeu_ps(y + i - begin, y_i);
+            _mm_storeu_ps(z + i - begin, Z_c);
+        }
+        else
+        {
+            _mm_store_ps(u, x_i);
+            _mm_store_ps(v, y_i);
+            _mm_store_ps(w, Z_c);
+            
+            for(int l = 0; i + l < end; l++)
+            {
+                x[i + l - begin] = u[l];
+                y[i + l - begin] = v[l];
+                z[i + l - begin] = w[l];
+            }
+        }
+    }
+}
+
+
+int VertexProjection::projectVisible(const Matx44f &T_cm, const Matx33f &K, const Rect2f &bounds, float zNear, float cullCosine, int begin, int end, float *x, float *y, float *z, int *ids) const
+{
+    if(begin < 0)
+        begin = 0;
+    if(end > numPoints)
+        end = numPoints;
+    
+    __m128 t[12];
+    broadcastTransform(T_cm, t);
+    
+    __m128 fx = _mm_set1_ps(K(0, 0));
+    __m128 fy = _mm_set1_ps(K(1, 1));
+    __m128 s = _mm_set1_ps(K(0, 1));
+    __m128 cx = _mm_set1_ps(K(0, 2));
+    __m128 cy = _mm_set1_ps(K(1, 2));
+    __m128 one = _mm_set1_ps(1.0f);
+    
+    __m128 xMin = _mm_set1_ps(bounds.x);
+    __m128 xMax = _mm_set1_ps(bounds.x + bounds.width);
+    __m128 yMin = _mm_set1_ps(bounds.y);
+    __m128 yMax = _mm_set1_ps(bounds.y + bounds.height);
+    __m128 zMin = _mm_set1_ps(zNear);
+    
+    bool cullBackFaces = hasNormals() && cullCosine < 1.0f;
+    
+    // the rotated normals are scaled by the uniform scaling contained in T_cm, which the threshold has to account for
+    float scale = sqrtf(T_cm(0, 0)*T_cm(0, 0) + T_cm(1, 0)*T_cm(1, 0) + T_cm(2, 0)*T_cm(2, 0));
+    __m128 cullThreshold = _mm_set1_ps(cullCosine*scale);
+    
+    CV_DECL_ALIGNED(16) float u[4], v[4], w[4];
+    
+    int numVisible = 0;
+    
+    for(int i = begin; i < end; i += 4)
+    {
+        __m128 X_c, Y_c, Z_c;
+        transformPoints(t, _mm_loadu_ps(&X[i]), _mm_loadu_ps(&Y[i]), _mm_loadu_ps(&Z[i]), X_c, Y_c, Z_c);
+        
+        __m128 visible = _mm_cmpgt_ps(Z_c, zMin);
+        if(_mm_movemask_ps(visible) == 0)
+            continue;
+        
+        __m128 invZ = _mm_div_ps(one, Z_c);
+        __m128 x_n = _mm_mul_ps(X_c, invZ);
+        __m128 y_n = _mm_mul_ps(Y_c, invZ);
+        
+        __m128 x_i = _mm_add_ps(_mm_add_ps(_mm_mul_ps(fx, x_n), _mm_mul_ps(s, y_n)), cx);
+        __m128 y_i = _mm_add_ps(_mm_mul_ps(fy, y_n), cy);
+        
+        visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(x_i, xMin), _mm_cmplt_ps(x_i, xMax)));
+        visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(y_i, yMin), _mm_cmplt_ps(y_i, yMax)));
+        
+        if(cullBackFaces && _mm_movemask_ps(visible) != 0)
+        {
+            // only the rotation of T_cm is applied to the normals
+            __m128 N_x = _mm_loadu_ps(&NX[i]);
+            __m128 N_y = _mm_loadu_ps(&NY[i]);
+            __m128 N_z = _mm_loadu_ps(&NZ[i]);
+            
+            __m128 NX_c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t[0], N_x), _mm_mul_ps(t[1], N_y)), _mm_mul_ps(t[2], N_z));
+            __m128 NY_c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t[4], N_x), _mm_mul_ps(t[5], N_y)), _mm_mul_ps(t[6], N_z));
+            __m128 NZ_c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t[8], N_x), _mm_mul_ps(t[9], N_y)), _mm_mul_ps(t[10], N_z));
+            
+            // the viewing ray points from the camera center to the vertex
+            __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(NX_c, X_c), _mm_mul_ps(NY_c, Y_c)), _mm_mul_ps(NZ_c, Z_c));
+            __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(X_c, X_c), _mm_mul_ps(Y_c, Y_c)), _mm_mul_ps(Z_c, Z_c)));
+            
+            visible = _mm_and_ps(visible, _mm_cmple_ps(dot, _mm_mul_ps(cullThreshold, distance)));
+        }
+        
+        int mask = _mm_movemask_ps(visible);
+        if(mask == 0)
+            continue;
+        
+        _mm_store_ps(u, x_i);
+        _mm_store_ps(v, y_i);
+        _mm_store_ps(w, Z_c);
+        
+        for(int l = 0; l < 4 && i + l < end; l++)
+        {
+            if(mask & (1 << l))
+            {
+                x[numVisible] = u[l];
+                y[numVisible] = v[l];
+                z[numVisible] = w[l];
+                ids[numVisible] = this->ids[i + l];
+                numVisible++;
+            }
+        }
+    }
+    
+    return numVisible;
+}
@@ -0,0 +1,158 @@
+/**
+ *   #, #,         CCCCCC  VV    VV MM      MM RRRRRRR
+ *  %  %(  #%%#   CC    CC VV    VV MMM    MMM RR    RR
+ *  %    %## #    CC        V    V  MM M  M MM RR    RR
+ *   ,%      %    CC        VV  VV  MM  MM  MM RRRRRR
+ *   (%      %,   CC    CC   VVVV   MM      MM RR   RR
+ *     #%    %*    CCCCCC     VV    MM      MM RR    RR
+ *    .%    %/
+ *       (%.      Computer Vision & Mixed Reality Group
+ *                For more information see <http://cvmr.info>
+ *
+ * This file is part of RBOT.
+ *
+ *  @copyright:   RheinMain University of Applied Sciences
+ *                Wiesbaden Rüsselsheim
+ *                Germany
+ *     @author:   Henning Tjaden
+ *                <henning dot tjaden at gmail dot com>
+ *    @version:   1.0
+ *       @date:   30.08.2018
+ *
+ * RBOT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RBOT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RBOT. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#ifndef VERTEX_PROJECTION_H
+#define VERTEX_PROJECTION_H
+
+#include <vector>
+
+#include <emmintrin.h>
+
+#include <opencv2/core.hpp>
+
+/**
+ *  This class stores a set of 3D points (e.g. the vertices of a level of detail
+ *  of a model) and optionally their normals as a structure of arrays, so that
+ *  they can be projected into an image four at a time using SSE instructions.
+ *  Besides projecting all points, it supports projecting only those that are
+ *  visible, i.e. that lie in front of the camera, project into a given image
+ *  region and are not clearly back facing, returning a compacted list.
+ */
+class VertexProjection
+{
+public:
+    /**
+     *  Constructor creating an empty point set.
+     */
+    VertexProjection();
+    
+    /**
+     *  Constructor copying a set of points without normals, which are
+     *  identified by their index within the given vector.
+     *
+     *  @param  points The 3D points.
+     */
+    VertexProjection(const std::vector<cv::Vec3f> &points);
+    
+    /**
+     *  Constructor copying a subset of the vertices of a mesh and their
+     *  normals, which are identified by their vertex index.
+     *
+     *  @param  vertices All 3D vertices of the mesh.
+     *  @param  normals The normals of all vertices of the mesh or an empty vector, in which case no back face culling is performed.
+     *  @param  ids The indices of the vertices to be copied.
+     */
+    VertexProjection(const std::vector<cv::Vec3f> &vertices, const std::vector<cv::Vec3f> &normals, const std::vector<int> &ids);
+    
+    ~VertexProjection();
+    
+    /**
+     *  Returns the number of stored points.
+     *
+     *  @return  The number of stored points.
+     */
+    int getNumPoints() const;
+    
+    /**
+     *  Tells whether normals are stored, i.e. whether back face culling
+     *  is possible.
+     *
+     *  @return  True if normals are stored and false otherwise.
+     */
+    bool hasNormals() const;
+    
+    /**
+     *  Returns the identifiers of all stored points in the order of storage.
+     *
+     *  @return  The identifiers of the stored points.
+     */
+    const std::vector<int>& getIDs() const;
+    
+    /**
+     *  Projects the points [begin, end) into the image. The results for the i-th
+     *  point are written to position i - begin of the output arrays, which must
+     *  provide space for end - begin elements. The image coordinates are invalid
+     *  for points with Z_c <= 0.
+     *
+     *  @param  T_cm The 4x4 transform from the coordinate frame of the points to the camera.
+     *  @param  K The intrinsic camera matrix.
+     *  @param  begin The index of the first point to be projected.
+     *  @param  end The index after the last point to be projected.
+     *  @param  x The resulting x image coordinates.
+     *  @param  y The resulting y image coordinates.
+     *  @param  z The resulting depths Z_c in camera coordinates.
+     */
+    void project(const cv::Matx44f &T_cm, const cv::Matx33f &K, int begin, int end, float *x, float *y, float *z) const;
+    
+    /**
+     *  Projects the points [begin, end) into the image and only keeps those with
+     *  Z_c > zNear whose image coordinates lie within the given bounds. If normals
+     *  are stored, points whose normal encloses an angle with the viewing ray of
+     *  acos(cullCosine) or less are culled as back facing as well, where a cosine
+     *  of 1 disables back face culling. The results are written compactly to the
+     *  output arrays, which must provide space for end - begin elements.
+     *
+     *  @param  T_cm The 4x4 transform from the coordinate frame of the points to the camera. It must not contain a non-uniform scaling.
+     *  @param  K The intrinsic camera matrix.
+     *  @param  bounds The image region [x, x + width) x [y, y + height) the points have to project into.
+     *  @param  zNear The minimum depth of the points in camera coordinates.
+     *  @param  cullCosine The cosine of the angle between normal and viewing ray above which points are culled.
+     *  @param  begin The index of the first point to be projected.
+     *  @param  end The index after the last point to be projected.
+     *  @param  x The resulting x image coordinates of the visible points.
+     *  @param  y The resulting y image coordinates of the visible points.
+     *  @param  z The resulting depths Z_c of the visible points in camera coordinates.
+     *  @param  ids The resulting identifiers of the visible points.
+     *
+     *  @return  The number of visible points.
+     */
+    int projectVisible(const cv::Matx44f &T_cm, const cv::Matx33f &K, const cv::Rect2f &bounds, float zNear, float cullCosine, int begin, int end, float *x, float *y, float *z, int *ids) const;
+    
+private:
+    int numPoints;
+    
+    // the coordinates and normals padded by three elements, so that every point can be loaded as part of a block of four
+    std::vector<float> X, Y, Z;
+    std::vector<float> NX, NY, NZ;
+    
+    std::vector<int> ids;
+    
+    void allocate(int n, bool withNormals);
+};
+
+#endif /* VERTEX_PROJECTION_H */